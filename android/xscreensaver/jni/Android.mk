@@ -47,6 +47,7 @@ LOCAL_SRC_FILES := \
     hacks/glx/glut_stroke.c \
     hacks/glx/glut_swidth.c \
     hacks/glx/grab-ximage.c \
+    hacks/glx/gridsurf.c \
     hacks/glx/marching.c \
     hacks/glx/normals.c \
     hacks/glx/rotator.c \
@@ -199,6 +200,7 @@ LOCAL_SRC_FILES += \
     utils/thread_util.c \
     utils/usleep.c \
     utils/utf8wc.c \
+    utils/xbatch.c \
     utils/xft.c \
     utils/xftwrap.c \
     utils/xshm.c \
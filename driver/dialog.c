@@ -37,6 +37,10 @@
 #include <sys/time.h>
 #include <pwd.h>
 
+#ifdef HAVE_SYS_SELECT_H
+# include <sys/select.h>
+#endif /* HAVE_SYS_SELECT_H */
+
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
@@ -194,6 +198,10 @@ struct window_state {
   double start_time, end_time;
   int passwd_timeout;
 
+  double input_at;	/* When the last undrawn key or click was read */
+  double worst_latency;	/* Longest time from reading one to drawing it */
+  int input_count;
+
   Bool show_stars_p; /* "I regret that I have but one asterisk for my country."
                         -- Nathan Hale, 1776. */
   Bool caps_p;		 /* Whether we saw a keypress with caps-lock on */
@@ -1946,6 +1954,10 @@ destroy_window (window_state *ws)
           sizeof(ws->plaintext_passwd_char_size));
   memset (ws->censored_passwd, 0, sizeof(ws->censored_passwd));
 
+  if (verbose_p && ws->input_count)
+    fprintf (stderr, "%s: worst input latency %.1f ms over %d inputs\n",
+             blurb(), ws->worst_latency * 1000, ws->input_count);
+
   if (ws->timer)
     {
       XtRemoveTimeOut (ws->timer);
@@ -2513,12 +2525,39 @@ gui_main_loop (window_state *ws, Bool splash_p, Bool notification_p)
                   /* Redraw when outstanding events have been processed. */
                   window_draw (ws);
                   refresh_p = False;
+
+                  if (ws->input_at)
+                    {
+                      double lat = double_time() - ws->input_at;
+                      if (lat > ws->worst_latency)
+                        ws->worst_latency = lat;
+                      if (verbose_p > 1)
+                        fprintf (stderr, "%s: input latency %.1f ms\n",
+                                 blurb(), lat * 1000);
+                      ws->input_at = 0;
+                    }
                 }
 
               /* No way to say "block until timer *or* X pending".
                  Without this, the timer that changes auth_state will fire but
-                 then we will still be blocked until the next X event. */
-              usleep (1000000/30);
+                 then we will still be blocked until the next X event.  So
+                 wait for X input ourselves, but for no longer than a tick of
+                 the thermometer.  (A plain sleep here meant that a keystroke
+                 could sit unread for most of that tick.) */
+              {
+# ifdef HAVE_SELECT
+                int fd = ConnectionNumber (ws->dpy);
+                fd_set rset;
+                struct timeval tv;
+                tv.tv_sec  = 0;
+                tv.tv_usec = 1000000/30;
+                FD_ZERO (&rset);
+                FD_SET (fd, &rset);
+                select (fd+1, &rset, 0, 0, &tv);
+# else  /* !HAVE_SELECT */
+                usleep (1000000/30);
+# endif /* !HAVE_SELECT */
+              }
             }
           continue;
         }
@@ -2557,6 +2596,13 @@ gui_main_loop (window_state *ws, Bool splash_p, Bool notification_p)
           }
       }
 
+      if (xev.xany.type == KeyPress || xev.xany.type == ButtonPress)
+        {
+          if (!ws->input_at)
+            ws->input_at = double_time();
+          ws->input_count++;
+        }
+
       if (handle_event (ws, &xev, filtered_p))
         refresh_p = True;
 
@@ -44,6 +44,14 @@
    some day, except that, 1: this code works now, so why fix it, and 2: from
    what I've seen in Emacs, dealing with process groups isn't especially
    portable.)
+
+   When there are no metacharacters, and the child has nothing to do
+   between fork() and exec() except close a file, set its nice level and
+   set a few environment variables, we vfork() instead, so that our page
+   tables aren't copied first.  Where there is no vfork(), posix_spawn()
+   does the same, but it can't set the nice level.  We still need fork()
+   for the shell case, and for anything else that has to happen in the
+   child (e.g. joining a cgroup.)
  */
 
 #ifdef HAVE_CONFIG_H
@@ -58,15 +66,29 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <signal.h>
 #include <sys/stat.h>
 
 #ifndef ESRCH
 # include <errno.h>
 #endif
 
-#if defined(HAVE_SETPRIORITY) && defined(PRIO_PROCESS)
+#ifdef HAVE_SETPRIORITY
+# include <sys/time.h>
 # include <sys/resource.h>	/* for setpriority() and PRIO_PROCESS */
-				/* and also setrlimit() and RLIMIT_AS */
+#endif
+
+#if defined(HAVE_VFORK) && defined(HAVE_SETPRIORITY) && defined(HAVE_SIGACTION)
+# define USE_VFORK
+#endif
+
+#if defined(HAVE_POSIX_SPAWNP) && !defined(USE_VFORK)
+# include <spawn.h>
+# define USE_POSIX_SPAWN
+#endif
+
+#if defined(USE_VFORK) || defined(USE_POSIX_SPAWN)
+extern char **environ;
 #endif
 
 #include "exec.h"
@@ -76,19 +98,34 @@ extern const char *blurb (void);
 static void nice_process (int nice_level);
 
 
+static int
+hairy_command_p (const char *command)
+{
+  return !!strpbrk (command, "*?$&!<>[];`'\\\"=");
+  /* note: = is in the above because of the sh syntax "FOO=bar cmd". */
+}
+
+
+/* Splits the string in place at whitespace.  'av' is null-terminated. */
 static void
-exec_simple_command (const char *command)
+split_simple_command (char *command, char **av, int size)
 {
-  char *av[1024];
   int ac = 0;
-  char *token = strtok (strdup(command), " \t");
-  while (token)
+  char *token = strtok (command, " \t");
+  while (token && ac < size - 1)
     {
       av[ac++] = token;
       token = strtok(0, " \t");
     }
   av[ac] = 0;
+}
 
+
+static void
+exec_simple_command (const char *command)
+{
+  char *av[1024];
+  split_simple_command (strdup (command), av, sizeof(av)/sizeof(*av));
   execvp (av[0], av);	/* shouldn't return. */
 }
 
@@ -159,8 +196,7 @@ exec_command (const char *shell, const char *command, int nice_level)
 
   nice_process (nice_level);
 
-  hairy_p = !!strpbrk (command, "*?$&!<>[];`'\\\"=");
-  /* note: = is in the above because of the sh syntax "FOO=bar cmd". */
+  hairy_p = hairy_command_p (command);
 
   if (getuid() == (uid_t) 0 || geteuid() == (uid_t) 0)
     {
@@ -183,6 +219,210 @@ exec_command (const char *shell, const char *command, int nice_level)
 }
 
 
+#if defined(USE_VFORK) || defined(USE_POSIX_SPAWN)
+
+/* A copy of our environment, with the "VAR=value" strings in 'env'
+   replacing any existing settings of VAR.  Free the array, not the strings.
+ */
+static char **
+merge_environment (char **env)
+{
+  int n = 0, m = 0, i, j, k;
+  char **result;
+
+  while (environ[n]) n++;
+  if (env)
+    while (env[m]) m++;
+
+  result = (char **) malloc ((n + m + 1) * sizeof(*result));
+  if (!result) return 0;
+
+  for (i = 0, j = 0; i < n; i++)
+    {
+      const char *eq = strchr (environ[i], '=');
+      int L = (eq ? eq - environ[i] + 1 : strlen (environ[i]));
+      for (k = 0; k < m; k++)
+        if (!strncmp (environ[i], env[k], L))
+          break;
+      if (k == m)
+        result[j++] = environ[i];
+    }
+  for (k = 0; k < m; k++)
+    result[j++] = env[k];
+  result[j] = 0;
+  return result;
+}
+
+#endif /* USE_VFORK || USE_POSIX_SPAWN */
+
+
+#ifdef USE_VFORK
+
+/* Returns the file that execvp() would run for 'program', or 0.
+   Free the string.
+ */
+static char *
+find_program (const char *program)
+{
+  const char *path = getenv ("PATH");
+  const char *s, *e;
+  int L = strlen (program);
+  struct stat st;
+
+  if (strchr (program, '/'))
+    return (access (program, X_OK) ? 0 : strdup (program));
+
+  if (!path || !*path)
+    return 0;
+
+  for (s = path; ; s = e + 1)
+    {
+      char *f;
+      int n;
+      e = strchr (s, ':');
+      if (!e) e = s + strlen (s);
+      n = e - s;
+      f = (char *) malloc (n + L + 2);
+      if (!f) return 0;
+      if (n)			/* An empty entry means the current dir. */
+        {
+          memcpy (f, s, n);
+          f[n++] = '/';
+        }
+      strcpy (f + n, program);
+      if (!access (f, X_OK) && !stat (f, &st) && S_ISREG (st.st_mode))
+        return f;
+      free (f);
+      if (!*e) break;
+    }
+  return 0;
+}
+
+
+static pid_t
+vfork_exec (const char *file, char **av, char **envp, int close_fd,
+            int nice_level)
+{
+  sigset_t all, old;
+  pid_t pid;
+
+  /* Until it execs, the child runs in our memory and on our stack, so it
+     must not run any of our signal handlers. */
+  sigfillset (&all);
+  sigprocmask (SIG_SETMASK, &all, &old);
+
+  pid = vfork ();
+  if (pid == 0)
+    {
+      /* Nothing but system calls here: no malloc, no stdio, no return. */
+      struct sigaction sa;
+      int i;
+      for (i = 1; i < NSIG; i++)
+        if (sigaction (i, 0, &sa) == 0 &&
+            sa.sa_handler != SIG_DFL &&
+            sa.sa_handler != SIG_IGN)
+          {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigaction (i, &sa, 0);
+          }
+      sigprocmask (SIG_SETMASK, &old, 0);
+
+      if (close_fd >= 0)
+        close (close_fd);
+
+      /* Absolute, like nice_process.  Making ourselves nicer can't fail
+         for lack of privilege, and there's no way to complain here. */
+      if (nice_level != 0)
+        setpriority (PRIO_PROCESS, 0, nice_level);
+
+      execve (file, av, envp);
+      _exit (EXEC_FAILED_EXIT_STATUS);
+    }
+
+  sigprocmask (SIG_SETMASK, &old, 0);
+  return (pid < 0 ? 0 : pid);
+}
+
+#endif /* USE_VFORK */
+
+
+pid_t
+spawn_command (const char *command, char **env, int close_fd,
+               int nice_level)
+{
+#if defined(USE_VFORK) || defined(USE_POSIX_SPAWN)
+  char *cmd, *av[1024];
+  char **envp;
+  pid_t pid = 0;
+
+  if (hairy_command_p (command))
+    return 0;
+
+# ifdef USE_POSIX_SPAWN
+  /* There's no way to have posix_spawn set the child's nice level, and
+     doing it from here after the fact is a race: on Linux the nice level
+     is per-thread, and any threads the hack had already started would
+     keep ours.  So fork, and let exec_command do it first. */
+  if (nice_level != 0)
+    return 0;
+# endif
+
+  /* Let exec_command be the one to complain. */
+  if (getuid() == (uid_t) 0 || geteuid() == (uid_t) 0)
+    return 0;
+
+  cmd = strdup (command);
+  split_simple_command (cmd, av, sizeof(av)/sizeof(*av));
+  envp = (av[0] ? merge_environment (env) : 0);
+  if (!envp)
+    {
+      free (cmd);
+      return 0;
+    }
+
+# ifdef USE_VFORK
+  {
+    /* The child can't search $PATH itself, since that allocates.  If the
+       program isn't found, fork and fail the old way, so that the error
+       is reported the same way. */
+    char *file = find_program (av[0]);
+    if (file)
+      {
+        pid = vfork_exec (file, av, envp, close_fd, nice_level);
+        free (file);
+      }
+  }
+# else /* USE_POSIX_SPAWN */
+  {
+    posix_spawn_file_actions_t actions;
+    int err;
+
+    posix_spawn_file_actions_init (&actions);
+    if (close_fd >= 0)
+      posix_spawn_file_actions_addclose (&actions, close_fd);
+
+    err = posix_spawnp (&pid, av[0], &actions, 0, av, envp);
+
+    posix_spawn_file_actions_destroy (&actions);
+
+    /* If the program wasn't found, fork and fail the old way, so that the
+       error is reported the same way. */
+    if (err)
+      pid = 0;
+  }
+# endif /* USE_POSIX_SPAWN */
+
+  free (envp);
+  free (cmd);
+  return pid;
+
+#else  /* !USE_VFORK && !USE_POSIX_SPAWN */
+  return 0;
+#endif /* !USE_VFORK && !USE_POSIX_SPAWN */
+}
+
+
 /* Setting process priority
  */
 
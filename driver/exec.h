@@ -16,6 +16,18 @@
 extern void exec_command (const char *shell, const char *command,
                           int nice_level);
 
+/* The exit status of a child that could not exec the program. */
+#define EXEC_FAILED_EXIT_STATUS -33
+
+/* Starts the command in a new process without forking this one, if that
+   can be done without a shell.  'env' is a null-terminated list of
+   "VAR=value" strings to add to the child's environment, and 'close_fd'
+   is a descriptor it should not inherit, or -1.  Returns the new pid,
+   or 0 if the caller should fork and call exec_command instead.  Without
+   vfork, that includes whenever 'nice_level' is not 0. */
+extern pid_t spawn_command (const char *command, char **env, int close_fd,
+                            int nice_level);
+
 extern int on_path_p (const char *program);
 
 #endif /* __XSCREENSAVER_EXEC_H__ */
@@ -77,6 +77,10 @@
 #include <string.h>
 #include <sys/time.h>
 
+#ifdef HAVE_SYS_SELECT_H
+# include <sys/select.h>
+#endif /* HAVE_SYS_SELECT_H */
+
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>		/* for waitpid() and associated macros */
 #endif
@@ -281,6 +285,37 @@ user_active_p (XtAppContext app, Display *dpy, Bool fade_out_p)
 }
 
 
+/* Sleep until the next frame is due, but wake up whenever something arrives
+   on the X connection, and return True if it was user input.  Otherwise a
+   keypress during a fade would wait out the rest of the frame's sleep before
+   canceling it.  Non-user events are left on the queue, so they won't wake
+   us again.
+ */
+static Bool
+fade_sleep_until (XtAppContext app, Display *dpy, double until, Bool out_p)
+{
+  double now;
+  while ((now = double_time()) < until)
+    {
+# ifdef HAVE_SELECT
+      int fd = ConnectionNumber (dpy);
+      fd_set rset;
+      struct timeval tv;
+      tv.tv_sec  = (long) (until - now);
+      tv.tv_usec = (long) (((until - now) - tv.tv_sec) * 1000000);
+      FD_ZERO (&rset);
+      FD_SET (fd, &rset);
+      select (fd+1, &rset, 0, 0, &tv);
+# else  /* !HAVE_SELECT */
+      usleep (1000000 * (until - now));
+# endif /* !HAVE_SELECT */
+      if (user_active_p (app, dpy, out_p))
+        return True;
+    }
+  return False;
+}
+
+
 static void
 flush_user_input (Display *dpy)
 {
@@ -602,8 +637,12 @@ colormap_fade (XtAppContext app, Display *dpy,
           }
         frames++;
 
-        if (now < prev + max)
-          usleep (1000000 * (prev + max - now));
+        if (now < prev + max &&
+            fade_sleep_until (app, dpy, prev + max, out_p))
+          {
+            status = 1;   /* user activity status code */
+            goto DONE;
+          }
         prev = now;
       }
 
@@ -800,8 +839,12 @@ sgi_gamma_fade (XtAppContext app, Display *dpy,
           }
         frames++;
 
-        if (now < prev + max)
-          usleep (1000000 * (prev + max - now));
+        if (now < prev + max &&
+            fade_sleep_until (app, dpy, prev + max, out_p))
+          {
+            status = 1;   /* user activity status code */
+            goto DONE;
+          }
         prev = now;
       }
 
@@ -1033,8 +1076,12 @@ xf86_gamma_fade (XtAppContext app, Display *dpy,
           }
         frames++;
 
-        if (now < prev + max)
-          usleep (1000000 * (prev + max - now));
+        if (now < prev + max &&
+            fade_sleep_until (app, dpy, prev + max, out_p))
+          {
+            status = 1;   /* user activity status code */
+            goto DONE;
+          }
         prev = now;
       }
 
@@ -1422,8 +1469,12 @@ randr_gamma_fade (XtAppContext app, Display *dpy,
           }
         frames++;
 
-        if (now < prev + max)
-          usleep (1000000 * (prev + max - now));
+        if (now < prev + max &&
+            fade_sleep_until (app, dpy, prev + max, out_p))
+          {
+            status = 1;   /* user activity status code */
+            goto DONE;
+          }
         prev = now;
       }
 
@@ -2008,8 +2059,12 @@ xshm_fade (XtAppContext app, Display *dpy,
           }
         frames++;
 
-        if (now < prev + max)
-          usleep (1000000 * (prev + max - now));
+        if (now < prev + max &&
+            fade_sleep_until (app, dpy, prev + max, out_p))
+          {
+            status = 1;   /* user activity status code */
+            goto DONE;
+          }
         prev = now;
       }
 
@@ -0,0 +1,311 @@
+/* hackstats.c --- remembering how much each screenhack costs to run.
+ * xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/* Every time a hack exits, wait4() hands us its CPU time and peak RSS.
+   We accumulate those per program name in ~/.xscreensaver-stats.HOST,
+   named for the host because home directories are often shared between
+   machines of very different speeds.
+
+   With "cpuBudget" set, spawn_screenhack skips hacks whose historical
+   average CPU usage is more than that percentage of one core.  Hacks that
+   have not yet run long enough to have been measured are always allowed,
+   so new hacks get measured.  "cpuBudgetOnBattery" is used instead when
+   the machine is running on battery.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/time.h>		/* sys/resource.h needs this for timeval */
+#include <sys/resource.h>	/* for struct rusage */
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <X11/Xlib.h>
+#include <X11/Intrinsic.h>
+
+#include "xscreensaver.h"
+#include "prefs.h"
+#include "hackstats.h"
+
+/* Don't judge a hack until it has been watched for this many seconds. */
+#define MIN_WALL_SECONDS 30
+
+typedef struct {
+  char *name;
+  long runs;
+  double cpu;		/* user + system seconds, total */
+  double wall;		/* seconds alive, total */
+  long max_rss;		/* kilobytes, largest seen */
+} hack_stat;
+
+static hack_stat *stats = 0;
+static int stats_count = 0;
+static int stats_size = 0;
+static Bool stats_loaded_p = False;
+
+
+static const char *
+stats_file_name (void)
+{
+  static char *file = 0;
+  if (!file)
+    {
+      const char *home = getenv ("HOME");
+      const char *name = ".xscreensaver-stats";
+      char host[256];
+      if (!home || !*home) return 0;
+      if (gethostname (host, sizeof(host) - 1))
+        strcpy (host, "localhost");
+      host[sizeof(host)-1] = 0;
+      {
+        char *s = strchr (host, '.');	/* "foo.local" => "foo" */
+        if (s) *s = 0;
+      }
+      file = (char *) malloc (strlen(home) + strlen(name) + strlen(host) + 3);
+      strcpy (file, home);
+      if (home[strlen(home)-1] != '/')
+        strcat (file, "/");
+      strcat (file, name);
+      strcat (file, ".");
+      strcat (file, host);
+    }
+  return file;
+}
+
+
+static hack_stat *
+find_stat (const char *name, Bool create_p)
+{
+  int i;
+  for (i = 0; i < stats_count; i++)
+    if (!strcmp (stats[i].name, name))
+      return &stats[i];
+  if (!create_p)
+    return 0;
+
+  if (stats_count >= stats_size)
+    {
+      stats_size = stats_size * 2 + 64;
+      stats = (hack_stat *) realloc (stats, stats_size * sizeof(*stats));
+      if (!stats) abort();
+    }
+  memset (&stats[stats_count], 0, sizeof(*stats));
+  stats[stats_count].name = strdup (name);
+  return &stats[stats_count++];
+}
+
+
+static void
+load_stats_entry (int lineno, const char *key, const char *val,
+                  void *closure)
+{
+  hack_stat *st;
+  long runs, rss;
+  double cpu, wall;
+  if (4 != sscanf (val, "%ld %lf %lf %ld", &runs, &cpu, &wall, &rss))
+    return;
+  st = find_stat (key, True);
+  st->runs    = runs;
+  st->cpu     = cpu;
+  st->wall    = wall;
+  st->max_rss = rss;
+}
+
+
+static void
+load_stats (saver_info *si)
+{
+  const char *file = stats_file_name();
+  if (stats_loaded_p) return;
+  stats_loaded_p = True;
+  if (!file) return;
+  parse_init_file (file, load_stats_entry, si);
+  if (si->prefs.verbose_p)
+    fprintf (stderr, "%s: read stats for %d hacks from %s\n",
+             blurb(), stats_count, file);
+}
+
+
+static void
+save_stats (saver_info *si)
+{
+  const char *file = stats_file_name();
+  char *tmp;
+  FILE *out;
+  int i;
+
+  if (!file) return;
+  tmp = (char *) malloc (strlen(file) + 10);
+  sprintf (tmp, "%s.tmp", file);
+
+  out = fopen (tmp, "w");
+  if (!out)
+    {
+      char buf[1024];
+      sprintf (buf, "%s: error writing \"%.500s\"", blurb(), tmp);
+      perror (buf);
+      free (tmp);
+      return;
+    }
+
+  fprintf (out,
+           "# XScreenSaver per-hack resource usage.  Written by %s.\n"
+           "# program: runs cpu-seconds wall-seconds max-rss-kb\n",
+           blurb());
+  for (i = 0; i < stats_count; i++)
+    fprintf (out, "%s:\t%ld %.2f %.0f %ld\n",
+             stats[i].name, stats[i].runs, stats[i].cpu, stats[i].wall,
+             stats[i].max_rss);
+
+  if (fclose (out) || rename (tmp, file))
+    {
+      char buf[1024];
+      sprintf (buf, "%s: error writing \"%.500s\"", blurb(), file);
+      perror (buf);
+      unlink (tmp);
+    }
+  free (tmp);
+}
+
+
+Bool
+hack_stats_enabled_p (saver_preferences *p)
+{
+  return (p->hack_stats_p ||
+          p->cpu_budget > 0 ||
+          p->battery_cpu_budget > 0);
+}
+
+
+void
+hack_stats_record (saver_info *si, const char *name,
+                   time_t launched, time_t died, const struct rusage *rus)
+{
+  saver_preferences *p = &si->prefs;
+  hack_stat *st;
+  double cpu;
+  long rss;
+
+  if (!hack_stats_enabled_p (p)) return;
+  if (!name || !*name || !launched || died <= launched) return;
+
+  load_stats (si);
+  st = find_stat (name, True);
+
+  cpu = (rus->ru_utime.tv_sec + rus->ru_utime.tv_usec / 1000000.0 +
+         rus->ru_stime.tv_sec + rus->ru_stime.tv_usec / 1000000.0);
+  rss = rus->ru_maxrss;
+# ifdef __APPLE__
+  rss /= 1024;		/* bytes, not kilobytes */
+# endif
+
+  st->runs++;
+  st->cpu  += cpu;
+  st->wall += died - launched;
+  if (rss > st->max_rss)
+    st->max_rss = rss;
+
+  if (p->verbose_p)
+    fprintf (stderr, "%s: %s: %.1f%% CPU, %ld KB RSS"
+             " (average %.1f%% over %ld runs)\n",
+             blurb(), name, 100 * cpu / (died - launched), rss,
+             100 * st->cpu / st->wall, st->runs);
+
+  save_stats (si);
+}
+
+
+/* Whether there is AC power hardware, and none of it is plugged in.
+   Only Linux sysfs is checked; elsewhere, we are never on battery.
+ */
+static Bool
+on_battery_p (void)
+{
+  const char *dir = "/sys/class/power_supply";
+  Bool mains_p = False, online_p = False;
+  DIR *d = opendir (dir);
+  struct dirent *e;
+  if (!d) return False;
+  while ((e = readdir (d)))
+    {
+      char file[1024], buf[40];
+      FILE *f;
+      if (e->d_name[0] == '.') continue;
+
+      sprintf (file, "%s/%.200s/type", dir, e->d_name);
+      if (!(f = fopen (file, "r"))) continue;
+      *buf = 0;
+      if (!fgets (buf, sizeof(buf)-1, f)) *buf = 0;
+      fclose (f);
+      if (strncmp (buf, "Mains", 5)) continue;
+      mains_p = True;
+
+      sprintf (file, "%s/%.200s/online", dir, e->d_name);
+      if (!(f = fopen (file, "r"))) continue;
+      *buf = 0;
+      if (!fgets (buf, sizeof(buf)-1, f)) *buf = 0;
+      fclose (f);
+      if (*buf == '1') online_p = True;
+    }
+  closedir (d);
+  return (mains_p && !online_p);
+}
+
+
+Bool
+hack_over_budget_p (saver_info *si, const char *name)
+{
+  saver_preferences *p = &si->prefs;
+  static time_t last_check = 0;
+  static Bool battery_p = False;
+  time_t now = time ((time_t *) 0);
+  int budget;
+  hack_stat *st;
+  double pct;
+
+  if (p->cpu_budget <= 0 && p->battery_cpu_budget <= 0) return False;
+
+  /* Don't hit sysfs for every candidate when spawning on many screens. */
+  if (now - last_check > 10)
+    {
+      battery_p = on_battery_p();
+      last_check = now;
+    }
+
+  budget = (battery_p && p->battery_cpu_budget > 0
+            ? p->battery_cpu_budget
+            : p->cpu_budget);
+  if (budget <= 0) return False;
+
+  load_stats (si);
+  st = find_stat (name, False);
+  if (!st || st->wall < MIN_WALL_SECONDS)
+    return False;
+
+  pct = 100 * st->cpu / st->wall;
+  if (pct <= budget)
+    return False;
+
+  if (p->verbose_p)
+    fprintf (stderr, "%s: skipping %s: %.0f%% CPU exceeds %d%% budget%s\n",
+             blurb(), name, pct, budget, (battery_p ? " on battery" : ""));
+  return True;
+}
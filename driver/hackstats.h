@@ -0,0 +1,28 @@
+/* xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#ifndef __XSCREENSAVER_HACKSTATS_H__
+#define __XSCREENSAVER_HACKSTATS_H__
+
+/* Whether the stats file should be read and written at all. */
+extern Bool hack_stats_enabled_p (saver_preferences *);
+
+/* Accumulate the resource usage of a hack that has just exited.
+   'name' is the program name, as in the job list. */
+extern void hack_stats_record (saver_info *, const char *name,
+                               time_t launched, time_t died,
+                               const struct rusage *);
+
+/* Whether the hack's past average CPU usage on this machine exceeds
+   the cpuBudget or cpuBudgetOnBattery preference. */
+extern Bool hack_over_budget_p (saver_info *, const char *name);
+
+#endif /* __XSCREENSAVER_HACKSTATS_H__ */
@@ -52,6 +52,7 @@ static char *format_command (const char *cmd, Bool wrap_p);
 static void merge_system_screenhacks (Display *, saver_preferences *,
                                       screenhack **system_list, int count);
 static void stop_the_insanity (saver_preferences *p);
+static unsigned long get_byte_resource (Display *, char *, char *);
 
 static char *format_hack (Display *, screenhack *, Bool wrap_p);
 
@@ -140,6 +141,7 @@ init_file_tmp_name (void)
 static const char * const prefs[] = {
   "timeout",
   "cycle",
+  "prewarmSeconds",
   "lock",
   "lockVTs",			/* not saved */
   "lockTimeout",
@@ -157,7 +159,12 @@ static const char * const prefs[] = {
   "loadURL",			/* not saved */
   "newLoginCommand",		/* not saved */
   "nice",
-  "memoryLimit",		/* not saved */
+  "hackStats",
+  "cpuBudget",
+  "cpuBudgetOnBattery",
+  "memoryLimit",
+  "cpuLimit",
+  "threadLimit",
   "fade",
   "unfade",
   "fadeSeconds",
@@ -564,6 +571,7 @@ write_init_file (Display *dpy,
       } type = pref_str;
       const char *s = 0;
       int i = 0;
+      unsigned long l = 0;
       Bool b = False;
       Time t = 0;
 
@@ -578,6 +586,7 @@ write_init_file (Display *dpy,
       if (!pr || !*pr)		;
       CHECK("timeout")		type = pref_time, t = p->timeout;
       CHECK("cycle")		type = pref_time, t = p->cycle;
+      CHECK("prewarmSeconds")	type = pref_time, t = p->prewarm;
       CHECK("lock")		type = pref_bool, b = p->lock_p;
       CHECK("lockVTs")		continue;  /* don't save, unused */
       CHECK("lockTimeout")	type = pref_time, t = p->lock_timeout;
@@ -596,7 +605,12 @@ write_init_file (Display *dpy,
       CHECK("dialogTheme")      type = pref_str,  s = p->dialog_theme;
       CHECK("settingsGeom")     type = pref_str,  s = p->settings_geom;
       CHECK("nice")		type = pref_int,  i = p->nice_inferior;
-      CHECK("memoryLimit")	continue;  /* don't save */
+      CHECK("hackStats")	type = pref_bool, b = p->hack_stats_p;
+      CHECK("cpuBudget")	type = pref_int,  i = p->cpu_budget;
+      CHECK("cpuBudgetOnBattery") type = pref_int, i = p->battery_cpu_budget;
+      CHECK("memoryLimit")	type = pref_byte, l = p->inferior_memory_limit;
+      CHECK("cpuLimit")		type = pref_int,  i = p->inferior_cpu_limit;
+      CHECK("threadLimit")	type = pref_int,  i = p->inferior_thread_limit;
       CHECK("fade")		type = pref_bool, b = p->fade_p;
       CHECK("unfade")		type = pref_bool, b = p->unfade_p;
       CHECK("fadeSeconds")	type = pref_time, t = p->fade_seconds;
@@ -682,14 +696,14 @@ write_init_file (Display *dpy,
 	  break;
 	case pref_byte:
 	  {
-            if      (i >= (1<<30) && i == ((i >> 30) << 30))
-              sprintf(buf, "%dG", i >> 30);
-            else if (i >= (1<<20) && i == ((i >> 20) << 20))
-              sprintf(buf, "%dM", i >> 20);
-            else if (i >= (1<<10) && i == ((i >> 10) << 10))
-              sprintf(buf, "%dK", i >> 10);
+            if      (l >= (1L<<30) && l == ((l >> 30) << 30))
+              sprintf(buf, "%luG", l >> 30);
+            else if (l >= (1L<<20) && l == ((l >> 20) << 20))
+              sprintf(buf, "%luM", l >> 20);
+            else if (l >= (1L<<10) && l == ((l >> 10) << 10))
+              sprintf(buf, "%luK", l >> 10);
             else
-              sprintf(buf, "%d", i);
+              sprintf(buf, "%lu", l);
             s = buf;
           }
 	  break;
@@ -835,6 +849,15 @@ load_init_file (Display *dpy, saver_preferences *p)
   p->fade_seconds   = 1000 * get_seconds_resource (dpy, "fadeSeconds", "Time");
   p->install_cmap_p = get_boolean_resource (dpy, "installColormap", "Boolean");
   p->nice_inferior  = get_integer_resource (dpy, "nice", "Nice");
+  p->hack_stats_p   = get_boolean_resource (dpy, "hackStats", "Boolean");
+  p->cpu_budget     = get_integer_resource (dpy, "cpuBudget", "Integer");
+  p->battery_cpu_budget = get_integer_resource (dpy, "cpuBudgetOnBattery",
+                                                "Integer");
+  p->inferior_memory_limit = get_byte_resource (dpy, "memoryLimit",
+                                                "MemoryLimit");
+  p->inferior_cpu_limit    = get_integer_resource (dpy, "cpuLimit", "Integer");
+  p->inferior_thread_limit = get_integer_resource (dpy, "threadLimit",
+                                                   "Integer");
   p->splash_p       = get_boolean_resource (dpy, "splash", "Boolean");
   p->ignore_uninstalled_p = get_boolean_resource (dpy, 
                                                   "ignoreUninstalledPrograms",
@@ -844,6 +867,7 @@ load_init_file (Display *dpy, saver_preferences *p)
   p->timeout         = 1000 * get_minutes_resource (dpy, "timeout", "Time");
   p->lock_timeout    = 1000 * get_minutes_resource (dpy, "lockTimeout", "Time");
   p->cycle           = 1000 * get_minutes_resource (dpy, "cycle", "Time");
+  p->prewarm         = 1000 * get_seconds_resource (dpy, "prewarmSeconds", "Time");
   p->passwd_timeout  = 1000 * get_seconds_resource (dpy, "passwdTimeout", "Time");
   p->pointer_hysteresis = get_integer_resource (dpy, "pointerHysteresis","Integer");
 
@@ -1328,6 +1352,32 @@ get_screenhacks (Display *dpy, saver_preferences *p)
 }
 
 
+/* Parses "0", "512K", "64M", "2G", etc.
+ */
+static unsigned long
+get_byte_resource (Display *dpy, char *name, char *class)
+{
+  char *s = get_string_resource (dpy, name, class);
+  double n = 0;
+  char c = 0;
+  if (!s) return 0;
+  if (sscanf (s, " %lf %c", &n, &c) < 1 || n < 0)
+    {
+      fprintf (stderr, "%s: %s must be a number of bytes, not \"%s\"\n",
+               blurb(), name, s);
+      n = 0;
+    }
+  free (s);
+  switch (c) {
+  case 'g': case 'G': n *= 1024;  /* fall through */
+  case 'm': case 'M': n *= 1024;  /* fall through */
+  case 'k': case 'K': n *= 1024;  /* fall through */
+  default: break;
+  }
+  return (unsigned long) n;
+}
+
+
 /* Make sure all the values in the preferences struct are sane.
  */
 static void
@@ -1336,6 +1386,7 @@ stop_the_insanity (saver_preferences *p)
   if (p->passwd_timeout <= 0) p->passwd_timeout = 30000;	 /* 30 secs */
   if (p->timeout < 15000) p->timeout = 15000;			 /* 15 secs */
   if (p->cycle != 0 && p->cycle < 2000) p->cycle = 2000;	 /*  2 secs */
+  if (p->prewarm > 60000) p->prewarm = 60000;			 /* 60 secs */
   if (p->fade_seconds <= 0)
     p->fade_p = False;
   if (! p->fade_p) p->unfade_p = False;
@@ -1374,6 +1425,18 @@ stop_the_insanity (saver_preferences *p)
 
   if (p->pointer_hysteresis < 0)   p->pointer_hysteresis = 0;
 
+  if (p->cpu_budget < 0)         p->cpu_budget = 0;
+  if (p->battery_cpu_budget < 0) p->battery_cpu_budget = 0;
+
+  /* A hack can't do much with less than this. */
+  if (p->inferior_memory_limit != 0 &&
+      p->inferior_memory_limit < 16 * 1024 * 1024)
+    p->inferior_memory_limit = 16 * 1024 * 1024;
+  if (p->inferior_cpu_limit < 0)    p->inferior_cpu_limit = 0;
+  if (p->inferior_thread_limit < 0) p->inferior_thread_limit = 0;
+  if (p->inferior_thread_limit > 0 && p->inferior_thread_limit < 4)
+    p->inferior_thread_limit = 4;
+
   if (p->auth_warning_slack < 0)   p->auth_warning_slack = 0;
   if (p->auth_warning_slack > 300) p->auth_warning_slack = 300;
 }
@@ -0,0 +1,342 @@
+/* sandbox.c --- limiting the CPU, memory and threads used by screenhacks.
+ * xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+/* On multi-seat machines, one seat's screensaver should not be able to eat
+   every core or all of memory.  "nice" only helps when something else wants
+   the CPU.
+
+   On Linux with cgroup v2, each hack gets its own cgroup beneath ours, with
+   "cpu.max", "memory.max" and "pids.max" set from cpuLimit, memoryLimit and
+   threadLimit.  For that to work, the cgroup that xscreensaver was launched
+   in must have been delegated to the user, e.g. by "Delegate=yes" in the
+   systemd unit.  Since a cgroup that has child cgroups with controllers
+   can't also contain processes, we first move ourselves and our parent into
+   a leaf cgroup next to the hacks' cgroups.
+
+   Otherwise, we fall back to setrlimit(RLIMIT_AS) for memoryLimit, and
+   cpuLimit and threadLimit are not enforced: RLIMIT_CPU and RLIMIT_NPROC
+   measure something different, and would kill the hack rather than slow
+   it down.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>		/* sys/resource.h needs this for timeval */
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_SETRLIMIT
+# include <sys/resource.h>	/* for setrlimit() and RLIMIT_AS */
+#endif
+
+#include <X11/Xlib.h>
+#include <X11/Intrinsic.h>
+
+#ifdef ENABLE_NLS
+# include <locale.h>
+# include <libintl.h>
+# define _(S) gettext(S)
+#else
+# define _(S) (S)
+#endif
+
+#include "xscreensaver.h"
+#include "sandbox.h"
+
+#define CGROUP_FS   "/sys/fs/cgroup"
+#define CGROUP_LEAF "xscreensaver"	/* where the non-hack processes go */
+#define CPU_PERIOD  100000		/* microseconds */
+
+static char *cgroup_root = 0;		/* our delegated cgroup */
+static int cgroup_state = 0;		/* 0 = untried, 1 = ok, -1 = no */
+
+
+Bool
+sandbox_enabled_p (saver_preferences *p)
+{
+  return (p->inferior_memory_limit > 0 ||
+          p->inferior_cpu_limit > 0 ||
+          p->inferior_thread_limit > 0);
+}
+
+
+#ifdef __linux__
+
+static Bool
+write_file (const char *dir, const char *file, const char *value)
+{
+  char path[1024];
+  int fd, L = strlen (value);
+  Bool ok;
+  sprintf (path, "%.900s/%.100s", dir, file);
+  fd = open (path, O_WRONLY);
+  if (fd < 0) return False;
+  ok = (write (fd, value, L) == L);
+  close (fd);
+  return ok;
+}
+
+
+/* Returns the value following "key " in a "key value" file, or -1. */
+static long
+read_key (const char *dir, const char *file, const char *key)
+{
+  char path[1024], buf[255];
+  int L = strlen (key);
+  long result = -1;
+  FILE *f;
+  sprintf (path, "%.900s/%.100s", dir, file);
+  f = fopen (path, "r");
+  if (!f) return -1;
+  while (fgets (buf, sizeof(buf)-1, f))
+    if (!strncmp (buf, key, L) && buf[L] == ' ')
+      {
+        result = atol (buf + L + 1);
+        break;
+      }
+  fclose (f);
+  return result;
+}
+
+
+/* Find the cgroup we are in, and move every process in it into a leaf.
+ */
+static Bool
+cgroup_init (saver_info *si)
+{
+  saver_preferences *p = &si->prefs;
+  char buf[1024], leaf[1100];
+  const char *why = 0;
+  FILE *f;
+  char *s;
+
+  if (cgroup_state)
+    return (cgroup_state > 0);
+  cgroup_state = -1;
+
+  /* On a v2-only system, this is the single line "0::/path". */
+  f = fopen ("/proc/self/cgroup", "r");
+  *buf = 0;
+  if (f)
+    {
+      while (fgets (buf, sizeof(buf)-1, f))
+        if (!strncmp (buf, "0::/", 4))
+          break;
+        else
+          *buf = 0;
+      fclose (f);
+    }
+  if (!*buf)
+    {
+      why = "no cgroup v2 hierarchy";
+      goto FAIL;
+    }
+  if ((s = strchr (buf, '\n'))) *s = 0;
+
+  /* If a previous xscreensaver-gfx already did this, xscreensaver and
+     therefore we are in the leaf: use its parent. */
+  s = strrchr (buf + 3, '/');
+  if (s && !strcmp (s + 1, CGROUP_LEAF))
+    *s = 0;
+
+  cgroup_root = (char *) malloc (strlen (CGROUP_FS) + strlen (buf + 3) + 2);
+  strcpy (cgroup_root, CGROUP_FS);
+  strcat (cgroup_root, (buf[4] ? buf + 3 : ""));
+
+  sprintf (leaf, "%.900s/%s", cgroup_root, CGROUP_LEAF);
+  if (mkdir (leaf, 0755) && errno != EEXIST)
+    {
+      why = "cgroup not delegated";
+      goto FAIL;
+    }
+
+  /* Evict everyone (xscreensaver, us, maybe xscreensaver-auth) into the
+     leaf.  Moving a process requires write access to the common ancestor,
+     which we have if the cgroup was delegated. */
+  sprintf (buf, "%.900s/cgroup.procs", cgroup_root);
+  f = fopen (buf, "r");
+  if (f)
+    {
+      while (fgets (buf, sizeof(buf)-1, f))
+        if (!write_file (leaf, "cgroup.procs", buf))
+          {
+            fclose (f);
+            why = "unable to move processes";
+            goto FAIL;
+          }
+      fclose (f);
+    }
+
+  cgroup_state = 1;
+  if (p->verbose_p)
+    fprintf (stderr, "%s: hack cgroups are in %s\n", blurb(), cgroup_root);
+  return True;
+
+ FAIL:
+  if (p->verbose_p)
+    fprintf (stderr, "%s: %s: using setrlimit instead of cgroups\n",
+             blurb(), why);
+  return False;
+}
+
+#endif /* __linux__ */
+
+
+char *
+sandbox_create (saver_info *si, int screen)
+{
+#ifdef __linux__
+  saver_preferences *p = &si->prefs;
+  static int count = 0;
+  char dir[1024], buf[100];
+
+  if (!sandbox_enabled_p (p) || !cgroup_init (si))
+    return 0;
+
+  /* Idempotent, and the limits may have changed since last time. */
+  if ((p->inferior_cpu_limit &&
+       !write_file (cgroup_root, "cgroup.subtree_control", "+cpu")) ||
+      (p->inferior_memory_limit &&
+       !write_file (cgroup_root, "cgroup.subtree_control", "+memory")) ||
+      (p->inferior_thread_limit &&
+       !write_file (cgroup_root, "cgroup.subtree_control", "+pids")))
+    {
+      if (p->verbose_p)
+        fprintf (stderr, "%s: unable to enable cgroup controllers in %s\n",
+                 blurb(), cgroup_root);
+      return 0;
+    }
+
+  sprintf (dir, "%.900s/hack-%d-%ld-%d", cgroup_root, screen,
+           (long) getpid(), count++);
+  if (mkdir (dir, 0755))
+    {
+      if (p->verbose_p)
+        {
+          sprintf (buf, "%s: mkdir", blurb());
+          perror (buf);
+        }
+      return 0;
+    }
+
+  if (p->inferior_cpu_limit)
+    {
+      sprintf (buf, "%ld %d",
+               (long) p->inferior_cpu_limit * CPU_PERIOD / 100, CPU_PERIOD);
+      write_file (dir, "cpu.max", buf);
+    }
+  if (p->inferior_memory_limit)
+    {
+      sprintf (buf, "%lu", p->inferior_memory_limit);
+      write_file (dir, "memory.max", buf);
+      write_file (dir, "memory.swap.max", "0");  /* Die, don't thrash. */
+    }
+  if (p->inferior_thread_limit)
+    {
+      sprintf (buf, "%d", p->inferior_thread_limit);
+      write_file (dir, "pids.max", buf);
+    }
+
+  return strdup (dir);
+#else  /* !__linux__ */
+  return 0;
+#endif /* !__linux__ */
+}
+
+
+void
+sandbox_enter (saver_preferences *p, const char *cgroup)
+{
+#ifdef __linux__
+  if (cgroup)
+    {
+      if (write_file (cgroup, "cgroup.procs", "0"))
+        return;
+      fprintf (stderr, "%s: unable to join %s\n", blurb(), cgroup);
+    }
+#endif /* __linux__ */
+
+#if defined(HAVE_SETRLIMIT) && defined(RLIMIT_AS)
+  if (p->inferior_memory_limit)
+    {
+      struct rlimit r;
+      r.rlim_cur = r.rlim_max = p->inferior_memory_limit;
+      if (setrlimit (RLIMIT_AS, &r) != 0)
+        {
+          char buf[512];
+          sprintf (buf, "%s: setrlimit(RLIMIT_AS, %lu) failed",
+                   blurb(), p->inferior_memory_limit);
+          perror (buf);
+        }
+    }
+#endif /* HAVE_SETRLIMIT && RLIMIT_AS */
+}
+
+
+Bool
+sandbox_destroy (saver_info *si, const char *cgroup,
+                 const char *name, int screen,
+                 char *msg, int msg_size)
+{
+  Bool oom_p = False;
+#ifdef __linux__
+  saver_preferences *p = &si->prefs;
+  long oom, throttled;
+  char buf[255];
+
+  if (!cgroup) return False;
+
+  oom = read_key (cgroup, "memory.events", "oom_kill");
+  throttled = read_key (cgroup, "cpu.stat", "nr_throttled");
+
+  if (oom > 0)
+    {
+      unsigned long mb = p->inferior_memory_limit >> 20;
+      sprintf (buf, _("was killed for using more than %lu MB of memory"), mb);
+      oom_p = True;
+      if (p->verbose_p)
+        fprintf (stderr, "%s: %d: %s exceeded memoryLimit of %lu MB\n",
+                 blurb(), screen, name, mb);
+      strncpy (msg, buf, msg_size - 1);
+      msg[msg_size-1] = 0;
+    }
+  else if (throttled > 0)
+    {
+      if (p->verbose_p)
+        fprintf (stderr, "%s: %d: %s was throttled by cpuLimit %ld times\n",
+                 blurb(), screen, name, throttled);
+      /* If it crashed anyway, mention that in the obituary. */
+      if (*msg && strlen (msg) + 40 < (size_t) msg_size)
+        strcat (msg, _(" (while limited by cpuLimit)"));
+    }
+
+  /* Kill anything the hack left behind, or rmdir will fail. */
+  write_file (cgroup, "cgroup.kill", "1");
+  if (rmdir (cgroup) && p->verbose_p)
+    {
+      sprintf (buf, "%s: rmdir %.100s", blurb(), cgroup);
+      perror (buf);
+    }
+#endif /* __linux__ */
+  return oom_p;
+}
@@ -0,0 +1,35 @@
+/* xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#ifndef __XSCREENSAVER_SANDBOX_H__
+#define __XSCREENSAVER_SANDBOX_H__
+
+/* Whether any of cpuLimit, memoryLimit or threadLimit are set. */
+extern Bool sandbox_enabled_p (saver_preferences *);
+
+/* In the parent, before forking: creates a cgroup for the next hack with
+   the configured limits, and returns its directory, or 0 if cgroups are
+   not usable (in which case sandbox_enter falls back to setrlimit). */
+extern char *sandbox_create (saver_info *, int screen);
+
+/* In the child, after forking and before exec: moves this process into
+   the cgroup, or applies setrlimit() limits if there isn't one. */
+extern void sandbox_enter (saver_preferences *, const char *cgroup);
+
+/* In the parent, after the hack has been reaped: removes the cgroup.
+   Returns True and fills in 'msg' if the hack was killed by the memory
+   limit, or appends to it if the hack had been throttled by the CPU
+   limit. */
+extern Bool sandbox_destroy (saver_info *, const char *cgroup,
+                             const char *name, int screen,
+                             char *msg, int msg_size);
+
+#endif /* __XSCREENSAVER_SANDBOX_H__ */
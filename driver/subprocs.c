@@ -59,6 +59,8 @@
 #include "visual.h"		/* for id_to_visual() */
 #include "atoms.h"
 #include "screenshot.h"
+#include "hackstats.h"
+#include "sandbox.h"
 
 #ifdef USE_GL
 # include "visual-gl.h"
@@ -74,14 +76,13 @@ enum job_status {
 		   element will be removed. */
 };
 
-#define EXEC_FAILED_EXIT_STATUS -33
-
 struct screenhack_job {
   char *name;
   pid_t pid;
   int screen;
   enum job_status status;
   time_t launched, killed;
+  char *cgroup;			/* from sandbox_create(), or 0 */
   struct screenhack_job *next;
 };
 
@@ -212,18 +213,17 @@ show_job_list (void)
 #endif /* DEBUG */
 
 
-static void
-make_job (pid_t pid, int screen, const char *cmd)
+/* Returns the name of the program that the command will run.
+   The result is in a static buffer.
+ */
+static const char *
+hack_program_name (const char *cmd)
 {
-  struct screenhack_job *job = (struct screenhack_job *) malloc (sizeof(*job));
-
   static char name [1024];
   const char *in = cmd;
   char *out = name;
   int got_eq = 0;
 
-  clean_job_list();
-
  AGAIN:
   while (*in && isspace(*in)) in++;		/* skip whitespace */
   while (*in && !isspace(*in) && *in != ':') {
@@ -240,15 +240,27 @@ make_job (pid_t pid, int screen, const char *cmd)
 
   while (*in && isspace(*in)) in++;		/* skip whitespace */
   *out = 0;
+  return name;
+}
 
-  job->name = strdup(name);
+
+static struct screenhack_job *
+make_job (pid_t pid, int screen, const char *cmd)
+{
+  struct screenhack_job *job = (struct screenhack_job *) malloc (sizeof(*job));
+
+  clean_job_list();
+
+  job->name = strdup (hack_program_name (cmd));
   job->pid = pid;
   job->screen = screen;
   job->status = job_running;
   job->launched = time ((time_t *) 0);
   job->killed = 0;
+  job->cgroup = 0;
   job->next = jobs;
   jobs = job;
+  return job;
 }
 
 
@@ -272,6 +284,7 @@ free_job (struct screenhack_job *job)
 	  }
     }
   free(job->name);
+  if (job->cgroup) free (job->cgroup);
   free(job);
 }
 
@@ -669,6 +682,16 @@ describe_dead_child (saver_info *si, pid_t kid, int wait_status,
 	job->status = job_dead;
     }
 
+  if (job && job->status == job_dead)
+    hack_stats_record (si, name, job->launched, time ((time_t *) 0), &rus);
+
+  if (job && job->status == job_dead && job->cgroup)
+    {
+      sandbox_destroy (si, job->cgroup, name, screen_no, msg, sizeof(msg));
+      free (job->cgroup);
+      job->cgroup = 0;
+    }
+
 # ifdef LOG_CPU_TIME
   if (p->verbose_p && job && job->status == job_dead)
     {
@@ -692,6 +715,13 @@ describe_dead_child (saver_info *si, pid_t kid, int wait_status,
               if (*msg)
                 screenhack_obituary (ssi, name, msg);
             }
+          else if (kid == ssi->prewarm_pid)
+            {
+              /* Nobody has seen it yet, so no obituary: cycle_timer will
+                 just launch a new hack the slow way. */
+              ssi->prewarm_pid = 0;
+              discard_prewarm_window (ssi);
+            }
         }
     }
 }
@@ -719,8 +749,11 @@ init_sigchld (saver_info *si)
 }
 
 
-static void
-hack_subproc_environment (Screen *screen, Window saver_window)
+/* Returns the "DISPLAY=..." and "XSCREENSAVER_WINDOW=..." settings for
+   a hack, as a null-terminated array.  Everything is malloced.
+ */
+static char **
+hack_subproc_env (Screen *screen, Window saver_window)
 {
   /* Store $DISPLAY into the environment, so that the $DISPLAY variable that
      the spawned processes inherit is correct.  First, it must be on the same
@@ -737,7 +770,9 @@ hack_subproc_environment (Screen *screen, Window saver_window)
      them.  In that case, multiple hacks have the same $DISPLAY, screen and
      root window.
    */
+  char **env = (char **) calloc (3, sizeof(*env));
   char *nssw = (char *) malloc (40);
+  int n = 0;
 
 # if !(defined(__APPLE__) && !defined(HAVE_COCOA))  /* not macOS X11 */
   /* XQuartz's weird $DISPLAY pathnames do not match DisplayString() */
@@ -761,17 +796,38 @@ hack_subproc_environment (Screen *screen, Window saver_window)
   if (s[-1] != '.') *s++ = '.';			/* put on a dot */
   sprintf(s, "%d", screen_number (screen));	/* put on screen number */
 
-  if (putenv (ndpy))
-    abort ();
+  env[n++] = ndpy;
 # endif  /* not macOS X11 */
 
   sprintf (nssw, "XSCREENSAVER_WINDOW=0x%lX", (unsigned long) saver_window);
-  if (putenv (nssw))
-    abort ();
+  env[n++] = nssw;
+  return env;
+}
 
-  /* don't free ndpy/nssw -- some implementations of putenv (BSD 4.4,
+
+static void
+free_subproc_env (char **env)
+{
+  int i;
+  for (i = 0; env[i]; i++)
+    free (env[i]);
+  free (env);
+}
+
+
+static void
+hack_subproc_environment (Screen *screen, Window saver_window)
+{
+  char **env = hack_subproc_env (screen, saver_window);
+  int i;
+  for (i = 0; env[i]; i++)
+    if (putenv (env[i]))
+      abort ();
+  free (env);
+
+  /* don't free the strings -- some implementations of putenv (BSD 4.4,
      glibc 2.0) copy the argument, but some (libc4,5, glibc 2.1.2)
-     do not.  So we must leak it (and/or the previous setting). Yay.
+     do not.  So we must leak them (and/or the previous setting). Yay.
    */
 }
 
@@ -799,40 +855,63 @@ abort_debug_timer (XtPointer closure, XtIntervalId *id)
    printed to stderr.
  */
 static pid_t
-fork_and_exec (saver_screen_info *ssi, const char *command)
+fork_and_exec (saver_screen_info *ssi, Window window, const char *command)
 {
   saver_info *si = ssi->global;
   saver_preferences *p = &si->prefs;
-  pid_t forked;
+  char *cgroup = sandbox_create (si, (ssi ? ssi->number : 0));
+  pid_t forked = 0;
 
-  switch ((int) (forked = fork ()))
+  /* If the child would only have had to set $DISPLAY, close a file and
+     set its nice level before exec'ing the hack, skip the fork.
+     Joining a cgroup or taking on rlimits still needs one. */
+  if (ssi && !sandbox_enabled_p (p))
+    {
+      char **env = hack_subproc_env (ssi->screen, window);
+      forked = spawn_command (command, env, ConnectionNumber (si->dpy),
+                              p->nice_inferior);
+      free_subproc_env (env);
+    }
+
+  if (! forked)
+    forked = fork ();
+
+  switch ((int) forked)
     {
     case -1:
       {
         char buf [255];
         sprintf (buf, "%s: couldn't fork", blurb());
         perror (buf);
+        if (cgroup)
+          {
+            *buf = 0;
+            sandbox_destroy (si, cgroup, command, (ssi ? ssi->number : 0),
+                             buf, sizeof(buf));
+            free (cgroup);
+          }
         break;
       }
 
     case 0:
       close (ConnectionNumber (si->dpy));	/* close display fd */
       if (ssi)
-        hack_subproc_environment (ssi->screen, ssi->screensaver_window);
+        hack_subproc_environment (ssi->screen, window);
 
+      sandbox_enter (p, cgroup);
       exec_command (p->shell, command, p->nice_inferior);
       /* If that returned, we were unable to exec the subprocess. */
       exit (EXEC_FAILED_EXIT_STATUS);  /* exits child fork */
       break;
 
     default:	/* parent */
-      make_job (forked, (ssi ? ssi->number : 0), command);
+      make_job (forked, (ssi ? ssi->number : 0), command)->cgroup = cgroup;
       if (p->verbose_p)
         fprintf (stderr, "%s: %d: forked \"%s\" in pid %lu"
                  " on window 0x%lx\n",
                  blurb(), (ssi ? ssi->number : 0), command,
                  (unsigned long) forked,
-                 (unsigned long) ssi->screensaver_window);
+                 (unsigned long) window);
       break;
     }
 
@@ -847,16 +926,18 @@ fork_and_exec (saver_screen_info *ssi, const char *command)
 
 
 static Bool
-select_visual_of_hack (saver_screen_info *ssi, screenhack *hack)
+select_visual_of_hack (saver_screen_info *ssi, screenhack *hack,
+                       Bool prewarm_p)
 {
   saver_info *si = ssi->global;
   saver_preferences *p = &si->prefs;
+  const char *visual = (hack->visual && *hack->visual ? hack->visual : 0);
   Bool selected;
 
-  if (hack->visual && *hack->visual)
-    selected = select_visual(ssi, hack->visual);
+  if (prewarm_p)
+    selected = select_prewarm_visual (ssi, visual);
   else
-    selected = select_visual(ssi, 0);
+    selected = select_visual (ssi, visual);
 
   if (!selected && (p->verbose_p || si->demoing_p))
     fprintf (stderr,
@@ -871,8 +952,94 @@ select_visual_of_hack (saver_screen_info *ssi, screenhack *hack)
 }
 
 
-void
-spawn_screenhack (saver_screen_info *ssi)
+static void prewarm_timer (XtPointer closure, XtIntervalId *id);
+
+
+/* Queue the timers that will cycle to the next hack, and (optionally)
+   launch it early on a hidden window.
+ */
+static void
+queue_cycle_timer (saver_screen_info *ssi)
+{
+  saver_info *si = ssi->global;
+  saver_preferences *p = &si->prefs;
+  time_t now = time ((time_t *) 0);
+  Time how_long = p->cycle;
+
+  /* If we're in "SELECT n" mode, the cycle timer going off will just
+     restart this same hack again.  There's not much point in doing this
+     every 5 or 10 minutes, but on the other hand, leaving one hack
+     running for days is probably not a great idea, since they tend to
+     leak and/or crash.  So, restart the thing once an hour.
+   */
+  if (si->selection_mode > 0 && ssi->pid)
+    how_long = 1000 * 60 * 60;
+
+  /* If there are multiple screens, stagger the restart time of subsequent
+     screens: they will all change every N minutes, but not at the same
+     time.  But don't let that offset be more than about 5 minutes.
+
+     I originally did this by just adding an offset to the very first
+     cycle only, but after a few days, the cycles would synchronize again!
+     Are Xt timers implemented with Huygens pendulums??  So compare this
+     screen's target time against the previous screen's, and offset it as
+     needed.
+   */
+  if (ssi->number > 0 &&
+      p->mode != RANDOM_HACKS_SAME)
+    {
+      saver_screen_info *prev = &si->screens[ssi->number-1];
+      time_t cycle_at = now + how_long / 1000;
+      time_t prev_at  = prev->cycle_at;
+
+      Time max = 1000 * 60 * 60 * 10;
+      Time off = (how_long > max ? max : how_long) / si->nscreens;
+
+      if (cycle_at < prev_at + off / 1000)
+        {
+          time_t old = cycle_at;
+          cycle_at = prev_at + off / 1000;
+          how_long = 1000 * (cycle_at - now);
+
+          if (p->verbose_p && cycle_at - old > 2)
+            fprintf (stderr, "%s: %d: offsetting cycle time by %ld sec\n",
+                     blurb(), ssi->number,
+                     cycle_at - old);
+        }
+    }
+
+  if (p->debug_p)
+    fprintf (stderr, "%s: %d: starting cycle_timer (%ld)\n",
+             blurb(), ssi->number, how_long);
+
+  if (ssi->cycle_id)
+    XtRemoveTimeOut (ssi->cycle_id);
+  ssi->cycle_id =
+    XtAppAddTimeOut (si->app, how_long, cycle_timer, (XtPointer) ssi);
+  ssi->cycle_at = now + how_long / 1000;
+
+  if (p->verbose_p)
+    fprintf (stderr, "%s: %d: next cycle in %d:%02d:%02d at %s\n",
+             blurb(), ssi->number,
+             (int)  (how_long / 1000) / (60 * 60),
+             (int) ((how_long / 1000) % (60 * 60)) / 60,
+             (int)  (how_long / 1000) % 60,
+             timestring (ssi->cycle_at));
+
+  /* Launch the next hack a few seconds early, so that it has finished
+     loading by the time it is raised.  Don't bother if the hack would
+     spend most of its life hidden. */
+  if (ssi->prewarm_id)
+    XtRemoveTimeOut (ssi->prewarm_id);
+  ssi->prewarm_id = 0;
+  if (p->prewarm && how_long > p->prewarm * 2)
+    ssi->prewarm_id = XtAppAddTimeOut (si->app, how_long - p->prewarm,
+                                       prewarm_timer, (XtPointer) ssi);
+}
+
+
+static void
+spawn_screenhack_1 (saver_screen_info *ssi, Bool prewarm_p)
 {
   saver_info *si = ssi->global;
   saver_preferences *p = &si->prefs;
@@ -880,6 +1047,9 @@ spawn_screenhack (saver_screen_info *ssi)
 
   if (!monitor_powered_on_p (si))
     {
+      if (prewarm_p)
+        return;
+
       if (si->prefs.verbose_p)
         fprintf (stderr,
                  "%s: %d: X says monitor has powered down; "
@@ -903,6 +1073,7 @@ spawn_screenhack (saver_screen_info *ssi)
     {
       screenhack *hack;
       pid_t forked;
+      Window window;
       char buf [255];
       int new_hack = -1;
       int retry_count = 0;
@@ -957,7 +1128,10 @@ spawn_screenhack (saver_screen_info *ssi)
 	  /* Use the same hack that's running on screen 0.
              (Assumes this function was called on screen 0 first.)
            */
-          new_hack = si->screens[0].current_hack;
+          if (prewarm_p && si->screens[0].prewarm_pid)
+            new_hack = si->screens[0].prewarm_hack;
+          else
+            new_hack = si->screens[0].current_hack;
 	}
       else  /* (p->mode == RANDOM_HACKS) */
 	{
@@ -967,14 +1141,24 @@ spawn_screenhack (saver_screen_info *ssi)
 	    ;
 	}
 
-      if (new_hack < 0)   /* don't run a hack */
+      if (prewarm_p)
         {
-          ssi->current_hack = -1;
-          goto DONE;
+          /* The currently-visible hack is unaffected by what we pick. */
+          if (new_hack < 0)
+            return;
+          ssi->prewarm_hack = new_hack;
         }
+      else
+        {
+          if (new_hack < 0)   /* don't run a hack */
+            {
+              ssi->current_hack = -1;
+              goto DONE;
+            }
 
-      ssi->current_hack = new_hack;
-      hack = p->screenhacks[ssi->current_hack];
+          ssi->current_hack = new_hack;
+        }
+      hack = p->screenhacks[new_hack];
 
       /* If the hack is disabled, or there is no visual for this hack,
 	 then try again (move forward, or backward, or re-randomize.)
@@ -982,12 +1166,15 @@ spawn_screenhack (saver_screen_info *ssi)
 	 use it regardless.
        */
       if (force)
-        select_visual_of_hack (ssi, hack);
+        select_visual_of_hack (ssi, hack, prewarm_p);
         
       if (!force &&
 	  (!hack->enabled_p ||
 	   !on_path_p (hack->command) ||
-	   !select_visual_of_hack (ssi, hack)))
+           /* If every hack is over budget, run something anyway. */
+           (retry_count < p->screenhacks_count * 2 &&
+            hack_over_budget_p (si, hack_program_name (hack->command))) ||
+	   !select_visual_of_hack (ssi, hack, prewarm_p)))
 	{
 	  if (++retry_count > (p->screenhacks_count*4))
 	    {
@@ -1000,16 +1187,20 @@ spawn_screenhack (saver_screen_info *ssi)
 		fprintf(stderr,
 		      "%s: %d: no programs enabled, or no suitable visuals\n",
 			blurb(), ssi->number);
+              if (prewarm_p)
+                discard_prewarm_window (ssi);
 	      return;
 	    }
 	  else
 	    goto AGAIN;
 	}
 
+      window = (prewarm_p ? ssi->prewarm_window : ssi->screensaver_window);
+
       /* Install screenshot property on window. Must be after
          select_visual_of_hack() which might replace the window. */
       if (ssi->screenshot)
-        screenshot_save (si->dpy, ssi->screensaver_window, ssi->screenshot);
+        screenshot_save (si->dpy, window, ssi->screenshot);
 
       if (getuid() == (uid_t) 0 || geteuid() == (uid_t) 0)
         /* Prior to XScreenSaver 6, if running as root, we would change the
@@ -1017,6 +1208,11 @@ spawn_screenhack (saver_screen_info *ssi)
            but even that was just encouraging bad behavior.  Don't log in
            as root. */
         {
+          if (prewarm_p)
+            {
+              discard_prewarm_window (ssi);
+              return;
+            }
           fprintf (stderr, "%s: %d: running as root: not launching hacks.\n",
                    blurb(), ssi->number);
           screenhack_obituary (ssi, "", "XScreenSaver: Don't log in as root.");
@@ -1039,12 +1235,17 @@ spawn_screenhack (saver_screen_info *ssi)
 
              Install all of XScreenSaver or none.
            */
+          if (prewarm_p)
+            {
+              discard_prewarm_window (ssi);
+              return;
+            }
           screenhack_obituary (ssi, "",
             "No GL visuals: the xscreensaver-gl* packages are required.");
           goto DONE;
         }
 
-      forked = fork_and_exec (ssi, hack->command);
+      forked = fork_and_exec (ssi, window, hack->command);
       switch ((int) forked)
 	{
 	case -1: /* fork failed */
@@ -1055,19 +1256,27 @@ spawn_screenhack (saver_screen_info *ssi)
 	  break;
 
 	default:
-	  ssi->pid = forked;
+          if (prewarm_p)
+            ssi->prewarm_pid = forked;
+          else
+            ssi->pid = forked;
 	  break;
 	}
 
-      XChangeProperty (si->dpy, ssi->screensaver_window, XA_WM_COMMAND,
+      XChangeProperty (si->dpy, window, XA_WM_COMMAND,
                        XA_STRING, 8, PropModeReplace,
                        (unsigned char *) hack->command,
                        strlen (hack->command));
-      XChangeProperty (si->dpy, ssi->screensaver_window, XA_NET_WM_PID,
+      XChangeProperty (si->dpy, window, XA_NET_WM_PID,
                        XA_CARDINAL, 32, PropModeReplace,
-                       (unsigned char *) &ssi->pid, 1);
+                       (unsigned char *) &forked, 1);
     }
 
+  /* The hidden hack becomes current, and has its timers queued, only once
+     cycle_timer raises it. */
+  if (prewarm_p)
+    return;
+
  DONE:
 
   if (ssi->current_hack < 0)
@@ -1084,70 +1293,109 @@ spawn_screenhack (saver_screen_info *ssi)
 
   /* Now that the hack has launched, queue a timer to cycle it. */
   if (!si->demoing_p && p->cycle)
-    {
-      time_t now = time ((time_t *) 0);
-      Time how_long = p->cycle;
-
-      /* If we're in "SELECT n" mode, the cycle timer going off will just
-         restart this same hack again.  There's not much point in doing this
-         every 5 or 10 minutes, but on the other hand, leaving one hack
-         running for days is probably not a great idea, since they tend to
-         leak and/or crash.  So, restart the thing once an hour.
-       */
-      if (si->selection_mode > 0 && ssi->pid)
-        how_long = 1000 * 60 * 60;
-
-      /* If there are multiple screens, stagger the restart time of subsequent
-         screens: they will all change every N minutes, but not at the same
-         time.  But don't let that offset be more than about 5 minutes.
-
-         I originally did this by just adding an offset to the very first
-         cycle only, but after a few days, the cycles would synchronize again!
-         Are Xt timers implemented with Huygens pendulums??  So compare this
-         screen's target time against the previous screen's, and offset it as
-         needed.
-       */
-      if (ssi->number > 0 &&
-          p->mode != RANDOM_HACKS_SAME)
-        {
-          saver_screen_info *prev = &si->screens[ssi->number-1];
-          time_t cycle_at = now + how_long / 1000;
-          time_t prev_at  = prev->cycle_at;
+    queue_cycle_timer (ssi);
+}
 
-          Time max = 1000 * 60 * 60 * 10;
-          Time off = (how_long > max ? max : how_long) / si->nscreens;
 
-          if (cycle_at < prev_at + off / 1000)
-            {
-              time_t old = cycle_at;
-              cycle_at = prev_at + off / 1000;
-              how_long = 1000 * (cycle_at - now);
-
-              if (p->verbose_p && cycle_at - old > 2)
-                fprintf (stderr, "%s: %d: offsetting cycle time by %ld sec\n",
-                         blurb(), ssi->number,
-                         cycle_at - old);
-            }
-        }
+void
+spawn_screenhack (saver_screen_info *ssi)
+{
+  spawn_screenhack_1 (ssi, False);
+}
+
+
+/* A few seconds before the cycle_timer fires, launch the next hack on a
+   hidden window so that it can get through its startup while the current
+   hack is still on screen.
+ */
+static void
+prewarm_timer (XtPointer closure, XtIntervalId *id)
+{
+  saver_screen_info *ssi = (saver_screen_info *) closure;
+  saver_info *si = ssi->global;
+  saver_preferences *p = &si->prefs;
 
-      if (p->debug_p)
-        fprintf (stderr, "%s: %d: starting cycle_timer (%ld)\n",
-                 blurb(), ssi->number, how_long);
+  ssi->prewarm_id = 0;
 
-      if (ssi->cycle_id)
-        XtRemoveTimeOut (ssi->cycle_id);
-      ssi->cycle_id =
-        XtAppAddTimeOut (si->app, how_long, cycle_timer, (XtPointer) ssi);
-      ssi->cycle_at = now + how_long / 1000;
+  /* Only for the ordinary cycle; NEXT, PREV and SELECT replace the hack
+     immediately, and an error dialog means the cycle time has changed. */
+  if (si->terminating_p ||
+      si->demoing_p ||
+      si->selection_mode != 0 ||
+      ssi->error_dialog ||
+      !ssi->cycle_id)
+    return;
 
-      if (p->verbose_p)
-        fprintf (stderr, "%s: %d: next cycle in %d:%02d:%02d at %s\n",
-                 blurb(), ssi->number,
-                 (int)  (how_long / 1000) / (60 * 60),
-                 (int) ((how_long / 1000) % (60 * 60)) / 60,
-                 (int)  (how_long / 1000) % 60,
-                 timestring (ssi->cycle_at));
+  kill_prewarmed_screenhack (ssi);
+  spawn_screenhack_1 (ssi, True);
+
+  if (p->verbose_p && ssi->prewarm_pid)
+    fprintf (stderr, "%s: %d: prewarming \"%s\" in pid %lu\n",
+             blurb(), ssi->number,
+             p->screenhacks[ssi->prewarm_hack]->command,
+             (unsigned long) ssi->prewarm_pid);
+}
+
+
+/* Called by cycle_timer.  If the next hack is already running on the
+   hidden window, raise that window, kill the old hack, and return True.
+   Otherwise return False, and the caller should launch a hack normally.
+ */
+Bool
+activate_prewarmed_screenhack (saver_screen_info *ssi)
+{
+  saver_info *si = ssi->global;
+  saver_preferences *p = &si->prefs;
+  pid_t old_pid = ssi->pid;
+
+  if (! ssi->prewarm_pid)
+    return False;
+
+  /* The init file may have been re-read since it was launched. */
+  if (!monitor_powered_on_p (si) ||
+      ssi->prewarm_hack >= p->screenhacks_count ||
+      (p->mode != ONE_HACK &&
+       !p->screenhacks[ssi->prewarm_hack]->enabled_p))
+    {
+      kill_prewarmed_screenhack (ssi);
+      return False;
     }
+
+  /* Raise the new one before killing the old one, so the desktop never
+     shows through. */
+  swap_prewarm_window (ssi);
+  ssi->pid = ssi->prewarm_pid;
+  ssi->current_hack = ssi->prewarm_hack;
+  ssi->prewarm_pid = 0;
+
+  if (p->verbose_p)
+    fprintf (stderr, "%s: %d: raised prewarmed pid %lu (%s)\n",
+             blurb(), ssi->number, (unsigned long) ssi->pid,
+             p->screenhacks[ssi->current_hack]->command);
+
+  if (old_pid)
+    kill_job (si, old_pid, SIGTERM);
+
+  store_saver_status (si);  /* store current hack numbers */
+
+  if (!si->demoing_p && p->cycle)
+    queue_cycle_timer (ssi);
+
+  return True;
+}
+
+
+void
+kill_prewarmed_screenhack (saver_screen_info *ssi)
+{
+  saver_info *si = ssi->global;
+  if (ssi->prewarm_id)
+    XtRemoveTimeOut (ssi->prewarm_id);
+  ssi->prewarm_id = 0;
+  if (ssi->prewarm_pid)
+    kill_job (si, ssi->prewarm_pid, SIGTERM);
+  ssi->prewarm_pid = 0;
+  discard_prewarm_window (ssi);
 }
 
 
@@ -1159,6 +1407,8 @@ kill_screenhack (saver_screen_info *ssi)
     kill_job (si, ssi->pid, SIGTERM);
   ssi->pid = 0;
 
+  kill_prewarmed_screenhack (ssi);
+
   /* Do not clear ssi->current_hack here, see watchdog_timer(). */
 
   /* Hooray, this doesn't actually clear the window if it was OpenGL.
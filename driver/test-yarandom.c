@@ -1,4 +1,5 @@
-/* test-yarandom.c --- generate a file of random bytes for analysis.
+/* test-yarandom.c --- generate a file of random bytes for analysis,
+ * or check that ya_rng produces what it should.
  * xscreensaver, Copyright (c) 2018 Jamie Zawinski <jwz@jwz.org>
  *
  * Permission to use, copy, modify, distribute, and sell this software and its
@@ -21,28 +22,135 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 #include "blurb.h"
 #include "yarandom.h"
 
+#undef countof
+#define countof(x) ((int) (sizeof((x))/sizeof(*(x))))
+
+static int failures = 0;
+
+static void
+check (int ok, const char *what)
+{
+  if (! ok)
+    {
+      fprintf (stderr, "%s: FAIL: %s\n", progname, what);
+      failures++;
+    }
+}
+
+
+/* Compares ya_rng against the xoshiro128++ reference implementation, and
+   its helpers against each other.  Returns an exit status.
+ */
+static int
+check_rng (void)
+{
+  /* The first outputs from the state {1, 2, 3, 4}, and the state after a
+     jump from there, as computed by the reference code. */
+  static const unsigned int first[] = {
+    0x00000281, 0x00180387, 0xC0183387, 0xD1AE3B02 };
+  static const unsigned int jumped[] = {
+    0xA9765206, 0x797AA168, 0x5B62E331, 0x02ABD971 };
+  ya_rng a, b, c;
+  unsigned int buf[1000];
+  float fbuf[1000];
+  double sum;
+  int i, j, same;
+
+  a.s[0] = 1; a.s[1] = 2; a.s[2] = 3; a.s[3] = 4;
+  for (i = 0; i < countof(first); i++)
+    check (ya_rng_random (&a) == first[i], "xoshiro128++ output");
+
+  a.s[0] = 1; a.s[1] = 2; a.s[2] = 3; a.s[3] = 4;
+  ya_rng_split (&a, &b);
+  check (b.s[0] == 1 && b.s[1] == 2 && b.s[2] == 3 && b.s[3] == 4,
+         "split: child is the parent's old state");
+  for (i = 0; i < countof(jumped); i++)
+    check (a.s[i] == jumped[i], "split: parent jumped 2^64");
+
+  /* The child and parent streams should have nothing in common. */
+  ya_rng_fill (&b, buf, countof(buf));
+  same = 0;
+  for (i = 0; i < countof(buf); i++)
+    {
+      unsigned int v = ya_rng_random (&a);
+      for (j = 0; j < countof(buf); j++)
+        if (buf[j] == v) same++;
+    }
+  check (same == 0, "split: streams overlap");
+
+  /* Filling is the same as calling it n times. */
+  ya_rng_init (&a, 12345);
+  c = b = a;
+  ya_rng_fill (&a, buf, countof(buf));
+  for (i = 0; i < countof(buf); i++)
+    check (buf[i] == ya_rng_random (&b), "fill: differs from random");
+  check (! memcmp (&a, &b, sizeof(a)), "fill: state left behind");
+
+  ya_rng_fill_float (&c, fbuf, countof(fbuf), 10);
+  sum = 0;
+  for (i = 0; i < countof(fbuf); i++)
+    {
+      check (fbuf[i] >= 0 && fbuf[i] < 10, "fill_float: out of range");
+      sum += fbuf[i];
+    }
+  sum /= countof(fbuf);
+  check (sum > 4.5 && sum < 5.5, "fill_float: mean is not near 5");
+  check (! memcmp (&a, &c, sizeof(a)), "fill_float: state left behind");
+
+  /* Seeded from random(), so as repeatable as it is. */
+# undef ya_rand_init
+  ya_rand_init (42);
+  ya_rng_init (&a, 0);
+  ya_rand_init (42);
+  ya_rng_init (&b, 0);
+  check (! memcmp (&a, &b, sizeof(a)), "init: not repeatable");
+  check (a.s[0] | a.s[1] | a.s[2] | a.s[3], "init: state is all zero");
+
+  if (failures)
+    fprintf (stderr, "%s: %d failures\n", progname, failures);
+  else
+    fprintf (stderr, "%s: ya_rng OK\n", progname);
+  return (failures ? 1 : 0);
+}
+
+
 int
 main (int argc, char **argv)
 {
   unsigned long i, n;
   char *f;
   FILE *fd;
+  int rng_p = 0;
+  ya_rng rng;
 
   progname = argv[0];
+
+  if (argc == 2 && !strcmp (argv[1], "-check"))
+    exit (check_rng());
+
+  if (argc == 4 && !strcmp (argv[1], "-rng"))
+    {
+      rng_p = 1;
+      argc--;
+      argv++;
+    }
+
   if (argc != 3)
     {
-      fprintf(stderr, "usage: %s bytes outfile\n", argv[0]);
+      fprintf (stderr, "usage: %s [-rng] bytes outfile\n"
+               "       %s -check\n", progname, progname);
       exit(1);
     }
 
   n = atol (argv[1]);
   f = argv[2];
 
-# undef ya_rand_init
   ya_rand_init(0);
+  ya_rng_init (&rng, 0);
 
   fd = fopen (f, "w");
   if (!fd) { perror (f); exit (1); }
@@ -51,7 +159,7 @@ main (int argc, char **argv)
   for (i = 0; i < n; i++)
     {
       union { uint32_t i; char s[sizeof(uint32_t)]; } rr;
-      rr.i = random();
+      rr.i = (rng_p ? ya_rng_random (&rng) : random());
       if (! fwrite (rr.s, sizeof(rr.s), 1, fd))
         {
           perror ("write");
@@ -76,10 +76,21 @@ struct saver_preferences {
 
   int nice_inferior;		/* nice value for subprocs */
 
+  Bool hack_stats_p;		/* whether to record per-hack CPU and RSS */
+  int cpu_budget;		/* skip hacks averaging more than this
+				   percent of a core; 0 = unlimited */
+  int battery_cpu_budget;	/* the same, when running on battery */
+
+  unsigned long inferior_memory_limit;	/* bytes; 0 = unlimited */
+  int inferior_cpu_limit;	/* percent of one core; 0 = unlimited */
+  int inferior_thread_limit;	/* max threads per hack; 0 = unlimited */
+
   Time splash_duration;		/* how long the splash screen stays up */
   Time timeout;			/* how much idle time before activation */
   Time lock_timeout;		/* how long after activation locking starts */
   Time cycle;			/* how long each hack should run */
+  Time prewarm;			/* how long before the cycle to launch the
+				   next hack on a hidden window; 0 = never */
   Time passwd_timeout;		/* how long before pw dialog goes down */
   int pointer_hysteresis;	/* mouse motions less than N/sec are ignored */
 
@@ -212,6 +223,20 @@ struct saver_screen_info {
   time_t cycle_at;		/* When cycle_id will fire */
   int current_hack;		/* Index into `prefs.screenhacks' */
   pid_t pid;
+
+  /* When `prefs.prewarm' is set, the next hack is launched early on a second
+     saver window stacked directly beneath the visible one, and cycle_timer
+     raises it instead of launching from scratch.  These are the same as the
+     fields above, but for that hidden window. */
+  XtIntervalId prewarm_id;	/* Timer to launch the next hack early */
+  Window prewarm_window;
+  Colormap prewarm_cmap;
+  Bool prewarm_install_cmap_p;
+  Visual *prewarm_visual;
+  int prewarm_depth;
+  unsigned long prewarm_black_pixel;
+  int prewarm_hack;
+  pid_t prewarm_pid;
 };
 
 
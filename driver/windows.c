@@ -374,6 +374,9 @@ resize_screensaver_window (saver_info *si)
       saver_screen_info *ssi = &si->screens[i];
       XWindowAttributes xgwa;
 
+      /* The hidden window would be the wrong size now. */
+      kill_prewarmed_screenhack (ssi);
+
       /* Make sure a window exists -- it might not if a monitor was just
          added for the first time.
        */
@@ -689,8 +692,9 @@ get_screen_gl_visual (saver_info *si, int real_screen_number)
 }
 
 
-Bool
-select_visual (saver_screen_info *ssi, const char *visual_name)
+static Bool
+select_visual_1 (saver_screen_info *ssi, const char *visual_name,
+                 Bool raise_p)
 {
   XWindowAttributes xgwa;
   saver_info *si = ssi->global;
@@ -783,14 +787,18 @@ select_visual (saver_screen_info *ssi, const char *visual_name)
       ssi->screensaver_window = 0;
 
       initialize_screensaver_window_1 (ssi);
-      raise_window (ssi);
+      if (raise_p)
+        raise_window (ssi);
 
       /* Now we can destroy the old window without horking our grabs. */
-      defer_XDestroyWindow (si->app, si->dpy, old_w);
+      if (old_w)
+        {
+          defer_XDestroyWindow (si->app, si->dpy, old_w);
 
-      if (p->verbose_p > 1)
-	fprintf (stderr, "%s: %d: destroyed old saver window 0x%lx\n",
-		 blurb(), ssi->number, (unsigned long) old_w);
+          if (p->verbose_p > 1)
+            fprintf (stderr, "%s: %d: destroyed old saver window 0x%lx\n",
+                     blurb(), ssi->number, (unsigned long) old_w);
+        }
 
       if (old_c &&
 	  old_c != DefaultColormapOfScreen (ssi->screen))
@@ -801,6 +809,131 @@ select_visual (saver_screen_info *ssi, const char *visual_name)
 }
 
 
+Bool
+select_visual (saver_screen_info *ssi, const char *visual_name)
+{
+  return select_visual_1 (ssi, visual_name, True);
+}
+
+
+/* Creates a second saver window for this screen, with the visual that the
+   next hack wants, and maps it directly beneath the current saver window.
+   The next hack can then be launched on it and do its slow startup (loading
+   images, compiling shaders, etc.) while the current hack is still visible.
+   cycle_timer() brings it to the front with swap_prewarm_window().
+ */
+Bool
+select_prewarm_visual (saver_screen_info *ssi, const char *visual_name)
+{
+  saver_info *si = ssi->global;
+  saver_preferences *p = &si->prefs;
+  Window old_w          = ssi->screensaver_window;
+  Window old_e          = ssi->error_dialog;
+  Colormap old_c        = ssi->cmap;
+  Bool old_i            = ssi->install_cmap_p;
+  Visual *old_v         = ssi->current_visual;
+  int old_d             = ssi->current_depth;
+  unsigned long old_b   = ssi->black_pixel;
+  XWindowChanges changes;
+  Bool got_it;
+
+  discard_prewarm_window (ssi);
+
+  /* Build the new window through the usual path, then move the results
+     over to the prewarm fields and put the visible window's back. */
+  ssi->screensaver_window = 0;
+  ssi->error_dialog = 0;
+  ssi->cmap = 0;
+  got_it = select_visual_1 (ssi, visual_name, False);
+
+  ssi->prewarm_window         = ssi->screensaver_window;
+  ssi->prewarm_cmap           = ssi->cmap;
+  ssi->prewarm_install_cmap_p = ssi->install_cmap_p;
+  ssi->prewarm_visual         = ssi->current_visual;
+  ssi->prewarm_depth          = ssi->current_depth;
+  ssi->prewarm_black_pixel    = ssi->black_pixel;
+
+  ssi->screensaver_window = old_w;
+  ssi->error_dialog       = old_e;
+  ssi->cmap               = old_c;
+  ssi->install_cmap_p     = old_i;
+  ssi->current_visual     = old_v;
+  ssi->current_depth      = old_d;
+  ssi->black_pixel        = old_b;
+
+  /* Mapped, so that GL hacks get a drawable and everyone gets their Expose,
+     but obscured by the same-sized window above it. */
+  if (old_w)
+    {
+      changes.sibling = old_w;
+      changes.stack_mode = Below;
+      XConfigureWindow (si->dpy, ssi->prewarm_window,
+                        CWSibling | CWStackMode, &changes);
+    }
+  XMapWindow (si->dpy, ssi->prewarm_window);
+
+  if (p->verbose_p > 1)
+    fprintf (stderr, "%s: %d: prewarm window is 0x%lx\n",
+             blurb(), ssi->number, (unsigned long) ssi->prewarm_window);
+
+  return got_it;
+}
+
+
+/* Makes the prewarm window be the saver window, raises it, and discards
+   the old one.  The caller is responsible for the hacks running on them.
+ */
+void
+swap_prewarm_window (saver_screen_info *ssi)
+{
+  saver_info *si = ssi->global;
+  saver_preferences *p = &si->prefs;
+  Window old_w = ssi->screensaver_window;
+  Colormap old_c = ssi->cmap;
+
+  if (! ssi->prewarm_window) abort();
+
+  ssi->screensaver_window = ssi->prewarm_window;
+  ssi->cmap               = ssi->prewarm_cmap;
+  ssi->install_cmap_p     = ssi->prewarm_install_cmap_p;
+  ssi->current_visual     = ssi->prewarm_visual;
+  ssi->current_depth      = ssi->prewarm_depth;
+  ssi->black_pixel        = ssi->prewarm_black_pixel;
+  ssi->prewarm_window = 0;
+  ssi->prewarm_cmap = 0;
+
+  raise_window (ssi);
+
+  if (old_w)
+    defer_XDestroyWindow (si->app, si->dpy, old_w);
+
+  if (p->verbose_p > 1)
+    fprintf (stderr, "%s: %d: swapped in saver window 0x%lx for 0x%lx\n",
+             blurb(), ssi->number, (unsigned long) ssi->screensaver_window,
+             (unsigned long) old_w);
+
+  if (old_c &&
+      old_c != ssi->cmap &&
+      old_c != DefaultColormapOfScreen (ssi->screen))
+    XFreeColormap (si->dpy, old_c);
+}
+
+
+/* Destroys the prewarm window, if any.  Kill its hack first. */
+void
+discard_prewarm_window (saver_screen_info *ssi)
+{
+  saver_info *si = ssi->global;
+  if (ssi->prewarm_window)
+    defer_XDestroyWindow (si->app, si->dpy, ssi->prewarm_window);
+  if (ssi->prewarm_cmap &&
+      ssi->prewarm_cmap != DefaultColormapOfScreen (ssi->screen))
+    XFreeColormap (si->dpy, ssi->prewarm_cmap);
+  ssi->prewarm_window = 0;
+  ssi->prewarm_cmap = 0;
+}
+
+
 /* Synchronize the contents of si->ssi to the current state of the monitors.
    Doesn't change anything if nothing has changed; otherwise, alters and
    reuses existing saver_screen_info structs as much as possible.
@@ -913,6 +1046,13 @@ cycle_timer (XtPointer closure, XtIntervalId *id)
     }
 
   maybe_reload_init_file (si);
+
+  /* If the next hack was already launched on a hidden window beneath this
+     one, just bring it to the front.  There's no black gap while it starts
+     up. */
+  if (activate_prewarmed_screenhack (ssi))
+    return;
+
   kill_screenhack (ssi);
   raise_window (ssi);
 
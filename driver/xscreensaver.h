@@ -53,6 +53,10 @@ extern void blank_screen (saver_info *si);
 extern void unblank_screen (saver_info *si);
 extern void resize_screensaver_window (saver_info *si);
 extern void reset_watchdog_timer (saver_info *);
+extern Bool select_prewarm_visual (saver_screen_info *ssi,
+                                   const char *visual_name);
+extern void swap_prewarm_window (saver_screen_info *ssi);
+extern void discard_prewarm_window (saver_screen_info *ssi);
 
 extern void get_screen_viewport (saver_screen_info *ssi,
                                  int *x_ret, int *y_ret,
@@ -83,6 +87,8 @@ extern void hack_environment (saver_info *si);
 extern void init_sigchld (saver_info *si);
 extern void spawn_screenhack (saver_screen_info *ssi);
 extern void kill_screenhack (saver_screen_info *ssi);
+extern Bool activate_prewarmed_screenhack (saver_screen_info *ssi);
+extern void kill_prewarmed_screenhack (saver_screen_info *ssi);
 extern Bool any_screenhacks_running_p (saver_info *si);
 extern Bool select_visual (saver_screen_info *ssi, const char *visual_name);
 extern void store_saver_status (saver_info *si);
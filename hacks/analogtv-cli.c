@@ -23,6 +23,12 @@
  *                   fade to black at the end.
  *    --logo FILE    Small image overlayed onto the colorbars image.
  *    --audio FILE   Add a soundtrack.
+ *    --jobs N       Cut the video into N segments and render them in
+ *                   parallel, each in its own process, then join them.
+ *                   Each segment is rendered single-threaded, so N should
+ *                   be about the number of cores.
+ *    --seed N       Random seed, so that the same seed and number of jobs
+ *                   make the same video.
  *
  *  Created: 10-Dec-2018 by jwz.
  */
@@ -41,7 +47,9 @@
 #include <math.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -62,6 +70,7 @@ const char *progname;
 const char *progclass;
 int mono_p = 0;
 static Bool verbose_p = 0;
+static Bool use_threads_p = True;
 
 #define MAX_MULTICHAN 2
 static int N_CHANNELS=12;
@@ -341,7 +350,7 @@ destroy_xshm_image (Display *dpy, XImage *image, XShmSegmentInfo *shm_info)
 Bool
 get_boolean_resource (Display *dpy, char *name, char *class)
 {
-  if (!strcmp(name, "useThreads")) return True;
+  if (!strcmp(name, "useThreads")) return use_threads_p;
   abort();
 }
 
@@ -573,84 +582,72 @@ scale_ximage (Screen *screen, Visual *visual,
 }
 
 
+/* Advances the clock by one frame.  Returns True if it is time for the
+   next slide, in which case the clock stays where it is.
+ */
+static Bool
+next_frame_time (unsigned long *curticks, unsigned long *curticks_sub,
+                 int fps, int slideshow)
+{
+  if (slideshow && *curticks_sub * 0.001 >= slideshow)
+    {
+      *curticks_sub = 0;
+      return True;
+    }
+  *curticks     += 1000/fps;
+  *curticks_sub += 1000/fps;
+  return False;
+}
+
+
+/* Each segment, and in slideshow mode each slide, gets a random sequence
+   of its own, so that segments rendered in parallel don't depend on each
+   other, and the same seed always makes the same video.
+ */
+# undef ya_rand_init
 static void
-analogtv_convert (const char **infiles, const char *outfile,
-                  const char *audiofile, const char *logofile,
-                  int output_w, int output_h,
-                  int duration, int slideshow, Bool powerp)
+reseed (unsigned int seed, int frame)
+{
+  unsigned int s = seed + frame * 7919;
+  ya_rand_init (s ? s : 1);
+}
+
+
+/* Renders frames [first_frame, end_frame) of the video into outfile.
+ */
+static void
+render_segment (const char **infiles, XImage **ximages, int nfiles,
+                const char *outfile,
+                const char *audiofile, const char *logofile,
+                int output_w, int output_h,
+                int duration, int slideshow, Bool powerp,
+                unsigned int seed, int first_frame, int end_frame,
+                Bool meter_p)
 {
   unsigned long start_time = time((time_t *)0);
   struct state *st = &global_state;
   Display *dpy = 0;
   Window window = 0;
-  Screen *screen = 0;
-  Visual *visual = 0;
   int i;
-  int nfiles;
+  int frame, slide_frame = 0;
   unsigned long curticks = 0, curticks_sub = 0;
   time_t lastlog = time((time_t *)0);
   int frames_left = 0;
   int channel_changes = 0;
   int fps = 30;
-  XImage **ximages;
   XImage *base_image = 0;
   int *stats;
   ffmpeg_out_state *ffst = 0;
 
-  /* Load all of the input images.
-   */
   stats = (int *) calloc(N_CHANNELS, sizeof(*stats));
-  for (nfiles = 0; infiles[nfiles]; nfiles++)
-    ;
-  ximages = calloc (nfiles, sizeof(*ximages));
-
-  {
-    int maxw = 0, maxh = 0;
-    for (i = 0; i < nfiles; i++)
-      {
-        XImage *ximage = file_to_ximage (0, 0, infiles[i]);
-        ximages[i] = ximage;
-        if (verbose_p > 1)
-          fprintf (stderr, "%s: loaded %s %dx%d\n", progname, infiles[i],
-                   ximage->width, ximage->height);
-        flip_ximage (ximage);
-        if (ximage->width  > maxw) maxw = ximage->width;
-        if (ximage->height > maxh) maxh = ximage->height;
-      }
-
-    if (!output_w || !output_h) {
-      output_w = maxw;
-      output_h = maxh;
-    }
-  }
 
-  output_w &= ~1;  /* can't be odd */
-  output_h &= ~1;
+  /* Catch the clock up to where this segment starts, and find the start of
+     the slide it is in. */
+  for (frame = 0; frame < first_frame; frame++)
+    if (next_frame_time (&curticks, &curticks_sub, fps, slideshow))
+      slide_frame = frame + 1;
 
-  /* Scale all of the input images to the size of the largest one, or frame.
-   */
-  for (i = 0; i < nfiles; i++)
-    {
-      XImage *ximage = ximages[i];
-      if (ximage->width != output_w || ximage->height != output_h)
-        {
-          double r1 = (double) output_w / output_h;
-          double r2 = (double) ximage->width / ximage->height;
-          int w2, h2;
-          if (r1 > r2)
-            {
-              w2 = output_h * r2;
-              h2 = output_h;
-            }
-          else
-            {
-              w2 = output_w;
-              h2 = output_w / r2;
-            }
-          if (! scale_ximage (screen, visual, ximage, w2, h2))
-            abort();
-        }
-    }
+  reseed (seed, 0);
 
   memset (st, 0, sizeof(*st));
   st->dpy = dpy;
@@ -758,14 +755,15 @@ analogtv_convert (const char **infiles, const char *outfile,
 
  INIT_CHANNELS:
 
-  curticks_sub = 0;
   channel_changes = 0;
   st->curinputi = 0;
   st->tv->powerup = 0.0;
 
-  if (slideshow)
+  if (slideshow) {
+    reseed (seed, slide_frame);
     /* First channel (initial unadulterated image) stays for this long */
     frames_left = fps * (2 + frand(1.5));
+  }
 
   if (slideshow) {
     /* Pick one of the input images and fill all channels with variants
@@ -814,6 +812,17 @@ analogtv_convert (const char **infiles, const char *outfile,
       analogtv_setup_sync (input, 1, (random()%20)==0);
       analogtv_load_ximage (st->tv, input, ximage, 0, x, y, w, h);
     }
+
+    /* Every segment has the same stations, but its own schedule. */
+    reseed (seed, frame);
+  }
+
+  if (slideshow && frame != slide_frame) {
+    /* This segment starts in the middle of a slide.  Skip its intro and
+       change channels right away, with a schedule of its own. */
+    channel_changes = 2;
+    frames_left = 0;
+    reseed (seed, frame);
   }
 
   /* This is xanalogtv_draw()
@@ -822,7 +831,6 @@ analogtv_convert (const char **infiles, const char *outfile,
     const analogtv_reception *recs[MAX_MULTICHAN];
     unsigned rec_count = 0;
     double curtime = curticks * 0.001;
-    double curtime_sub = curticks_sub * 0.001;
 
     frames_left--;
     if (frames_left <= 0 &&
@@ -944,19 +952,19 @@ analogtv_convert (const char **infiles, const char *outfile,
       st->tv->brightness_control = min + (ob - min) * r;
     }
 
-    if (curtime >= duration) break;
+    if (++frame >= end_frame) break;
 
-    if (slideshow && curtime_sub >= slideshow)
+    if (next_frame_time (&curticks, &curticks_sub, fps, slideshow)) {
+      slide_frame = frame;
       goto INIT_CHANNELS;
+    }
 
-    curticks     += 1000/fps;
-    curticks_sub += 1000/fps;
-
-    if (verbose_p) {
+    if (verbose_p && meter_p) {
       unsigned long now = time((time_t *)0);
       if (now > (verbose_p == 1 ? lastlog : lastlog + 10)) {
         unsigned long elapsed = now - start_time;
-        double ratio = curtime / (double) duration;
+        double ratio = ((frame - first_frame) /
+                        (double) (end_frame - first_frame));
         int remaining = (ratio ? (elapsed / ratio) - elapsed : 0);
         int pct = 100 * ratio;
         int cols = 47;
@@ -978,7 +986,7 @@ analogtv_convert (const char **infiles, const char *outfile,
     }
   }
 
-  if (verbose_p == 1) fprintf(stderr, "\n");
+  if (verbose_p == 1 && meter_p) fprintf(stderr, "\n");
 
   if (verbose_p > 1) {
     if (channel_changes == 0) channel_changes++;
@@ -993,6 +1001,186 @@ analogtv_convert (const char **infiles, const char *outfile,
 }
 
 
+/* Loads the images, then renders the video, either all at once, or in
+   segments that each render in their own process.
+ */
+static void
+analogtv_convert (const char **infiles, const char *outfile,
+                  const char *audiofile, const char *logofile,
+                  int output_w, int output_h,
+                  int duration, int slideshow, Bool powerp,
+                  unsigned int seed, int jobs)
+{
+  Screen *screen = 0;
+  Visual *visual = 0;
+  int i;
+  int nfiles;
+  int nframes, nsegments;
+  int *starts;
+  int fps = 30;
+  XImage **ximages;
+
+  /* Load all of the input images.
+   */
+  for (nfiles = 0; infiles[nfiles]; nfiles++)
+    ;
+  ximages = calloc (nfiles, sizeof(*ximages));
+
+  {
+    int maxw = 0, maxh = 0;
+    ximage_request *reqs = calloc (nfiles, sizeof(*reqs));
+    ximage_loader *loader;
+    if (!reqs) abort();
+    for (i = 0; i < nfiles; i++)
+      reqs[i].filename = infiles[i];
+
+    /* Decode them all in parallel, and deal with each as it arrives. */
+    loader = ximages_load_start (0, 0, reqs, nfiles);
+    for (i = 0; i < nfiles; i++)
+      {
+        XImage *ximage = ximages_load_wait (loader, i);
+        if (!ximage)
+          {
+            fprintf (stderr, "%s: unable to load %s\n", progname, infiles[i]);
+            exit (1);
+          }
+        ximages[i] = ximage;
+        if (verbose_p > 1)
+          fprintf (stderr, "%s: loaded %s %dx%d\n", progname, infiles[i],
+                   ximage->width, ximage->height);
+        flip_ximage (ximage);
+        if (ximage->width  > maxw) maxw = ximage->width;
+        if (ximage->height > maxh) maxh = ximage->height;
+      }
+    ximages_load_finish (loader);
+    free (reqs);
+
+    if (!output_w || !output_h) {
+      output_w = maxw;
+      output_h = maxh;
+    }
+  }
+
+  output_w &= ~1;  /* can't be odd */
+  output_h &= ~1;
+
+  /* Scale all of the input images to the size of the largest one, or frame.
+   */
+  for (i = 0; i < nfiles; i++)
+    {
+      XImage *ximage = ximages[i];
+      if (ximage->width != output_w || ximage->height != output_h)
+        {
+          double r1 = (double) output_w / output_h;
+          double r2 = (double) ximage->width / ximage->height;
+          int w2, h2;
+          if (r1 > r2)
+            {
+              w2 = output_h * r2;
+              h2 = output_h;
+            }
+          else
+            {
+              w2 = output_w;
+              h2 = output_w / r2;
+            }
+          if (! scale_ximage (screen, visual, ximage, w2, h2))
+            abort();
+        }
+    }
+
+  /* Count the frames, and cut them into equal segments.
+   */
+  {
+    unsigned long curticks = 0, curticks_sub = 0;
+    nframes = 1;
+    while (curticks * 0.001 < duration) {
+      next_frame_time (&curticks, &curticks_sub, fps, slideshow);
+      nframes++;
+    }
+  }
+  nsegments = (jobs < nframes ? jobs : nframes);
+  starts = (int *) calloc (nsegments + 1, sizeof(*starts));
+  for (i = 0; i <= nsegments; i++)
+    starts[i] = (int) ((long) nframes * i / nsegments);
+
+  if (nsegments == 1)
+    {
+      render_segment (infiles, ximages, nfiles, outfile, audiofile, logofile,
+                      output_w, output_h, duration, slideshow, powerp,
+                      seed, 0, nframes, True);
+    }
+  else
+    {
+      pid_t *pids = (pid_t *) calloc (nsegments, sizeof(*pids));
+      char **parts = (char **) calloc (nsegments, sizeof(*parts));
+      Bool failed_p = False;
+      ffmpeg_out_state *ffst;
+
+      if (verbose_p)
+        fprintf (stderr, "%s: rendering %d frames in %d segments\n",
+                 progname, nframes, nsegments);
+
+      for (i = 0; i < nsegments; i++)
+        {
+          parts[i] = (char *) malloc (strlen (outfile) + 20);
+          sprintf (parts[i], "%s.part%d", outfile, i);
+
+          if (verbose_p > 1)
+            fprintf (stderr, "%s: segment %d: frames %d-%d\n",
+                     progname, i, starts[i], starts[i+1] - 1);
+
+          switch ((int) (pids[i] = fork())) {
+          case -1:
+            perror ("fork");
+            exit (1);
+          case 0:
+            /* The soundtrack is added when the segments are joined. */
+            render_segment (infiles, ximages, nfiles, parts[i], 0, logofile,
+                            output_w, output_h, duration, slideshow, powerp,
+                            seed, starts[i], starts[i+1], i == 0);
+            /* Not exit: the stdio buffers and atexit handlers that we
+               inherited belong to the parent. */
+            _exit (0);
+          default:
+            break;
+          }
+        }
+
+      for (i = 0; i < nsegments; i++)
+        {
+          int status = 0;
+          if (waitpid (pids[i], &status, 0) < 0 ||
+              !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+            {
+              fprintf (stderr, "%s: segment %d failed\n", progname, i);
+              failed_p = True;
+            }
+        }
+
+      if (! failed_p)
+        {
+          ffst = ffmpeg_out_init (outfile, audiofile, output_w, output_h,
+                                  4, True);
+          for (i = 0; i < nsegments; i++)
+            ffmpeg_out_add_file (ffst, parts[i]);
+          ffmpeg_out_close (ffst);
+        }
+
+      for (i = 0; i < nsegments; i++)
+        {
+          unlink (parts[i]);
+          free (parts[i]);
+        }
+      free (parts);
+      free (pids);
+      if (failed_p) exit (1);
+    }
+
+  free (starts);
+}
+
+
 static void
 usage(const char *err)
 {
@@ -1000,6 +1188,7 @@ usage(const char *err)
   fprintf (stderr,
            "usage: %s [--verbose] [--duration secs] [--slideshow secs]\n"
            "\t\t    [--audio mp3-file] [--powerup] [--size WxH]\n"
+           "\t\t    [--jobs N] [--seed N]\n"
            "\t\t    infile.png infile2.png ... outfile.mp4\n",
            progname);
   exit (1);
@@ -1018,6 +1207,8 @@ main (int argc, char **argv)
   int w = 0, h = 0;
   int nfiles = 0;
   int slideshow = 0;
+  int jobs = 1;
+  unsigned int seed = 0;
 
   char *s = strrchr (argv[0], '/');
   progname = s ? s+1 : argv[0];
@@ -1055,6 +1246,20 @@ main (int argc, char **argv)
            if (1 != sscanf (argv[i], " %d %c", &slideshow, &dummy))
              usage(argv[i]);
          }
+       else if (!strcmp(argv[i], "-jobs") && argv[i+1])
+         {
+           char dummy;
+           i++;
+           if (1 != sscanf (argv[i], " %d %c", &jobs, &dummy) || jobs < 1)
+             usage(argv[i]);
+         }
+       else if (!strcmp(argv[i], "-seed") && argv[i+1])
+         {
+           char dummy;
+           i++;
+           if (1 != sscanf (argv[i], " %u %c", &seed, &dummy))
+             usage(argv[i]);
+         }
        else if (!strcmp(argv[i], "-audio") && argv[i+1])
          audio = argv[++i];
        else if (!strcmp(argv[i], "-size") && argv[i+1])
@@ -1113,9 +1318,17 @@ main (int argc, char **argv)
 
   darkp = (nfiles == 1);
 
-# undef ya_rand_init
+  /* With many segments at once, threads within each would just get in
+     each other's way. */
+  use_threads_p = (jobs <= 1);
+
   ya_rand_init (0);
+  while (! seed)
+    seed = random();
+  if (verbose_p)
+    fprintf (stderr, "%s: seed %u\n", progname, seed);
+
   analogtv_convert (infiles, outfile, audio, logo,
-                    w, h, duration, slideshow, powerp);
+                    w, h, duration, slideshow, powerp, seed, jobs);
   exit (0);
 }
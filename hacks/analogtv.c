@@ -410,6 +410,7 @@ analogtv_configure(analogtv *it)
 
     analogtv_free_image(it);
     analogtv_alloc_image(it);
+    memset(it->onscreen_signature, 0, sizeof(it->onscreen_signature));
   }
 
   it->screen_xo = (it->xgwa.width-it->usewidth)/2;
@@ -708,31 +709,43 @@ analogtv_set_demod(analogtv *it)
   return 0;
 }
 
-#if 0
-unsigned int
-analogtv_line_signature(analogtv_input *input, int lineno)
+/* 64-bit FNV-1a, a 32-bit word at a time.  It only has to tell whether a
+   scanline's inputs are bit-for-bit the same as last frame. */
+static unsigned long long
+analogtv_hash(unsigned long long hash, const void *data, size_t size)
 {
-  int i;
-  char *origsignal=&input->signal[(lineno+input->vsync)
-                                  %ANALOGTV_V][input->line_hsync[lineno]];
-  unsigned int hash=0;
-
-  /* probably lame */
-  for (i=0; i<ANALOGTV_PIC_LEN; i++) {
-    int c=origsignal[i];
-    hash = hash + (hash<<17) + c;
+  const char *p=(const char *)data;
+  const char *end=p + (size & ~3);
+  unsigned int word;
+  for (; p!=end; p+=4) {
+    memcpy(&word, p, 4);
+    hash = (hash ^ word) * 0x100000001b3ULL;
   }
-
-  hash += input->line_hsync[lineno];
-  hash ^= hash >> 2;
-  /*
-  hash += input->hashnoise_times[lineno];
-  hash ^= hash >> 2;
-  */
-
   return hash;
 }
-#endif
+
+/* A scanline's pixels depend only on the per-frame settings hashed into
+   it->frame_signature, the received signal that ntsc_to_yiq reads (which
+   already includes the line's hsync, ghosting and noise), its colorburst,
+   and its geometry: the phase of the signal, the rows it covers, and the
+   integer scan positions that bloom and horizontal desync work out to.
+   Those are hashed rather than crtload itself, because a change in one
+   line's load ripples into the float load of every line below it, but
+   only rarely moves their scan by a whole step.  If all of that is the
+   same as last frame, the rows it drew are still in it->image.
+ */
+static unsigned long long
+analogtv_line_signature(const analogtv *it, int lineno, const float *signal,
+                        const int *geom, size_t geom_size)
+{
+  unsigned long long hash=it->frame_signature;
+  hash=analogtv_hash(hash, signal,
+                     (ANALOGTV_PIC_LEN+10) * sizeof(*signal));
+  hash=analogtv_hash(hash, it->line_cb_phase[lineno],
+                     sizeof(it->line_cb_phase[lineno]));
+  hash=analogtv_hash(hash, geom, geom_size);
+  return hash ? hash : 1;
+}
 
 
 /* Here we model the analog circuitry of an NTSC television.
@@ -1352,10 +1365,6 @@ static int analogtv_get_line(const analogtv *it, int lineno, int *slineno,
                   it->useheight/2)*it->puheight) + it->useheight/2;
   *ybot=(int)(((*slineno+1)*it->useheight/ANALOGTV_VISLINES -
                   it->useheight/2)*it->puheight) + it->useheight/2;
-#if 0
-  int linesig=analogtv_line_signature(input,lineno)
-    + it->hashnoise_times[lineno];
-#endif
   *signal_offset = ((lineno+it->cur_vsync+ANALOGTV_V) % ANALOGTV_V) * ANALOGTV_H +
                     it->line_hsync[lineno];
 
@@ -1577,6 +1586,24 @@ static void analogtv_thread_draw_lines(void *thread_raw)
 
       assert(scanstart_i>=0);
 
+      if (it->frame_signature) {
+        int geom[8];
+        unsigned long long sig;
+        geom[0]=signal_offset & 3;
+        geom[1]=ytop;
+        geom[2]=ybot;
+        geom[3]=scl;
+        geom[4]=scr;
+        geom[5]=pixrate;
+        geom[6]=scanstart_i;
+        geom[7]=squishright_i;
+        sig=analogtv_line_signature(it, lineno, signal, geom, sizeof(geom));
+        if (sig == it->onscreen_signature[lineno])
+          continue;
+        /* Each line belongs to exactly one thread. */
+        thread->it->onscreen_signature[lineno] = sig;
+      }
+
 #ifdef DEBUG
       if (0) printf("scan %d: %0.3f %0.3f %0.3f scl=%d scr=%d scw=%d\n",
                     lineno,
@@ -1815,19 +1842,6 @@ analogtv_draw(analogtv *it, double noiselevel,
       it->shrinkpulse=-1;
     }
 
-#if 0
-    if (it->hashnoise_rpm>0.0 &&
-        !(bigloadchange ||
-          it->redraw_all ||
-          (slineno<20 && it->flutter_horiz_desync) ||
-          it->gaussiannoise_level>30 ||
-          ((it->gaussiannoise_level>2.0 ||
-            it->multipath) && random()%4) ||
-          linesig != it->onscreen_signature[lineno])) {
-      continue;
-    }
-    it->onscreen_signature[lineno] = linesig;
-#endif
     /*    drawcount++;*/
 
     /*
@@ -1901,6 +1915,43 @@ analogtv_draw(analogtv *it, double noiselevel,
     }
   }
 
+  /* With any snow at all, every sample of every line changes every frame,
+     so don't bother hashing them.  Otherwise, apple2 and bsod frames mostly
+     differ by a blinking cursor, so most lines can keep last frame's pixels.
+     The noise of a channel change, and moving ghosts, are in the received
+     signal that each line hashes, so they only redraw the lines they reach.
+   */
+  if (noiselevel == 0.0) {
+    float f[16];
+    int n[5];
+    f[0]=it->agclevel;
+    f[1]=it->tint_control;
+    f[2]=it->color_control;
+    f[3]=it->brightness_control;
+    f[4]=it->contrast_control;
+    f[5]=it->height_control;
+    f[6]=it->width_control;
+    f[7]=it->squish_control;
+    f[8]=it->horiz_desync;
+    f[9]=it->squeezebottom;
+    f[10]=it->powerup;
+    f[11]=it->puheight;
+    f[12]=it->tint_i;
+    f[13]=it->tint_q;
+    f[14]=f[15]=0;
+    n[0]=it->usewidth;
+    n[1]=it->useheight;
+    n[2]=it->xrepl;
+    n[3]=it->use_cmap;
+    n[4]=it->n_colors;
+    it->frame_signature=analogtv_hash(0xcbf29ce484222325ULL, f, sizeof(f));
+    it->frame_signature=analogtv_hash(it->frame_signature, n, sizeof(n));
+    if (!it->frame_signature) it->frame_signature=1;
+  } else {
+    it->frame_signature=0;
+    memset(it->onscreen_signature, 0, sizeof(it->onscreen_signature));
+  }
+
   threadpool_run(&it->threads, analogtv_thread_draw_lines);
   threadpool_wait(&it->threads);
 
@@ -137,9 +137,10 @@ typedef struct analogtv_s {
 
   struct threadpool threads;
 
-#if 0
-  unsigned int onscreen_signature[ANALOGTV_V];
-#endif
+  /* What went into the image rows of each scanline the last time they were
+     drawn, or 0 if they must be redrawn.  See analogtv_line_signature. */
+  unsigned long long onscreen_signature[ANALOGTV_V];
+  unsigned long long frame_signature;
 
   int n_colors;
 
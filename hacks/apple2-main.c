@@ -872,9 +872,11 @@ a2_draw_banner (apple2_state_t *st, struct terminal_controller_data *mine)
   struct timeval tv;
   double t;
 
-  for (y = 0; y < h; y++)
+  for (y = 0; y < h; y++) {
     for (x = 0; x < w; x++)
       st->textlines[y][x] = ' ' | 0xC0;
+    st->text_dirty[y] = 1;
+  }
 
 # ifdef GETTIMEOFDAY_TWO_ARGS
   gettimeofday (&tv, NULL);
@@ -71,12 +71,14 @@ a2_scroll(apple2_state_t *st)
     memcpy(st->textlines[i],st->textlines[i+1],40);
   }
   memset(st->textlines[23],0xe0,40);
+  memset(st->text_dirty,1,sizeof(st->text_dirty));
 }
 
 static void
 a2_printc_1(apple2_state_t *st, char c, int scroll_p)
 {
   st->textlines[st->cursy][st->cursx] |= 0xc0; /* turn off blink */
+  st->text_dirty[st->cursy]=1;
 
   if (c == '\n')                      /* ^J == NL */
     {
@@ -125,6 +127,7 @@ a2_printc_1(apple2_state_t *st, char c, int scroll_p)
     }
 
   st->textlines[st->cursy][st->cursx] &= 0x7f; /* turn on blink */
+  st->text_dirty[st->cursy]=1;
 }
 
 void
@@ -152,9 +155,11 @@ a2_goto(apple2_state_t *st, int r, int c)
   if (r > 23) r = 23;
   if (c > 39) c = 39;
   st->textlines[st->cursy][st->cursx] |= 0xc0; /* turn off blink */
+  st->text_dirty[st->cursy]=1;
   st->cursy=r;
   st->cursx=c;
   st->textlines[st->cursy][st->cursx] &= 0x7f; /* turn on blink */
+  st->text_dirty[st->cursy]=1;
 }
 
 void
@@ -164,6 +169,7 @@ a2_cls(apple2_state_t *st)
   for (i=0; i<24; i++) {
     memset(st->textlines[i],0xe0,40);
   }
+  memset(st->text_dirty,1,sizeof(st->text_dirty));
 }
 
 void
@@ -173,6 +179,7 @@ a2_clear_gr(apple2_state_t *st)
   for (i=0; i<24; i++) {
     memset(st->textlines[i],0x00,40);
   }
+  memset(st->text_dirty,1,sizeof(st->text_dirty));
 }
 
 void
@@ -182,11 +189,13 @@ a2_clear_hgr(apple2_state_t *st)
   for (i=0; i<192; i++) {
     memset(st->hireslines[i],0,40);
   }
+  memset(st->hires_dirty,1,sizeof(st->hires_dirty));
 }
 
 void
 a2_invalidate(apple2_state_t *st)
 {
+  st->drawn_gr_mode=-1;
 }
 
 void
@@ -199,9 +208,7 @@ a2_poke(apple2_state_t *st, int addr, int val)
     int col=(addr&0x7f)%0x28;
     if (row<24 && col<40) {
       st->textlines[row][col]=val;
-      if (!(st->gr_mode&(A2_GR_HIRES)) ||
-          (!(st->gr_mode&(A2_GR_FULL)) && row>=20)) {
-      }
+      st->text_dirty[row]=1;
     }
   }
   else if (addr>=0x2000 && addr<0x4000) {
@@ -211,8 +218,7 @@ a2_poke(apple2_state_t *st, int addr, int val)
     int col=((addr&0x07f)%0x28);
     if (row<192 && col<40) {
       st->hireslines[row][col]=val;
-      if (st->gr_mode&A2_GR_HIRES) {
-      }
+      st->hires_dirty[row]=1;
     }
   }
 }
@@ -225,6 +231,7 @@ a2_hplot(apple2_state_t *st, int hcolor, int x, int y)
   highbit=((hcolor<<5)&0x80) ^ 0x80; /* capture bit 2 into bit 7 */
 
   if (y<0 || y>=192 || x<0 || x>=280) return;
+  st->hires_dirty[y]=1;
 
   for (run=0; run<2 && x<280; run++) {
     unsigned char *vidbyte = &st->hireslines[y][x/7];
@@ -313,6 +320,7 @@ a2_plot(apple2_state_t *st, int color, int x, int y)
     byte = (byte&0x0f) | ((color&0x0f)<<4);
   }
   st->textlines[textrow][x]=byte;
+  st->text_dirty[textrow]=1;
 }
 
 void
@@ -332,6 +340,7 @@ a2_display_image_loading(apple2_state_t *st, unsigned char *image,
            ((lineno / 1 ) % 3) * 64);
 
   memcpy (st->hireslines[row], &image[row * 40], 40);
+  st->hires_dirty[row]=1;
 }
 
 /*
@@ -569,6 +578,7 @@ apple2_start(Display *dpy, Window window, int delay,
   sim->controller = controller;
 
   sim->st = (apple2_state_t *)calloc(1,sizeof(apple2_state_t));
+  a2_invalidate(sim->st);
   sim->dec = analogtv_allocate(dpy, window);
   sim->inp = analogtv_input_allocate();
 
@@ -644,7 +654,6 @@ apple2_one_frame (apple2_sim_t *sim)
     i=sim->st->blink;
     sim->st->blink=((int)blinkphase)&1;
     if (sim->st->blink!=i && !(sim->st->gr_mode&A2_GR_FULL)) {
-      int downcounter=0;
       /* For every row with blinking text, set the changed flag. This basically
          works great except with random screen garbage in text mode, when we
          end up redrawing the whole screen every second */
@@ -653,13 +662,10 @@ apple2_one_frame (apple2_sim_t *sim)
         for (col=0; col<40; col++) {
           int c=sim->st->textlines[row][col];
           if ((c & 0xc0) == 0x40) {
-            downcounter=4;
+            sim->st->text_dirty[row]=1;
             break;
           }
         }
-        if (downcounter>0) {
-          downcounter--;
-        }
       }
     }
 
@@ -746,12 +752,22 @@ apple2_one_frame (apple2_sim_t *sim)
     }
 
 
-    analogtv_setup_sync(sim->inp, sim->st->gr_mode? 1 : 0, 0);
+    /* The signal from last frame is still in sim->inp, so only the lines
+       whose memory has changed need to be shifted out again.  Changing the
+       mode changes the colorburst and where every line comes from. */
+    if (sim->st->gr_mode != sim->st->drawn_gr_mode) {
+      analogtv_setup_sync(sim->inp, sim->st->gr_mode? 1 : 0, 0);
+      memset(sim->st->text_dirty, 1, sizeof(sim->st->text_dirty));
+      memset(sim->st->hires_dirty, 1, sizeof(sim->st->hires_dirty));
+      sim->st->drawn_gr_mode=sim->st->gr_mode;
+    }
     analogtv_setup_frame(sim->dec);
 
     for (textrow=0; textrow<24; textrow++) {
       int row;
       for (row=textrow*8; row<textrow*8+8; row++) {
+        int hires_p=((sim->st->gr_mode&A2_GR_HIRES) &&
+                     (row<160 || (sim->st->gr_mode&A2_GR_FULL)));
 
         /* First we generate the pattern that the video circuitry shifts out
            of memory. It has a 14.something MHz dot clock, equal to 4 times
@@ -762,8 +778,17 @@ apple2_one_frame (apple2_sim_t *sim)
 
         signed char *pp=&sim->inp->signal[row+ANALOGTV_TOP+4][ANALOGTV_PIC_START+100];
 
-        if ((sim->st->gr_mode&A2_GR_HIRES) &&
-            (row<160 || (sim->st->gr_mode&A2_GR_FULL))) {
+        if (!(hires_p
+              ? sim->st->hires_dirty[row]
+              : sim->st->text_dirty[textrow]))
+          continue;
+
+        /* Not every dot gets written below, so start from black, as
+           analogtv_setup_sync left it. */
+        memset(pp-100, ANALOGTV_BLACK_LEVEL,
+               ANALOGTV_FP_START-ANALOGTV_PIC_START);
+
+        if (hires_p) {
           int col;
 
           /* Emulate the mysterious pink line, due to a bit getting
@@ -828,6 +853,9 @@ apple2_one_frame (apple2_sim_t *sim)
         }
       }
     }
+    memset(sim->st->text_dirty, 0, sizeof(sim->st->text_dirty));
+    memset(sim->st->hires_dirty, 0, sizeof(sim->st->hires_dirty));
+
     analogtv_reception_update(&sim->reception);
     {
       const analogtv_reception *rec = &sim->reception;
@@ -30,6 +30,14 @@ typedef struct apple2_state {
   int cursy;
   int blink;
 
+  /* Which rows of text memory and which lines of hires memory have changed
+     since apple2_one_frame last shifted them out into the signal.  Code that
+     writes textlines or hireslines directly must set these too, or call
+     a2_invalidate. */
+  unsigned char text_dirty[24];
+  unsigned char hires_dirty[192];
+  int drawn_gr_mode;		/* -1 means redraw everything */
+
 } apple2_state_t;
 
 
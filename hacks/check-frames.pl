@@ -0,0 +1,311 @@
+#!/usr/bin/perl -w
+# Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+#
+# Permission to use, copy, modify, distribute, and sell this software and its
+# documentation for any purpose is hereby granted without fee, provided that
+# the above copyright notice appear in all copies and that both that
+# copyright notice and this permission notice appear in supporting
+# documentation.  No representations are made about the suitability of this
+# software for any purpose.  It is provided "as is" without express or
+# implied warranty.
+#
+# Runs each hack listed in frames/*.txt on a private Xvfb with
+# "-replay-seed 1 -virtual-clock -frame-hash N", and compares the hash of
+# each frame against the golden hashes in that file.  This is how you find
+# out whether an optimization changed what a hack draws.
+#
+# Each frames/NAME.txt looks like:
+#
+#   args:      -delay 0
+#   tolerance: exact
+#   0001 1a2b3c4d
+#   0002 ...
+#
+# "tolerance: psnr 40" means a frame whose hash differs still passes if its
+# PSNR against the golden frame is at least 40 dB.  Those golden frames are
+# stored as frames/NAME/NNNN.ppm.gz, so use it only for hacks whose math
+# is expected to round differently, e.g. after vectorizing.
+#
+# "--update" rewrites the hashes (and golden frames) from the current build.
+# The hashes are of what Xvfb drew, so they must be generated by running
+# "make update-frames" on a host with Xvfb, before the optimization under
+# test, and both frames/NAME.txt and frames/NAME/ committed.
+#
+# Created: 19-Oct-2026.
+
+require 5;
+use diagnostics;
+use strict;
+
+use File::Temp qw(tempdir);
+use IO::Compress::Gzip qw(gzip $GzipError);
+use IO::Uncompress::Gunzip qw(gunzip $GunzipError);
+
+my $progname = $0; $progname =~ s@.*/@@g;
+my ($version) = ('$Revision: 1.1 $' =~ m/\s(\d[.\d]+)\s/s);
+
+my $verbose = 0;
+
+my $frame_count = 20;
+my $geometry    = '200x150';
+my $seed        = 1;
+my $timeout     = 120;	# seconds per hack
+
+
+sub error($) {
+  my ($err) = @_;
+  print STDERR "$progname: $err\n";
+  exit 1;
+}
+
+
+# Start a private X server and return its display and pid.
+#
+sub start_xvfb() {
+  local $^F = 255;	# Don't close the pipe on exec.
+  pipe (my $r, my $w) || error ("pipe: $!");
+  my $pid = fork();
+  error ("fork: $!") unless defined ($pid);
+  if (! $pid) {
+    close ($r);
+    open (STDOUT, '>/dev/null');
+    open (STDERR, '>/dev/null') unless ($verbose > 1);
+    exec ('Xvfb', '-displayfd', fileno($w), '-screen', '0', '1024x768x24',
+          '-nolisten', 'tcp');
+    exit 1;
+  }
+  close ($w);
+  my $n = <$r>;
+  close ($r);
+  error ("unable to start Xvfb") unless (defined($n) && $n =~ m/^(\d+)/s);
+  my $dpy = ":$1";
+  print STDERR "$progname: started Xvfb on $dpy\n" if ($verbose);
+  return ($dpy, $pid);
+}
+
+
+sub find_exe($) {
+  my ($name) = @_;
+  foreach my $f ("./$name", "./glx/$name") {
+    return $f if (-x $f);
+  }
+  return undef;
+}
+
+
+sub read_golden($) {
+  my ($file) = @_;
+  my %g = ( args => '', tolerance => 'exact', hashes => {} );
+  open (my $in, '<', $file) || error ("$file: $!");
+  while (<$in>) {
+    s/#.*$//s;
+    if    (m/^\s*args:\s*(.*?)\s*$/s)      { $g{args} = $1; }
+    elsif (m/^\s*tolerance:\s*(.*?)\s*$/s) { $g{tolerance} = $1; }
+    elsif (m/^\s*(\d+)\s+([\da-f]+)\s*$/s) { $g{hashes}->{$1+0} = $2; }
+    elsif (m/\S/s) { error ("$file: unparsable: $_"); }
+  }
+  close $in;
+  error ("$file: bad tolerance: $g{tolerance}")
+    unless ($g{tolerance} =~ m/^(exact|psnr\s+[\d.]+)$/s);
+  return \%g;
+}
+
+
+sub write_golden($$$) {
+  my ($file, $g, $hashes) = @_;
+  open (my $out, '>', "$file.tmp") || error ("$file.tmp: $!");
+  print $out "args:" . ($g->{args} eq '' ? '' : "      $g->{args}") . "\n";
+  print $out "tolerance: $g->{tolerance}\n";
+  foreach my $n (sort { $a <=> $b } keys %$hashes) {
+    printf $out "%04d %s\n", $n, $hashes->{$n};
+  }
+  close $out;
+  rename ("$file.tmp", $file) || error ("$file: $!");
+}
+
+
+# Returns a hash of frame number => pixel hash.
+#
+sub run_hack($$$$) {
+  my ($dpy, $exe, $args, $dir) = @_;
+  my @cmd = ($exe, '-window', '-geometry', $geometry,
+             '-replay-seed', $seed, '-virtual-clock',
+             '-frame-hash', $frame_count);
+  push @cmd, ('-frame-dir', $dir) if ($dir);
+  push @cmd, split (/\s+/, $args) if ($args ne '');
+  print STDERR "$progname: " . join(' ', @cmd) . "\n" if ($verbose);
+
+  local $ENV{DISPLAY} = $dpy;
+  my %hashes;
+  my $pid = open (my $in, '-|');
+  error ("fork: $!") unless defined ($pid);
+  if (! $pid) {
+    exec (@cmd);
+    exit 1;
+  }
+  eval {
+    local $SIG{ALRM} = sub { die "timeout\n" };
+    alarm ($timeout);
+    while (<$in>) {
+      $hashes{$1+0} = $2 if (m/^(\d+) ([\da-f]+)$/s);
+    }
+    alarm (0);
+  };
+  if ($@) {
+    kill ('TERM', $pid);
+    print STDERR "$progname: $exe: timed out\n";
+  }
+  close $in;
+  return \%hashes;
+}
+
+
+sub read_ppm($) {
+  my ($file) = @_;
+  my $data;
+  if ($file =~ m/\.gz$/s) {
+    gunzip ($file => \$data) || error ("$file: $GunzipError");
+  } else {
+    local $/ = undef;
+    open (my $in, '<:raw', $file) || error ("$file: $!");
+    $data = <$in>;
+    close $in;
+  }
+  error ("$file: not a PPM")
+    unless ($data =~ s/^P6\s+(\d+)\s+(\d+)\s+255\s//s);
+  return ($1, $2, $data);
+}
+
+
+sub psnr($$) {
+  my ($file1, $file2) = @_;
+  my ($w1, $h1, $d1) = read_ppm ($file1);
+  my ($w2, $h2, $d2) = read_ppm ($file2);
+  return 0 unless ($w1 == $w2 && $h1 == $h2);
+  my @a = unpack ('C*', $d1);
+  my @b = unpack ('C*', $d2);
+  my $sum = 0;
+  for (my $i = 0; $i <= $#a; $i++) {
+    my $d = $a[$i] - $b[$i];
+    $sum += $d * $d;
+  }
+  return 999 if ($sum == 0);
+  my $mse = $sum / @a;
+  return 10 * log (255 * 255 / $mse) / log (10);
+}
+
+
+sub check_hack($$$$) {
+  my ($dpy, $srcdir, $name, $update_p) = @_;
+
+  my $file = "$srcdir/frames/$name.txt";
+  my $g = read_golden ($file);
+  my $exe = find_exe ($name);
+  if (! $exe) {
+    print STDERR "$progname: $name: not built, skipped\n";
+    return 0;
+  }
+
+  my ($psnr) = ($g->{tolerance} =~ m/^psnr\s+([\d.]+)/s);
+  my $golden_dir = "$srcdir/frames/$name";
+  my $tmp = ($psnr ? tempdir ("$progname.XXXXXX", TMPDIR => 1, CLEANUP => 1)
+             : undef);
+  my $hashes = run_hack ($dpy, $exe, $g->{args}, $tmp);
+
+  if (scalar (keys %$hashes) != $frame_count) {
+    print STDERR "$progname: $name: got " . scalar(keys %$hashes) .
+      " of $frame_count frames\n";
+    return 1;
+  }
+
+  if ($update_p) {
+    write_golden ($file, $g, $hashes);
+    if ($psnr) {
+      mkdir ($golden_dir) unless (-d $golden_dir);
+      foreach my $n (keys %$hashes) {
+        my $f = sprintf ("%04d.ppm", $n);
+        gzip ("$tmp/$f" => "$golden_dir/$f.gz", Minimal => 1) ||
+          error ("$golden_dir/$f.gz: $GzipError");
+      }
+    }
+    print STDERR "$progname: $name: updated\n";
+    return 0;
+  }
+
+  # A hack with no golden hashes has not been checked at all, so that
+  # counts as a failure, not a pass.
+  if (! %{$g->{hashes}}) {
+    print STDERR "$progname: $name: no golden hashes; run with --update\n";
+    return 1;
+  }
+
+  my $failed = 0;
+  foreach my $n (sort { $a <=> $b } keys %$hashes) {
+    my $want = $g->{hashes}->{$n} || '';
+    next if ($hashes->{$n} eq $want);
+    if ($psnr) {
+      my $f = sprintf ("%04d.ppm", $n);
+      if (! -f "$golden_dir/$f.gz") {
+        print STDERR "$progname: $name: frame $n: no $golden_dir/$f.gz\n";
+        $failed = 1;
+        next;
+      }
+      my $p = psnr ("$tmp/$f", "$golden_dir/$f.gz");
+      printf STDERR "$progname: $name: frame %d: PSNR %.1f dB\n", $n, $p
+        if ($verbose);
+      next if ($p >= $psnr);
+      printf STDERR "$progname: $name: frame %d: PSNR %.1f dB < %s\n",
+        $n, $p, $psnr;
+    } else {
+      printf STDERR "$progname: $name: frame %d: %s, expected %s\n",
+        $n, $hashes->{$n}, $want;
+    }
+    $failed = 1;
+  }
+  print STDERR "$progname: $name: " . ($failed ? 'FAILED' : 'ok') . "\n";
+  return $failed;
+}
+
+
+sub usage() {
+  print STDERR "usage: $progname [--verbose] [--update] [--srcdir dir]" .
+    " [--frames N] [hacks ...]\n";
+  exit 1;
+}
+
+sub main() {
+  my $srcdir = '.';
+  my $update_p = 0;
+  my @hacks = ();
+  while ($#ARGV >= 0) {
+    $_ = shift @ARGV;
+    if (m/^--?verbose$/) { $verbose++; }
+    elsif (m/^-v+$/) { $verbose += length($_)-1; }
+    elsif (m/^--?update$/) { $update_p++; }
+    elsif (m/^--?srcdir$/) { $srcdir = shift @ARGV || usage; }
+    elsif (m/^--?frames$/) { $frame_count = shift @ARGV || usage; }
+    elsif (m/^-./) { usage; }
+    else { push @hacks, $_; }
+  }
+
+  if (! @hacks) {
+    foreach my $f (sort glob ("$srcdir/frames/*.txt")) {
+      $f =~ s@^.*/([^/]+)\.txt$@$1@s;
+      push @hacks, $f;
+    }
+  }
+  error ("no hacks listed in $srcdir/frames/") unless (@hacks);
+
+  my ($dpy, $xvfb) = start_xvfb();
+  my $failures = 0;
+  foreach my $name (@hacks) {
+    $failures += check_hack ($dpy, $srcdir, $name, $update_p);
+  }
+  kill ('TERM', $xvfb);
+  waitpid ($xvfb, 0);
+
+  print STDERR "$progname: $failures failed\n" if ($failures);
+  exit ($failures ? 1 : 0);
+}
+
+main();
@@ -26,6 +26,7 @@
  */
 
 #include "screenhack.h"
+#include "thread_util.h"
 
 #ifndef MAX_WIDTH
 #include <limits.h>
@@ -50,6 +51,10 @@ struct field {
     unsigned int cell_size;
     unsigned char *cells;
     unsigned char *new_cells;
+    unsigned char *shown;	/* whether the screen has fg or bg there */
+    unsigned int *rnd;		/* one row of random numbers */
+    ya_rng rng;		/* for the field alone, filled a row at a time */
+    unsigned char weight[256];	/* by age */
 };
 
 struct state {
@@ -63,6 +68,7 @@ struct state {
   unsigned int cycles;
   unsigned int colorindex;  /* which color in the colormap are we on */
   unsigned int colortimer;  /* when this reaches 0, cycle to next color */
+  Bool fg_changed_p;
 
   int cycle_delay;
   int cycle_colors;
@@ -76,10 +82,20 @@ struct state {
 
   struct field *field;
 
+  struct threadpool threadpool;
+  unsigned int *band_counts;	/* each thread's part of do_tick's total */
+
   XPoint fg_points[MAX_WIDTH];
   XPoint bg_points[MAX_WIDTH];
 };
 
+struct tick_thread {
+  struct state *st;
+  unsigned int thread_id;
+  unsigned char *rows;		/* three rows of weights, and their sums */
+  unsigned int width;
+};
+
 
 static void 
 *xrealloc(void *p, size_t size)
@@ -107,11 +123,31 @@ init_field(struct state *st)
       exit (1);
     }
 
+    f->weight[0] = 0;
+    {
+      unsigned int i;
+      for (i = 1; i < 256; i++)
+        f->weight[i] = (i > f->max_age ? 3 : 1);
+    }
+
     f->cells = NULL;
     f->new_cells = NULL;
+    f->shown = NULL;
+    f->rnd = NULL;
+    ya_rng_init(&f->rng, 0);
     return f;
 }
 
+static void
+free_field(struct field *f)
+{
+    free(f->cells);
+    free(f->new_cells);
+    free(f->shown);
+    free(f->rnd);
+    free(f);
+}
+
 static void 
 resize_field(struct field * f, unsigned int w, unsigned int h)
 {
@@ -121,46 +157,69 @@ resize_field(struct field * f, unsigned int w, unsigned int h)
 
     f->cells = xrealloc(f->cells, s);
     f->new_cells = xrealloc(f->new_cells, s);
+    f->shown = xrealloc(f->shown, s);
+    f->rnd = xrealloc(f->rnd, w * sizeof(*f->rnd));
     memset(f->cells, 0, s);
     memset(f->new_cells, 0, s);
+    memset(f->shown, 2, s);	/* neither: draw everything */
 }
 
-static inline unsigned char 
-*cell_at(struct field * f, unsigned int x, unsigned int y)
+/* After the window has been cleared, exposed or resized, what is on the
+ * screen is anyone's guess, so draw every cell next time. */
+static void
+forget_shown(struct field * f)
 {
-    return (f->cells + x * sizeof(unsigned char) + 
-                       y * f->width * sizeof(unsigned char));
+    if (f->shown)
+	memset(f->shown, 2, f->width * f->height);
 }
 
 static inline unsigned char 
-*new_cell_at(struct field * f, unsigned int x, unsigned int y)
+*cell_at(struct field * f, unsigned int x, unsigned int y)
 {
-    return (f->new_cells + x * sizeof(unsigned char) + 
-                           y * f->width * sizeof(unsigned char));
+    return (f->cells + x * sizeof(unsigned char) + 
+                       y * f->width * sizeof(unsigned char));
 }
 
+/* When cells are one pixel, there is nothing random about where the dot
+ * goes, so only cells that differ from what is already on the screen need
+ * to be drawn: mostly the ones that were born or died, plus the living
+ * ones when the foreground color has changed.  With bigger cells, redrawing
+ * the unchanged ones is what fills them in, so draw them all. */
 static void
 draw_field(struct state *st, struct field * f)
 {
     unsigned int x, y;
-    unsigned int rx, ry = 0;	/* random amount to offset the dot */
+    unsigned int rx = 0, ry = 0;	/* random amount to offset the dot */
     unsigned int size = 1 << f->cell_size;
     unsigned int mask = size - 1;
     unsigned int fg_count, bg_count;
+    Bool sparse_p = (size == 1);
 
-    /* columns 0 and width-1 are off screen and not drawn. */
+    /* rows 0 and height-1 are off screen and not drawn. */
     for (y = 1; y < f->height - 1; y++) {
+	const unsigned char *row = f->cells + y * f->width;
+	unsigned char *shown = f->shown + y * f->width;
 	fg_count = 0;
 	bg_count = 0;
+	if (!sparse_p)
+	    ya_rng_fill(&f->rng, f->rnd, f->width);
 
-	/* rows 0 and height-1 are off screen and not drawn. */
+	/* columns 0 and width-1 are off screen and not drawn. */
 	for (x = 1; x < f->width - 1; x++) {
-	    rx = random();
-	    ry = rx >> f->cell_size;
-	    rx &= mask;
-	    ry &= mask;
+	    unsigned char alive = !!row[x];
 
-	    if (*cell_at(f, x, y)) {
+	    if (sparse_p) {
+		if (shown[x] == alive && !(alive && st->fg_changed_p))
+		    continue;
+		shown[x] = alive;
+	    } else {
+		rx = f->rnd[x];
+		ry = rx >> f->cell_size;
+		rx &= mask;
+		ry &= mask;
+	    }
+
+	    if (alive) {
 		st->fg_points[fg_count].x = (short) x *size - rx - 1;
 		st->fg_points[fg_count].y = (short) y *size - ry - 1;
 		fg_count++;
@@ -170,78 +229,141 @@ draw_field(struct state *st, struct field * f)
 		bg_count++;
 	    }
 	}
-	XDrawPoints(st->dpy, st->window, st->fgc, st->fg_points, fg_count,
-		    CoordModeOrigin);
-	XDrawPoints(st->dpy, st->window, st->bgc, st->bg_points, bg_count,
-		    CoordModeOrigin);
+	if (fg_count)
+	    XDrawPoints(st->dpy, st->window, st->fgc, st->fg_points, fg_count,
+			CoordModeOrigin);
+	if (bg_count)
+	    XDrawPoints(st->dpy, st->window, st->bgc, st->bg_points, bg_count,
+			CoordModeOrigin);
     }
+    st->fg_changed_p = False;
 }
 
-static inline unsigned int 
-cell_value(unsigned char c, unsigned int age)
+/* What each cell of row y counts as: 0, 1 or 3. */
+static inline void
+weigh_row(const struct field * f, unsigned char *out, unsigned int y)
 {
-    if (!c) {
-	return 0;
-    } else if (c > age) {
-	return (3);
-    } else {
-	return (1);
-    }
+    const unsigned char *row = f->cells + y * f->width;
+    unsigned int x;
+    for (x = 0; x < f->width; x++)
+	out[x] = f->weight[row[x]];
 }
 
-static inline unsigned int 
-is_alive(struct field * f, unsigned int x, unsigned int y)
+/* Cells older than max_age count as 3 neighbours instead of 1.
+ *
+ * The field is row-major, so walk it that way: for each row, add up each
+ * column of three weights, and each cell's total is three adjacent column
+ * sums minus itself.  These inner loops have no branches, so the compiler
+ * can vectorize them.
+ *
+ * Each thread does one band of rows, and keeps the weights of the three
+ * rows around the current one itself, so the only shared memory that it
+ * writes is its own rows of new_cells.
+ */
+static void
+tick_thread_run(void *self_raw)
 {
-    unsigned int count;
-    unsigned int i, j;
-    unsigned char *p;
-
-    count = 0;
+    struct tick_thread *t = (struct tick_thread *) self_raw;
+    struct state *st = t->st;
+    struct field *f = st->field;
+    unsigned int w = f->width, h = f->height;
+    unsigned int nthreads = st->threadpool.count;
+    unsigned int y0 = 1 + (h - 2) * t->thread_id / nthreads;
+    unsigned int y1 = 1 + (h - 2) * (t->thread_id + 1) / nthreads;
+    unsigned int x, y;
+    unsigned int count = 0;
+    unsigned char *above, *here, *below, *sums, *tmp;
 
-    for (i = x - 1; i <= x + 1; i++) {
-	for (j = y - 1; j <= y + 1; j++) {
-	    if (y != j || x != i) {
-		count += cell_value(*cell_at(f, i, j), f->max_age);
-	    }
-	}
+    if (t->width < w) {
+	t->rows = xrealloc(t->rows, 4 * w);
+	t->width = w;
     }
-
-    p = cell_at(f, x, y);
-    if (*p) {
-	if (count == 2 || count == 3) {
-	    return ((*p) + 1);
-	} else {
-	    return (0);
-	}
-    } else {
-	if (count == 3) {
-	    return (1);
-	} else {
-	    return (0);
+    above = t->rows;
+    here  = above + w;
+    below = here + w;
+    sums  = below + w;
+
+    weigh_row(f, above, y0 - 1);
+    weigh_row(f, here, y0);
+
+    for (y = y0; y < y1; y++) {
+	const unsigned char *old = f->cells + y * w;
+	unsigned char *new = f->new_cells + y * w;
+
+	weigh_row(f, below, y + 1);
+
+	for (x = 0; x < w; x++)
+	    sums[x] = above[x] + here[x] + below[x];
+
+	for (x = 1; x < w - 1; x++) {
+	    unsigned int n = sums[x-1] + sums[x] + sums[x+1] - here[x];
+	    unsigned char c = old[x];
+	    if (c)
+		c = (n == 2 || n == 3) ? c + 1 : 0;
+	    else
+		c = (n == 3);
+	    new[x] = c;
+	    count += c;
 	}
+	new[0] = new[w - 1] = 0;
+
+	tmp = above;
+	above = here;
+	here = below;
+	below = tmp;
     }
+
+    st->band_counts[t->thread_id] = count;
 }
 
+/* Returns the sum of the ages of the living cells. */
 static unsigned int 
-do_tick(struct field * f)
+do_tick(struct state *st)
 {
-    unsigned int x, y;
-    unsigned int count = 0;
-    for (x = 1; x < f->width - 1; x++) {
-	for (y = 1; y < f->height - 1; y++) {
-	    count += *new_cell_at(f, x, y) = is_alive(f, x, y);
-	}
-    }
-    memcpy(f->cells, f->new_cells, f->width * f->height *
-           sizeof(unsigned char));
+    struct field *f = st->field;
+    unsigned int w = f->width, h = f->height;
+    unsigned int i, count = 0;
+    unsigned char *tmp;
+
+    threadpool_run(&st->threadpool, tick_thread_run);
+    threadpool_wait(&st->threadpool);
+    for (i = 0; i < st->threadpool.count; i++)
+	count += st->band_counts[i];
+
+    /* The edges only ever come from populate_edges. */
+    memset(f->new_cells, 0, w);
+    memset(f->new_cells + (h - 1) * w, 0, w);
+
+    tmp = f->cells;
+    f->cells = f->new_cells;
+    f->new_cells = tmp;
     return count;
 }
 
 
+static int
+tick_thread_create(void *self_raw, struct threadpool *pool, unsigned int id)
+{
+    struct tick_thread *t = (struct tick_thread *) self_raw;
+    t->st = GET_PARENT_OBJ(struct state, threadpool, pool);
+    t->thread_id = id;
+    t->rows = NULL;
+    t->width = 0;
+    return 0;
+}
+
+static void
+tick_thread_destroy(void *self_raw)
+{
+    struct tick_thread *t = (struct tick_thread *) self_raw;
+    free(t->rows);
+}
+
+
 static unsigned int 
-random_cell(unsigned int p)
+random_cell(struct field * f, unsigned int p)
 {
-    int r = random() & 0xff;
+    unsigned int r = ya_rng_random(&f->rng) & 0xff;
 
     if (r < p) {
 	return (1);
@@ -255,9 +377,11 @@ populate_field(struct field * f, unsigned int p)
 {
     unsigned int x, y;
 
-    for (x = 0; x < f->width; x++) {
-	for (y = 0; y < f->height; y++) {
-	    *cell_at(f, x, y) = random_cell(p);
+    for (y = 0; y < f->height; y++) {
+	unsigned char *row = cell_at(f, 0, y);
+	ya_rng_fill(&f->rng, f->rnd, f->width);
+	for (x = 0; x < f->width; x++) {
+	    row[x] = ((f->rnd[x] & 0xff) < p);
 	}
     }
 }
@@ -268,19 +392,24 @@ populate_edges(struct field * f, unsigned int p)
     unsigned int i;
 
     for (i = f->width; i--;) {
-	*cell_at(f, i, 0) = random_cell(p);
-	*cell_at(f, i, f->height - 1) = random_cell(p);
+	*cell_at(f, i, 0) = random_cell(f, p);
+	*cell_at(f, i, f->height - 1) = random_cell(f, p);
     }
 
     for (i = f->height; i--;) {
-	*cell_at(f, f->width - 1, i) = random_cell(p);
-	*cell_at(f, 0, i) = random_cell(p);
+	*cell_at(f, f->width - 1, i) = random_cell(f, p);
+	*cell_at(f, 0, i) = random_cell(f, p);
     }
 }
 
 static void *
 cloudlife_init (Display *dpy, Window window)
 {
+  static const struct threadpool_class cls = {
+    sizeof(struct tick_thread),
+    tick_thread_create,
+    tick_thread_destroy
+  };
   struct state *st = (struct state *) calloc (1, sizeof(*st));
     Bool tmp = True;
 
@@ -300,6 +429,11 @@ cloudlife_init (Display *dpy, Window window)
 
     XGetWindowAttributes(st->dpy, st->window, &st->xgwa);
 
+#ifndef HAVE_JWXYZ
+    /* Only changed cells are drawn, so we need to know what to repaint. */
+    XSelectInput(st->dpy, st->window, st->xgwa.your_event_mask | ExposureMask);
+#endif
+
     if (st->cycle_colors) {
         st->colors = (XColor *) xrealloc(st->colors, sizeof(XColor) * (st->ncolors+1));
         make_smooth_colormap (st->xgwa.screen, st->xgwa.visual,
@@ -315,6 +449,14 @@ cloudlife_init (Display *dpy, Window window)
                                         "background", "Background");
     st->bgc = XCreateGC(st->dpy, st->window, GCForeground, &st->gcv);
 
+    if (threadpool_create(&st->threadpool, &cls, dpy,
+                          hardware_concurrency(dpy))) {
+	fprintf(stderr, "%s: couldn't start threads\n", progname);
+	exit(1);
+    }
+    st->band_counts = xrealloc(NULL, st->threadpool.count *
+                                     sizeof(*st->band_counts));
+
     return st;
 }
 
@@ -330,6 +472,7 @@ cloudlife_draw (Display *dpy, Window window, void *closure)
         st->colorindex = st->ncolors;
       st->colorindex--;
       XSetForeground(st->dpy, st->fgc, st->colors[st->colorindex].pixel);
+      st->fg_changed_p = True;
     }
     st->colortimer--;
   } 
@@ -345,13 +488,14 @@ cloudlife_draw (Display *dpy, Window window, void *closure)
 
   draw_field(st, st->field);
 
-  if (do_tick(st->field) < (st->field->height + st->field->width) / 4) {
+  if (do_tick(st) < (st->field->height + st->field->width) / 4) {
     populate_field(st->field, st->density);
+    forget_shown(st->field);
   }
 
   if (st->cycles % (st->field->max_age /2) == 0) {
     populate_edges(st->field, st->density);
-    do_tick(st->field);
+    do_tick(st);
     populate_edges(st->field, 0);
   }
 
@@ -372,21 +516,25 @@ static void
 cloudlife_reshape (Display *dpy, Window window, void *closure, 
                  unsigned int w, unsigned int h)
 {
+  struct state *st = (struct state *) closure;
+  forget_shown(st->field);
 }
 
 static Bool
 cloudlife_event (Display *dpy, Window window, void *closure, XEvent *event)
 {
   struct state *st = (struct state *) closure;
-  if (screenhack_event_helper (dpy, window, event))
+  if (event->xany.type == Expose)
+    {
+      forget_shown(st->field);
+      return False;
+    }
+  else if (screenhack_event_helper (dpy, window, event))
     {
       XClearWindow (dpy, window);
       st->cycles = 0;
-      if (st->field) {
-        free (st->field->cells);
-        free (st->field->new_cells);
-        free (st->field);
-      }
+      if (st->field)
+        free_field (st->field);
       st->field = init_field(st);
       return True;
     }
@@ -397,9 +545,9 @@ static void
 cloudlife_free (Display *dpy, Window window, void *closure)
 {
   struct state *st = (struct state *) closure;
-  free (st->field->cells);
-  free (st->field->new_cells);
-  free (st->field);
+  threadpool_destroy (&st->threadpool);
+  free (st->band_counts);
+  free_field (st->field);
   free (st->colors);
   XFreeGC (dpy, st->fgc);
   XFreeGC (dpy, st->bgc);
@@ -417,6 +565,7 @@ static const char *cloudlife_defaults[] = {
     "*maxAge:		64",
     "*initialDensity:	30",
     "*cellSize:		3",
+    THREAD_DEFAULTS
 #ifdef HAVE_MOBILE
     "*ignoreRotation:   True",
 #endif
@@ -432,6 +581,7 @@ static XrmOptionDescRec cloudlife_options[] = {
     {"-cell-size", ".cellSize", XrmoptionSepArg, 0},
     {"-initial-density", ".initialDensity", XrmoptionSepArg, 0},
     {"-max-age", ".maxAge", XrmoptionSepArg, 0},
+    THREAD_OPTIONS
     {0, 0, 0, 0}
 };
 
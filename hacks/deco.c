@@ -22,6 +22,7 @@
  */
 
 #include "screenhack.h"
+#include "xbatch.h"
 #include <stdio.h>
 
 struct state {
@@ -39,7 +40,9 @@ struct state {
   int delay;
   XWindowAttributes xgwa;
   GC fgc, bgc;
+  unsigned long fg_pixel, bg_pixel;
   int current_color;
+  xbatch *fills, *lines;
 };
 
 /* Golden Ratio
@@ -161,14 +164,18 @@ deco (Display *dpy, Window window, struct state *st,
 {
   if (((random() % st->max_depth) < depth) || (w < st->min_width) || (h < st->min_height))
     {
+      unsigned long pixel = st->bg_pixel;
       if (!mono_p)
 	{
 	  if (++st->current_color >= st->ncolors)
 	    st->current_color = 0;
-	  XSetForeground(dpy, st->bgc, st->colors[st->current_color].pixel);
+	  pixel = st->colors[st->current_color].pixel;
 	}
-      XFillRectangle (dpy, window, st->bgc, x, y, w, h);
-      XDrawRectangle (dpy, window, st->fgc, x, y, w, h);
+      /* The rectangles don't overlap, and all of the outlines are the same
+         color, so all of the outlines can be drawn after all of the fills:
+         two batches, flushed in that order at the end of the frame. */
+      xbatch_fill_rectangle (st->fills, st->bgc, pixel, x, y, w, h);
+      xbatch_rectangle (st->lines, st->fgc, st->fg_pixel, x, y, w, h);
     }
   else
     {
@@ -218,12 +225,12 @@ deco_init (Display *dpy, Window window)
 
   st->ncolors = get_integer_resource (dpy, "ncolors", "Integer");
 
-  gcv.foreground = get_pixel_resource(dpy, st->xgwa.colormap,
-                                      "foreground", "Foreground");
+  gcv.foreground = st->fg_pixel =
+    get_pixel_resource(dpy, st->xgwa.colormap, "foreground", "Foreground");
   st->fgc = XCreateGC (dpy, window, GCForeground, &gcv);
 
-  gcv.foreground = get_pixel_resource(dpy, st->xgwa.colormap,
-                                      "background", "Background");
+  gcv.foreground = st->bg_pixel =
+    get_pixel_resource(dpy, st->xgwa.colormap, "background", "Background");
   st->bgc = XCreateGC (dpy, window, GCForeground, &gcv);
 
   if (st->ncolors <= 2)
@@ -232,10 +239,16 @@ deco_init (Display *dpy, Window window)
   if (!mono_p)
     {
       GC tmp = st->fgc;
+      unsigned long p = st->fg_pixel;
       st->fgc = st->bgc;
       st->bgc = tmp;
+      st->fg_pixel = st->bg_pixel;
+      st->bg_pixel = p;
     }
 
+  st->fills = xbatch_init (dpy, window);
+  st->lines = xbatch_init (dpy, window);
+
   st->mondrian = get_boolean_resource(dpy, "mondrian", "Boolean");
   if (st->mondrian) {
       /* Mondrian, if true, overrides several other options. */
@@ -302,6 +315,8 @@ deco_free (Display *dpy, Window window, void *closure)
   struct state *st = (struct state *) closure;
   XFreeGC (dpy, st->fgc);
   XFreeGC (dpy, st->bgc);
+  xbatch_free (st->fills);
+  xbatch_free (st->lines);
   free (st);
 }
 
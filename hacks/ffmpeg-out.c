@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -663,27 +664,33 @@ ffmpeg_out_init (const char *outfile, const char *audiofile,
 }
 
 
+/* Write audio until it has caught up with video frame number 'frame'. */
+static void
+write_audio (ffmpeg_out_state *ffst, int64_t frame)
+{
+  if (! ffst->audiofile) return;
+  while (av_compare_ts (frame,
+                        ffst->video_ost.ctx->time_base,
+                        ffst->samples_written,
+                        ffst->audio_ost.ctx->time_base) > 0)
+    {
+      av_check (av_frame_make_writable (ffst->audio_ost.frame));
+      get_audio_frame (ffst->audio_fmt_ctx, &ffst->audio_ist,
+                       ffst->audio_pkt, ffst->swr_ctx, &ffst->audio_ost);
+      ffst->audio_ost.frame->pts = ffst->samples_written;
+      ffst->samples_written += ffst->audio_ost.frame->nb_samples;
+
+      write_frame (ffst->oc, &ffst->audio_ost);
+    }
+}
+
+
 void
 ffmpeg_out_add_frame (ffmpeg_out_state *ffst, XImage *img)
 {
   const uint8_t *img_data = (const uint8_t *) img->data;
 
-  if (ffst->audiofile)
-    {
-      while (av_compare_ts (ffst->frames_written, 
-                            ffst->video_ost.ctx->time_base,
-                            ffst->samples_written,
-                            ffst->audio_ost.ctx->time_base) > 0)
-        {
-          av_check (av_frame_make_writable (ffst->audio_ost.frame));
-          get_audio_frame (ffst->audio_fmt_ctx, &ffst->audio_ist,
-                           ffst->audio_pkt, ffst->swr_ctx, &ffst->audio_ost);
-          ffst->audio_ost.frame->pts = ffst->samples_written;
-          ffst->samples_written += ffst->audio_ost.frame->nb_samples;
-
-          write_frame (ffst->oc, &ffst->audio_ost);
-        }
-    }
+  write_audio (ffst, ffst->frames_written);
 
   av_check (av_frame_make_writable (ffst->video_ost.frame));
 
@@ -699,6 +706,78 @@ ffmpeg_out_add_frame (ffmpeg_out_state *ffst, XImage *img)
 }
 
 
+/* Copy the video of a file written by another ffmpeg_out_state with the
+   same size and no audio onto the end of this one, without re-encoding it.
+   This is how segments rendered in parallel get joined together.
+ */
+void
+ffmpeg_out_add_file (ffmpeg_out_state *ffst, const char *infile)
+{
+  AVFormatContext *ic = NULL;
+  AVCodecParameters *ipar, *opar;
+  AVStream *ist;
+  AVPacket *pkt;
+  int64_t offset = ffst->frames_written;
+  int idx, frames = 0;
+
+  av_check (avformat_open_input (&ic, infile, NULL, NULL));
+  av_check (avformat_find_stream_info (ic, NULL));
+  idx = av_check (av_find_best_stream (ic, AVMEDIA_TYPE_VIDEO,
+                                       -1, -1, NULL, 0));
+  ist = ic->streams[idx];
+
+  /* The SPS and PPS are in the output's header, so the segment must have
+     been encoded with exactly the same ones. */
+  ipar = ist->codecpar;
+  opar = ffst->video_ost.st->codecpar;
+  if (ipar->codec_id != opar->codec_id ||
+      ipar->width  != opar->width ||
+      ipar->height != opar->height ||
+      ipar->extradata_size != opar->extradata_size ||
+      (ipar->extradata_size &&
+       memcmp (ipar->extradata, opar->extradata, ipar->extradata_size)))
+    {
+      fprintf (stderr, "%s: %s: encoded differently from %s\n",
+               progname, infile, ffst->outfile);
+      exit (1);
+    }
+
+  pkt = av_packet_alloc();
+  if (! pkt)
+    {
+      fprintf (stderr, "%s: could not allocate packet\n", progname);
+      exit (1);
+    }
+
+  while (av_read_frame (ic, pkt) >= 0)
+    {
+      if (pkt->stream_index == idx)
+        {
+          av_packet_rescale_ts (pkt, ist->time_base,
+                                ffst->video_ost.ctx->time_base);
+          if (pkt->pts != AV_NOPTS_VALUE) pkt->pts += offset;
+          if (pkt->dts != AV_NOPTS_VALUE) pkt->dts += offset;
+
+          write_audio (ffst, (pkt->pts != AV_NOPTS_VALUE
+                              ? pkt->pts
+                              : offset + frames));
+
+          av_packet_rescale_ts (pkt, ffst->video_ost.ctx->time_base,
+                                ffst->video_ost.st->time_base);
+          pkt->stream_index = ffst->video_ost.st->index;
+          pkt->pos = -1;
+          av_check (av_interleaved_write_frame (ffst->oc, pkt));
+          frames++;
+        }
+      av_packet_unref (pkt);
+    }
+
+  av_packet_free (&pkt);
+  avformat_close_input (&ic);
+  ffst->frames_written += frames;
+}
+
+
 void
 ffmpeg_out_close (ffmpeg_out_state *ffst)
 {
@@ -20,6 +20,7 @@ extern ffmpeg_out_state *ffmpeg_out_init (const char *outfile,
                                           int w, int h, int bpp,
                                           Bool fast_p);
 extern void ffmpeg_out_add_frame (ffmpeg_out_state *, XImage *);
+extern void ffmpeg_out_add_file (ffmpeg_out_state *, const char *infile);
 extern void ffmpeg_out_close (ffmpeg_out_state *);
 
 #endif /* __FFMPEG_OUT_H__ */
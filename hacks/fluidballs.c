@@ -69,6 +69,12 @@ typedef struct {
   float e;		/* coeficient of elasticity */
   float max_radius;	/* largest radius of any ball */
 
+  int grid_w, grid_h;	/* collision grid, in cells of 3 * max_radius */
+  int *cell_start;	/* index in cell_balls of each cell's first ball */
+  int *cell_balls;	/* balls, grouped by cell, in order within each */
+  int *ball_cell;	/* cell of each ball */
+  int *near;		/* balls that might touch the current one */
+
   Bool random_sizes_p;  /* Whether balls should be various sizes up to max. */
   Bool shake_p;		/* Whether to mess with gravity when things settle. */
   Bool dbuf;            /* Whether we're using double buffering. */
@@ -376,6 +382,9 @@ fluidballs_init (Display *dpy, Window window)
   state->py  = (float *) malloc (sizeof (*state->py)  * (state->count + 1));
   state->opx = (float *) malloc (sizeof (*state->opx) * (state->count + 1));
   state->opy = (float *) malloc (sizeof (*state->opy) * (state->count + 1));
+  state->cell_balls = (int *) malloc (sizeof (int) * (state->count + 1));
+  state->ball_cell  = (int *) malloc (sizeof (int) * (state->count + 1));
+  state->near       = (int *) malloc (sizeof (int) * (state->count + 1));
 
   for (i=1; i<=state->count; i++)
     {
@@ -609,12 +618,90 @@ repaint_balls (b_state *state)
 }
 
 
+/* Sorts the balls into a grid of cells as wide as the largest possible
+   pair of balls, plus max_radius, which is as far as one collision can
+   push a ball.  So a ball can only be touching the balls in its own cell
+   and the 8 around it, even after one of the two has been pushed once.
+   Balls outside the window go in the edge cells.
+ */
+static void
+build_grid (b_state *state)
+{
+  float cs = 3 * state->max_radius;
+  int gw = (state->xmax - state->xmin) / cs + 1;
+  int gh = (state->ymax - state->ymin) / cs + 1;
+  int i, n;
+
+  if (gw < 1) gw = 1;
+  if (gh < 1) gh = 1;
+  n = gw * gh;
+  if (n != state->grid_w * state->grid_h)
+    {
+      state->cell_start = (int *)
+        realloc (state->cell_start, sizeof (int) * (n + 1));
+      if (!state->cell_start) abort();
+    }
+  state->grid_w = gw;
+  state->grid_h = gh;
+
+  /* Count the balls in each cell, then turn the counts into the index of
+     the end of each cell; filling the cells from the end moves each of
+     those back to the cell's start. */
+  memset (state->cell_start, 0, sizeof (int) * (n + 1));
+  for (i = 1; i <= state->count; i++)
+    {
+      float x = (state->px[i] - state->xmin) / cs;
+      float y = (state->py[i] - state->ymin) / cs;
+      if (x < 0) x = 0; else if (x > gw - 1) x = gw - 1;
+      if (y < 0) y = 0; else if (y > gh - 1) y = gh - 1;
+      state->ball_cell[i] = (int) y * gw + (int) x;
+      state->cell_start[state->ball_cell[i]]++;
+    }
+  for (i = 1; i <= n; i++)
+    state->cell_start[i] += state->cell_start[i-1];
+  for (i = state->count; i >= 1; i--)
+    state->cell_balls[--state->cell_start[state->ball_cell[i]]] = i;
+}
+
+
+/* Fills in state->near with the balls after 'a' in the cells around it,
+   in increasing order, and returns how many there are.
+ */
+static int
+find_neighbors (b_state *state, int a)
+{
+  int gw = state->grid_w;
+  int cx = state->ball_cell[a] % gw;
+  int cy = state->ball_cell[a] / gw;
+  int x, y, i, j, n = 0;
+
+  for (y = (cy > 0 ? cy - 1 : 0);
+       y <= (cy < state->grid_h - 1 ? cy + 1 : cy);
+       y++)
+    for (x = (cx > 0 ? cx - 1 : 0);
+         x <= (cx < gw - 1 ? cx + 1 : cx);
+         x++)
+      {
+        int c = y * gw + x;
+        for (i = state->cell_start[c]; i < state->cell_start[c+1]; i++)
+          {
+            int b = state->cell_balls[i];
+            if (b <= a) continue;
+            for (j = n++; j > 0 && state->near[j-1] > b; j--)
+              state->near[j] = state->near[j-1];
+            state->near[j] = b;
+          }
+      }
+  return n;
+}
+
+
 /* Implements the laws of physics: move balls to their new positions.
  */
 static void
 update_balls (b_state *state)
 {
-  int a, b;
+  int a, b, k;
   float d, vxa, vya, vxb, vyb, dd, cdx, cdy;
   float ma, mb, vca, vcb, dva, dvb;
   float dee2;
@@ -639,67 +726,80 @@ update_balls (b_state *state)
          state->tc);
     }
 
-  /* For each ball, compute the influence of every other ball. */
+  /* For each ball, compute the influence of every other ball that is
+     close enough to touch it.  The neighbors are visited in the same
+     order as the all-pairs loop would have, but the grid is built before
+     any of this step's pushes, so this is an approximation: a ball that
+     is shoved more than max_radius by a pile-up of collisions can end up
+     touching a ball that isn't in the cells around it, and that pair is
+     not separated until the next step. */
+  build_grid (state);
   for (a=1; a <= state->count -  1; a++)
-    for (b=a + 1; b <= state->count; b++)
-      {
-         d = ((state->px[a] - state->px[b]) *
-              (state->px[a] - state->px[b]) +
-              (state->py[a] - state->py[b]) *
-              (state->py[a] - state->py[b]));
-         dee2 = (state->r[a] + state->r[b]) *
-                (state->r[a] + state->r[b]);
-         if (d < dee2)
-         {
-            state->collision_count++;
-            d = sqrt(d);
-            dd = state->r[a] + state->r[b] - d;
-
-            cdx = (state->px[b] - state->px[a]) / d;
-            cdy = (state->py[b] - state->py[a]) / d;
-
-            /* Move each ball apart from the other by half the
-             * 'collision' distance.
-             */
-            state->px[a] -= 0.5 * dd * cdx;
-            state->py[a] -= 0.5 * dd * cdy;
-            state->px[b] += 0.5 * dd * cdx;
-            state->py[b] += 0.5 * dd * cdy;
-
-            ma = state->m[a];
-            mb = state->m[b];
-
-            vxa = state->vx[a];
-            vya = state->vy[a];
-            vxb = state->vx[b];
-            vyb = state->vy[b];
-
-            vca = vxa * cdx + vya * cdy; /* the component of each velocity */
-            vcb = vxb * cdx + vyb * cdy; /* along the axis of the collision */
-
-            /* elastic collison */
-            dva = (vca * (ma - mb) + vcb * 2 * mb) / (ma + mb) - vca;
-            dvb = (vcb * (mb - ma) + vca * 2 * ma) / (ma + mb) - vcb;
-
-            dva *= state->e; /* some energy lost to inelasticity */
-            dvb *= state->e;
+    {
+      int n = find_neighbors (state, a);
+      for (k=0; k < n; k++)
+        {
+          b = state->near[k];
+          d = ((state->px[a] - state->px[b]) *
+               (state->px[a] - state->px[b]) +
+               (state->py[a] - state->py[b]) *
+               (state->py[a] - state->py[b]));
+          dee2 = (state->r[a] + state->r[b]) *
+                 (state->r[a] + state->r[b]);
+          if (d < dee2)
+            {
+              state->collision_count++;
+              d = sqrt(d);
+              dd = state->r[a] + state->r[b] - d;
+
+              cdx = (state->px[b] - state->px[a]) / d;
+              cdy = (state->py[b] - state->py[a]) / d;
+
+              /* Move each ball apart from the other by half the
+               * 'collision' distance.
+               */
+              state->px[a] -= 0.5 * dd * cdx;
+              state->py[a] -= 0.5 * dd * cdy;
+              state->px[b] += 0.5 * dd * cdx;
+              state->py[b] += 0.5 * dd * cdy;
+
+              ma = state->m[a];
+              mb = state->m[b];
+
+              vxa = state->vx[a];
+              vya = state->vy[a];
+              vxb = state->vx[b];
+              vyb = state->vy[b];
+
+              /* the component of each velocity along the axis of the
+                 collision */
+              vca = vxa * cdx + vya * cdy;
+              vcb = vxb * cdx + vyb * cdy;
+
+              /* elastic collison */
+              dva = (vca * (ma - mb) + vcb * 2 * mb) / (ma + mb) - vca;
+              dvb = (vcb * (mb - ma) + vca * 2 * ma) / (ma + mb) - vcb;
+
+              dva *= state->e; /* some energy lost to inelasticity */
+              dvb *= state->e;
 
 #if 0
-            dva += (frand (50) - 25) / ma;   /* q: why are elves so chaotic? */
-            dvb += (frand (50) - 25) / mb;   /* a: brownian motion. */
+              dva += (frand (50) - 25) / ma; /* q: why are elves so chaotic? */
+              dvb += (frand (50) - 25) / mb; /* a: brownian motion. */
 #endif
 
-            vxa += dva * cdx;
-            vya += dva * cdy;
-            vxb += dvb * cdx;
-            vyb += dvb * cdy;
+              vxa += dva * cdx;
+              vya += dva * cdy;
+              vxb += dvb * cdx;
+              vyb += dvb * cdy;
 
-            state->vx[a] = vxa;
-            state->vy[a] = vya;
-            state->vx[b] = vxb;
-            state->vy[b] = vyb;
-         }
-      }
+              state->vx[a] = vxa;
+              state->vy[a] = vya;
+              state->vx[b] = vxb;
+              state->vy[b] = vyb;
+            }
+        }
+    }
 
    /* Force all balls to be on screen.
     */
@@ -828,6 +928,10 @@ fluidballs_free (Display *dpy, Window window, void *closure)
   free (state->py);
   free (state->opx);
   free (state->opy);
+  free (state->cell_start);
+  free (state->cell_balls);
+  free (state->ball_cell);
+  free (state->near);
   free (state);
 }
 
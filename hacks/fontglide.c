@@ -218,20 +218,10 @@ pick_font_1 (state *s, sentence *se)
     {
       unsigned long pixel = pick_font_size (s);
 
-      /* https://keithp.com/~keithp/render/Xft.tutorial */
-      XftFontSet *fs =
-        XftListFonts (s->dpy, DefaultScreen (s->dpy),
-                      /* Pattern-triples to match, followed by a NULL */
-                      /* XFT_FAMILY, XftTypeString, "Helvetica", */
-                      /* XFT_SIZE,   XftTypeDouble, 12.0,        */
-                      NULL,
-                      /* Properties to return, followed by a second NULL */
-                      XFT_FAMILY,
-                      XFT_STYLE,
-                      XFT_SLANT,
-                      XFT_WEIGHT,
-                      XFT_SIZE,
-                      NULL);
+      /* https://keithp.com/~keithp/render/Xft.tutorial
+         Listing every font on the system is slow, so this is only done
+         once. */
+      XftFontSet *fs = xft_font_catalogue (s->dpy, DefaultScreen (s->dpy));
       XftPattern *pat;
       char name1[1024], name2[1024], *s1, *s2;
       XftFont *font;
@@ -260,7 +250,8 @@ pick_font_1 (state *s, sentence *se)
       name2[s2 - name1] = 0;
       sprintf (name2 + strlen(name2), "-%ld:", pixel);
       strcat (name2, s2 + 1);
-      font = XftFontOpenName (s->dpy, screen_number (s->xgwa.screen), name2);
+      font = open_xft_font_cached (s->dpy, screen_number (s->xgwa.screen),
+                                   name2);
 
       if (!font)
         {
@@ -269,9 +260,6 @@ pick_font_1 (state *s, sentence *se)
           return False;
         }
 
-      /* #### This gets a link error with FcFontSetDestroy missing. */
-      /* if (fs) XftFontSetDestroy (fs); */
-
       sprintf(pattern, "%s", name2);
       se->xftfont = font;
       ok = True;
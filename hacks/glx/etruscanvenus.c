@@ -194,6 +194,7 @@ static const char sccsid[] = "@(#)etruscanvenus.c  1.1 05/01/20 xlockmore";
 
 #include "glsl-utils.h"
 #include "gltrackball.h"
+#include "gridsurf.h"
 
 #include <float.h>
 
@@ -353,6 +354,8 @@ typedef struct {
   float *tex;
   /* The "curlicue" texture */
   GLuint tex_name;
+  /* The triangles of the fixed-function path */
+  gridsurf_strips strips;
   /* Aspect ratio of the current window */
   float aspect;
   /* Trackball states */
@@ -1043,11 +1046,12 @@ static int etruscan_venus_ff(ModeInfo *mi, double umin, double umax,
   static const GLfloat mat_diff_trans_oneside[] = { 0.9, 0.4, 0.3, 0.7 };
   float mat_diff_dyn[4], mat_diff_dyn_compl[4];
   float p[3], pu[3], pv[3], n[3], mat[3][3], matc[3][3];
-  int i, j, k, l, m, o;
+  int i, j, l, m, o;
   float u, v, ur, vr, oz, vc;
   float xx[3], xxu[3], xxv[3];
   float r, s, t;
   float dd, bb, ll, db, dl, radius;
+  gridsurf_layout layout;
   float cv, sv, c2v, s2v, cu, su, c2u, s2u, c3u, s3u;
   float bosqrt2, b2osqrt2, b3osqrt2, nom, den, nomv, denu, denv, den2;
   float f, fx, fy, fz, x, y, z;
@@ -1552,74 +1556,31 @@ static int etruscan_venus_ff(ModeInfo *mi, double umin, double umax,
     }
   }
 
+  layout.rows = numv;
+  layout.cols = numu;
+  layout.wireframe_p = (ev->display_mode == DISP_WIREFRAME);
   if (ev->appearance == APPEARANCE_DISTANCE_BANDS)
   {
-    for (i=0; i<numv; i++)
-    {
-      if ((i & (NUMBDIST-1)) >= NUMBDIST/4 &&
-          (i & (NUMBDIST-1)) < 3*NUMBDIST/4)
-        continue;
-      if (ev->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (j=0; j<=numu; j++)
-      {
-        for (k=0; k<=1; k++)
-        {
-          l = i+k;
-          m = j;
-          o = l*(numu+1)+m;
-          glTexCoord2fv(&ev->tex[2*o]);
-          if (ev->colors != COLORS_ONESIDED && ev->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(&ev->col[4*o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,
-                         &ev->col[4*o]);
-          }
-          glNormal3fv(&ev->evn[3*o]);
-          glVertex3fv(&ev->ev[3*o]);
-        }
-      }
-      glEnd();
-    }
+    layout.columns_p = False;
+    layout.band_period = NUMBDIST;
+    layout.band_lo = NUMBDIST/4;
+    layout.band_hi = 3*NUMBDIST/4;
     polys = numv*(numu+1);
   }
   else /* ev->appearance != APPEARANCE_DISTANCE_BANDS */
   {
-    for (j=0; j<numu; j++)
-    {
-      if (ev->appearance == APPEARANCE_DIRECTION_BANDS &&
-          ((j & (NUMBDIR-1)) >= NUMBDIR/2))
-        continue;
-      if (ev->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (i=0; i<=numv; i++)
-      {
-        for (k=0; k<=1; k++)
-        {
-          l = i;
-          m = j+k;
-          o = l*(numu+1)+m;
-          glTexCoord2fv(&ev->tex[2*o]);
-          if (ev->colors != COLORS_ONESIDED && ev->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(&ev->col[4*o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,
-                         &ev->col[4*o]);
-          }
-          glNormal3fv(&ev->evn[3*o]);
-          glVertex3fv(&ev->ev[3*o]);
-        }
-      }
-      glEnd();
-    }
+    layout.columns_p = True;
+    layout.band_period =
+      (ev->appearance == APPEARANCE_DIRECTION_BANDS) ? NUMBDIR : 0;
+    layout.band_lo = NUMBDIR/2;
+    layout.band_hi = NUMBDIR;
     polys = 2*numu*(numv+1);
     if (ev->appearance == APPEARANCE_DIRECTION_BANDS)
       polys /= 2;
   }
+  gridsurf_draw(&ev->strips,&layout,ev->ev,ev->evn,ev->tex,
+                (ev->colors != COLORS_ONESIDED &&
+                 ev->colors != COLORS_TWOSIDED) ? ev->col : NULL);
 
   return polys;
 }
@@ -2733,6 +2694,7 @@ ENTRYPOINT void free_etruscanvenus(ModeInfo *mi)
   if (ev->tex) free(ev->tex);
   gltrackball_free(ev->trackball);
   if (ev->tex_name) glDeleteTextures(1, &ev->tex_name);
+  gridsurf_free(&ev->strips);
 #ifdef HAVE_GLSL
   if (ev->uv) free(ev->uv);
   if (ev->indices) free(ev->indices);
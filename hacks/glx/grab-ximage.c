@@ -43,9 +43,19 @@
    a second copy of the data and iterating each pixel before we hand it
    to GL.  But, you'd be wrong.  The first method is almost 6x faster.
    I guess GL is reformatting it *again*, and doing it very inefficiently!
+
+   The exception is the overwhelmingly common case of 32-bit xRGB in the
+   local byte order: that is exactly BGRA, INT_8_8_8_8_REV, which every
+   desktop driver takes without reformatting.  With NATIVE_BGRA, that
+   case skips the conversion even when REFORMAT_IMAGE_DATA is on, and
+   uses an RGB texture so that the pad byte isn't taken as alpha.
 */
 #define REFORMAT_IMAGE_DATA
 
+#if !defined(HAVE_JWXYZ) && !defined(HAVE_JWZGLES)
+# define NATIVE_BGRA
+#endif
+
 #undef MAX
 #define MAX(a,b) ((a)>(b)?(a):(b))
 
@@ -66,6 +76,56 @@ bigendian (void)
 # define GENERATE_MIPMAPS
 #endif
 
+/* With GL 3.0 or GLES 3.0, the incremental loader streams its stripes
+   through a ring of pixel buffer objects, so that glTexSubImage2D can
+   return before the driver has copied the data.  The buffer functions
+   are only declared when we have glext.h, which HAVE_GLSL implies.
+ */
+#if defined(NATIVE_BGRA) && defined(HAVE_GLSL)
+# define USE_PBO
+# define PBO_RING 3
+#endif
+
+
+/* The major version of the current GL context, or 0 if unknown.
+ */
+static int
+gl_major_version (void)
+{
+  static int major = -1;
+  if (major < 0)
+    {
+      const char *s = (const char *) glGetString (GL_VERSION);
+      major = 0;
+      if (s && !strncmp (s, "OpenGL ES ", 10))
+        s += 10;
+      if (s)
+        major = atoi (s);
+      if (debug_p)
+        fprintf (stderr, "%s: GL version %s\n", progname, (s ? s : "???"));
+    }
+  return major;
+}
+
+
+#ifdef NATIVE_BGRA
+
+/* Whether the image is 32-bit xRGB in local byte order, i.e., data that
+   GL can use directly as GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV.
+ */
+static Bool
+native_bgra_p (XImage *image)
+{
+  return (image->format         == ZPixmap &&
+          image->bits_per_pixel == 32 &&
+          image->red_mask       == 0x00FF0000 &&
+          image->green_mask     == 0x0000FF00 &&
+          image->blue_mask      == 0x000000FF &&
+          image->byte_order     == (bigendian() ? MSBFirst : LSBFirst));
+}
+
+#endif /* NATIVE_BGRA */
+
 
 #ifdef REFORMAT_IMAGE_DATA
 
@@ -279,10 +339,12 @@ halve_image (XImage *ximage, XRectangle *geom)
 #ifdef REFORMAT_IMAGE_DATA
 
 /* Pulls the Pixmap bits from the server and returns an XImage
-   in some format acceptable to OpenGL.
+   in some format acceptable to OpenGL, and the GL format and type
+   that describe it.
  */
 static XImage *
-pixmap_to_gl_ximage (Screen *screen, Window window, Pixmap pixmap)
+pixmap_to_gl_ximage (Screen *screen, Window window, Pixmap pixmap,
+                     GLint *format_ret, GLint *type_ret)
 {
   Display *dpy = DisplayOfScreen (screen);
   Visual *visual = DefaultVisualOfScreen (screen);
@@ -309,7 +371,34 @@ pixmap_to_gl_ximage (Screen *screen, Window window, Pixmap pixmap)
                                      width, height);
   get_xshm_image (dpy, pixmap, server_ximage, 0, 0, ~0L, &shm_info);
 
-  client_ximage = convert_ximage_to_rgba32 (screen, server_ximage);
+# ifdef NATIVE_BGRA
+  if (native_bgra_p (server_ximage))
+    {
+      /* Already in GL order: just copy it out of the shared segment.
+         Note: height+2, as in convert_ximage_to_rgba32. */
+      unsigned int y;
+      client_ximage = XCreateImage (dpy, visual, 32, ZPixmap, 0, 0,
+                                    width, height, 32, 0);
+      client_ximage->byte_order = server_ximage->byte_order;
+      client_ximage->red_mask   = server_ximage->red_mask;
+      client_ximage->green_mask = server_ximage->green_mask;
+      client_ximage->blue_mask  = server_ximage->blue_mask;
+      client_ximage->data = (char *)
+        calloc (client_ximage->height + 2, client_ximage->bytes_per_line);
+      for (y = 0; y < height; y++)
+        memcpy (client_ximage->data + y * client_ximage->bytes_per_line,
+                server_ximage->data + y * server_ximage->bytes_per_line,
+                width * 4);
+      *format_ret = GL_BGRA;
+      *type_ret   = GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+  else
+# endif /* NATIVE_BGRA */
+    {
+      client_ximage = convert_ximage_to_rgba32 (screen, server_ximage);
+      *format_ret = GL_RGBA;
+      *type_ret   = GL_UNSIGNED_BYTE;
+    }
 
   destroy_xshm_image (dpy, server_ximage, &shm_info);
 
@@ -479,6 +568,11 @@ struct texture_loader_t {
   int y;
   unsigned int stripe_height;
   char *name;
+  Bool native_p;	/* ximage can be uploaded as-is */
+# ifdef USE_PBO
+  GLuint pbo[PBO_RING];
+  int pbo_count, pbo_next;
+# endif
 
   /* debugging */
   int steps;        /* number of calls to step_texture_loader() that loaded part of the texture */
@@ -507,9 +601,34 @@ ximage_to_texture (XImage *ximage,
   int orig_height = ximage->height;
   GLsizei tex_width = 0;
   GLsizei tex_height = 0;
+  /* The pad byte of native data is not alpha. */
+  GLint internal = (format == GL_RGBA ? GL_RGBA : GL_RGB);
 
  AGAIN:
 
+# ifdef GENERATE_MIPMAPS
+  if (mipmap_p && gl_major_version() >= 3)
+    {
+      /* GL 3 has non-power-of-2 textures, and builds the mipmaps itself,
+         instead of gluBuild2DMipmaps rescaling and reducing on the CPU. */
+      tex_width  = ximage->width;
+      tex_height = ximage->height;
+
+      if (debug_p)
+        fprintf (stderr, "%s: generate mipmap %d x %d\n",
+                 progname, ximage->width, ximage->height);
+
+      glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, tex_width, tex_height, 0,
+                    format, type, ximage->data);
+      err = glGetError();
+      if (!err)
+        {
+          glGenerateMipmap (GL_TEXTURE_2D);
+          err = glGetError();
+        }
+    }
+  else
+# endif /* GENERATE_MIPMAPS */
   if (mipmap_p)
     {
       /* gluBuild2DMipmaps doesn't require textures to be a power of 2. */
@@ -538,7 +657,7 @@ ximage_to_texture (XImage *ximage,
                  progname, ximage->width, ximage->height,
                  tex_width, tex_height);
 
-      glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, tex_width, tex_height, 0,
+      glTexImage2D (GL_TEXTURE_2D, 0, internal, tex_width, tex_height, 0,
                     format, type, 0);
       err = glGetError();
 
@@ -547,7 +666,7 @@ ximage_to_texture (XImage *ximage,
         {
           glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0,
                            ximage->width, ximage->height,
-                           GL_RGBA, GL_UNSIGNED_BYTE, ximage->data);
+                           format, type, ximage->data);
           err = glGetError();
         }
     }
@@ -711,6 +830,19 @@ alloc_texture_loader (Screen *screen, Window window,
 }
 
 
+static void
+free_texture_loader_pbos (texture_loader_t *loader)
+{
+# ifdef USE_PBO
+  if (loader->pbo_count)
+    {
+      glDeleteBuffers (loader->pbo_count, loader->pbo);
+      loader->pbo_count = 0;
+    }
+# endif /* USE_PBO */
+}
+
+
 /* Free the texture loader
  */
 void
@@ -731,6 +863,16 @@ free_texture_loader (texture_loader_t *loader)
     destroy_xshm_image (dpy, ximage, &loader->shm_info);
   }
 
+# ifdef USE_PBO
+  if (loader->pbo_count)
+    {
+      if (loader->load_closure.glx_context)
+        glXMakeCurrent (dpy, loader->window,
+                        loader->load_closure.glx_context);
+      free_texture_loader_pbos (loader);
+    }
+# endif /* USE_PBO */
+
   if (loader->pixmap_valid_p)
   {
     loader->pixmap_valid_p = False;
@@ -784,9 +926,7 @@ load_texture_async_cb (Screen *screen, Window window, Drawable drawable,
     cvt_time = double_time();
 
 # ifdef REFORMAT_IMAGE_DATA
-  ximage = pixmap_to_gl_ximage (screen, window, dd.pixmap);
-  format = GL_RGBA;
-  type = GL_UNSIGNED_BYTE;
+  ximage = pixmap_to_gl_ximage (screen, window, dd.pixmap, &format, &type);
 
 #else /* ! REFORMAT_IMAGE_DATA */
   {
@@ -953,9 +1093,17 @@ incremental_load_texture_async_cb (Screen *screen, Window window,
   tex_width  = (GLsizei) to_pow2 (loader->ximage->width);
   tex_height = (GLsizei) to_pow2 (loader->ximage->height);
 
+# ifdef NATIVE_BGRA
+  loader->native_p = native_bgra_p (loader->ximage);
+# endif
+
   /* glTexImage2D() to allocate OpenGL texture */
-  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, tex_width, tex_height, 0,
-                GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  if (loader->native_p)
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, tex_width, tex_height, 0,
+                  GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+  else
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, tex_width, tex_height, 0,
+                  GL_RGBA, GL_UNSIGNED_BYTE, 0);
   err = glGetError();
 
   if (err)
@@ -965,6 +1113,14 @@ incremental_load_texture_async_cb (Screen *screen, Window window,
     return;
   }
 
+# ifdef USE_PBO
+  if (loader->native_p && gl_major_version() >= 3)
+    {
+      glGenBuffers (PBO_RING, loader->pbo);
+      loader->pbo_count = PBO_RING;
+    }
+# endif /* USE_PBO */
+
   /* Capture texture dimensions and name in loader */
   loader->tex_width = tex_width;
   loader->tex_height = tex_height;
@@ -1036,6 +1192,56 @@ texture_loader_next_stripe_height (texture_loader_t *loader)
 }
 
 
+#ifdef NATIVE_BGRA
+
+/* Copies the next stripe of a BGRA image into the texture, without
+   converting it, through the next pixel buffer object if we have them.
+ */
+static void
+upload_native_stripe (texture_loader_t *loader, unsigned int height)
+{
+  XImage *ximage = loader->ximage;
+  const char *data = ximage->data + loader->y * ximage->bytes_per_line;
+
+  glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei (GL_UNPACK_ROW_LENGTH, ximage->bytes_per_line / 4);
+
+# ifdef USE_PBO
+  if (loader->pbo_count)
+    {
+      GLsizeiptr size = (GLsizeiptr) height * ximage->bytes_per_line;
+      void *buf;
+
+      glBindBuffer (GL_PIXEL_UNPACK_BUFFER, loader->pbo[loader->pbo_next]);
+      loader->pbo_next = (loader->pbo_next + 1) % loader->pbo_count;
+
+      /* Orphan the previous contents, so that we don't have to wait for
+         the GPU to finish reading them. */
+      glBufferData (GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+      buf = glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, size,
+                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      if (buf)
+        memcpy (buf, data, size);
+      if (buf && glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER))
+        data = 0;	/* offset 0 in the bound buffer */
+      else
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+# endif /* USE_PBO */
+
+  glTexSubImage2D (GL_TEXTURE_2D, 0, 0, loader->y, ximage->width, height,
+                   GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, data);
+
+# ifdef USE_PBO
+  if (loader->pbo_count)
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+# endif
+  glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+}
+
+#endif /* NATIVE_BGRA */
+
+
 static void
 advance_texture_loader (texture_loader_t *loader, double allowed_seconds)
 {
@@ -1063,12 +1269,11 @@ advance_texture_loader (texture_loader_t *loader, double allowed_seconds)
         * Import the data to the next stripe of the texture with glTexSubImage2D()
         * XDestroyImage() to destroy the converted image
         * Increment loader->y by loader->stripe_height
+
+       If the shared image is already BGRA, the stripe goes straight from
+       it to glTexSubImage2D() instead.
      */
     unsigned int patch_height = texture_loader_next_stripe_height (loader);
-    XImage* patch = XSubImage (loader->ximage,
-                               0, loader->y,
-                               loader->img_width, patch_height);
-    XImage* cvt_patch = convert_ximage_to_rgba32 (loader->screen, patch);
     Bool use_old_mipmap_p = False;
 # ifdef GENERATE_MIPMAPS
     use_old_mipmap_p = (loader->load_closure.mipmap_p &&
@@ -1078,26 +1283,38 @@ advance_texture_loader (texture_loader_t *loader, double allowed_seconds)
 
     loader->stripes++;
 
-    XDestroyImage (patch);
-
     glBindTexture (GL_TEXTURE_2D, loader->load_closure.texid);
-    glPixelStorei (GL_UNPACK_ALIGNMENT, cvt_patch->bitmap_pad / 8);
 
     if (use_old_mipmap_p)
       /* Use old GL_GENERATE_MIPMAP (if before OpenGL 3.0) */
       glTexParameteri (GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
 
-    /* CHECK: loader->y or -loader->y? */
-    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, loader->y,
-                     cvt_patch->width, cvt_patch->height,
-                     GL_RGBA, GL_UNSIGNED_BYTE, cvt_patch->data);
+# ifdef NATIVE_BGRA
+    if (loader->native_p)
+      upload_native_stripe (loader, patch_height);
+    else
+# endif
+      {
+        XImage* patch = XSubImage (loader->ximage,
+                                   0, loader->y,
+                                   loader->img_width, patch_height);
+        XImage* cvt_patch = convert_ximage_to_rgba32 (loader->screen, patch);
+        XDestroyImage (patch);
+
+        glPixelStorei (GL_UNPACK_ALIGNMENT, cvt_patch->bitmap_pad / 8);
+
+        /* CHECK: loader->y or -loader->y? */
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, loader->y,
+                         cvt_patch->width, cvt_patch->height,
+                         GL_RGBA, GL_UNSIGNED_BYTE, cvt_patch->data);
+
+        XDestroyImage (cvt_patch);
+      }
 
     if (use_old_mipmap_p)
       /* Turn off GL_GENERATE_MIPMAP if we turned it on */
       glTexParameteri (GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
 
-    XDestroyImage (cvt_patch);
-
     lines_processed += patch_height;
   }
 
@@ -1145,6 +1362,7 @@ complete_texture_load (texture_loader_t *loader,
 
   loader->ximage = 0;
   destroy_xshm_image (dpy, ximage, &loader->shm_info);
+  free_texture_loader_pbos (loader);
 
   loader->pixmap_valid_p = False;
   XFreePixmap (dpy, loader->load_closure.pixmap);
@@ -0,0 +1,267 @@
+/* gridsurf.c --- fixed-function drawing of parametric surface grids.
+ * xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#include "screenhackI.h"
+#include "gridsurf.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#if defined __GNUC__ || defined __clang__
+typedef float v4sf __attribute__((vector_size(4*sizeof(float))));
+#endif
+
+
+void
+gridsurf_project_4d (int n, float (*x)[4],
+                     float (*xu)[4], float (*xv)[4],
+                     float mat[4][4], const float offset4d[4],
+                     Bool perspective_p, float ortho_scale,
+                     const float offset3d[3],
+                     float (*pp)[3], float (*pn)[3])
+{
+  float pu[3], pv[3], nn[3], q, s, t;
+  int o, l;
+
+#if defined __GNUC__ || defined __clang__
+  /* mat*x as the sum of the columns of mat scaled by the elements of x:
+     four multiply-adds on whole 4-vectors per point. */
+  const v4sf c0 = { mat[0][0], mat[1][0], mat[2][0], mat[3][0] };
+  const v4sf c1 = { mat[0][1], mat[1][1], mat[2][1], mat[3][1] };
+  const v4sf c2 = { mat[0][2], mat[1][2], mat[2][2], mat[3][2] };
+  const v4sf c3 = { mat[0][3], mat[1][3], mat[2][3], mat[3][3] };
+  const v4sf off = { offset4d[0], offset4d[1], offset4d[2], offset4d[3] };
+#endif
+
+  for (o=0; o<n; o++)
+  {
+#if defined __GNUC__ || defined __clang__
+    v4sf y  = c0*x[o][0]  + c1*x[o][1]  + c2*x[o][2]  + c3*x[o][3] + off;
+    v4sf yu = c0*xu[o][0] + c1*xu[o][1] + c2*xu[o][2] + c3*xu[o][3];
+    v4sf yv = c0*xv[o][0] + c1*xv[o][1] + c2*xv[o][2] + c3*xv[o][3];
+#else  /* !(__GNUC__ || __clang__) */
+    float y[4], yu[4], yv[4];
+    for (l=0; l<4; l++)
+    {
+      y[l] = (mat[l][0]*x[o][0]+mat[l][1]*x[o][1]+
+              mat[l][2]*x[o][2]+mat[l][3]*x[o][3]+offset4d[l]);
+      yu[l] = (mat[l][0]*xu[o][0]+mat[l][1]*xu[o][1]+
+               mat[l][2]*xu[o][2]+mat[l][3]*xu[o][3]);
+      yv[l] = (mat[l][0]*xv[o][0]+mat[l][1]*xv[o][1]+
+               mat[l][2]*xv[o][2]+mat[l][3]*xv[o][3]);
+    }
+#endif /* !(__GNUC__ || __clang__) */
+
+    if (perspective_p)
+    {
+      /* p = y/y[3], and its derivatives by the quotient rule. */
+      s = y[3];
+      q = 1.0f/s;
+      t = q*q;
+      for (l=0; l<3; l++)
+      {
+        pp[o][l] = y[l]*q+offset3d[l];
+        pu[l] = (yu[l]*s-y[l]*yu[3])*t;
+        pv[l] = (yv[l]*s-y[l]*yv[3])*t;
+      }
+    }
+    else
+    {
+      for (l=0; l<3; l++)
+      {
+        pp[o][l] = y[l]*ortho_scale+offset3d[l];
+        pu[l] = yu[l];
+        pv[l] = yv[l];
+      }
+    }
+
+    nn[0] = pu[1]*pv[2]-pu[2]*pv[1];
+    nn[1] = pu[2]*pv[0]-pu[0]*pv[2];
+    nn[2] = pu[0]*pv[1]-pu[1]*pv[0];
+    t = 1.0f/sqrtf(nn[0]*nn[0]+nn[1]*nn[1]+nn[2]*nn[2]);
+    pn[o][0] = nn[0]*t;
+    pn[o][1] = nn[1]*t;
+    pn[o][2] = nn[2]*t;
+  }
+}
+
+
+/* The largest index that fits in a gridsurf_index.  A grid with more
+   vertices than that is drawn in several batches, each with the vertex
+   arrays starting at its own base vertex. */
+#ifdef HAVE_JWZGLES
+# define MAX_INDEX 0xFFFF
+#else
+# define MAX_INDEX 0xFFFFFFFF
+#endif
+
+
+static void
+add_batch (gridsurf_strips *gs, unsigned long base, int first)
+{
+  gridsurf_batch *b;
+  if (gs->nbatches >= gs->batches_size)
+  {
+    gs->batches_size = (gs->batches_size ? gs->batches_size * 2 : 4);
+    gs->batches = (gridsurf_batch *)
+      realloc (gs->batches, gs->batches_size * sizeof(*gs->batches));
+    if (!gs->batches) abort();
+  }
+  b = &gs->batches[gs->nbatches++];
+  b->base = base;
+  b->first = first;
+  b->count = 0;		/* filled in when the list is done */
+}
+
+
+/* Turn each strip into the triangles that GL_TRIANGLE_STRIP would have
+   made of it, with the same winding, since that decides which side gets
+   the front material.  For a quad whose corners are a and c on one edge of
+   the strip and b and d on the other, those are (a,b,c) and (c,b,d). */
+static void
+build_indices (gridsurf_strips *gs, const gridsurf_layout *L)
+{
+  int stride  = L->cols + 1;
+  int nstrips = (L->columns_p ? L->cols : L->rows);
+  int along   = (L->columns_p ? L->rows : L->cols);
+  int across  = (L->columns_p ? 1 : stride);	/* to the next strip */
+  int step    = (L->columns_p ? stride : 1);	/* along this strip */
+  int need = nstrips * along * 6;
+  unsigned long base = 0;
+  int s, i;
+  gridsurf_index *ip;
+
+  if (need > gs->size)
+  {
+    gs->size = need;
+    gs->indices = (gridsurf_index *)
+      realloc (gs->indices, gs->size * sizeof(*gs->indices));
+    if (!gs->indices) abort();
+  }
+
+  gs->nbatches = 0;
+  ip = gs->indices;
+  for (s=0; s<nstrips; s++)
+  {
+    if (L->band_period &&
+        (s % L->band_period) >= L->band_lo &&
+        (s % L->band_period) < L->band_hi)
+      continue;
+    for (i=0; i<along; i++)
+    {
+      /* a is the lowest corner of the quad and d the highest. */
+      unsigned long a = s*across + i*step;
+      unsigned long d = a + across + step;
+      gridsurf_index qa, qb, qc, qd;
+      if (gs->nbatches == 0 || a < base || d - base > MAX_INDEX)
+      {
+        base = a;
+        add_batch (gs, base, ip - gs->indices);
+      }
+      qa = a - base;
+      qb = qa + across;
+      qc = qa + step;
+      qd = qb + step;
+#ifndef HAVE_JWZGLES	/* No GL_QUADS, and no glPolygonMode either. */
+      if (L->wireframe_p)
+      {
+        /* GL_QUAD_STRIP's a,b,d,c, rotated so that d, which is what
+           GL_FLAT shading colored it with, is still last. */
+        *ip++ = qc; *ip++ = qa; *ip++ = qb; *ip++ = qd;
+        continue;
+      }
+#endif
+      *ip++ = qa; *ip++ = qb; *ip++ = qc;
+      *ip++ = qc; *ip++ = qb; *ip++ = qd;
+    }
+  }
+  gs->count = ip - gs->indices;
+  for (s=0; s<gs->nbatches; s++)
+    gs->batches[s].count = ((s+1 < gs->nbatches
+                             ? gs->batches[s+1].first
+                             : gs->count)
+                            - gs->batches[s].first);
+  gs->layout = *L;
+}
+
+
+void
+gridsurf_draw (gridsurf_strips *gs, const gridsurf_layout *layout,
+               const GLfloat *pp, const GLfloat *pn,
+               const GLfloat *tex, const GLfloat *col)
+{
+  GLenum mode = GL_TRIANGLES;
+  int i;
+
+  if (!gs->indices || memcmp (&gs->layout, layout, sizeof(*layout)))
+    build_indices (gs, layout);
+  if (gs->count == 0)
+    return;
+
+#ifndef HAVE_JWZGLES
+  if (layout->wireframe_p)
+    mode = GL_QUADS;
+#endif
+
+  glEnableClientState (GL_VERTEX_ARRAY);
+  glEnableClientState (GL_NORMAL_ARRAY);
+  if (tex)
+    glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+  if (col)
+  {
+    /* Instead of a glMaterialfv for every vertex. */
+    glColorMaterial (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    glEnable (GL_COLOR_MATERIAL);
+    glEnableClientState (GL_COLOR_ARRAY);
+  }
+
+  /* Almost always just one batch, with base 0. */
+  for (i=0; i<gs->nbatches; i++)
+  {
+    const gridsurf_batch *b = &gs->batches[i];
+    if (b->count == 0) continue;
+    glVertexPointer (3, GL_FLOAT, 0, pp + 3*b->base);
+    glNormalPointer (GL_FLOAT, 0, pn + 3*b->base);
+    if (tex)
+      glTexCoordPointer (2, GL_FLOAT, 0, tex + 2*b->base);
+    if (col)
+      glColorPointer (4, GL_FLOAT, 0, col + 4*b->base);
+    glDrawElements (mode, b->count,
+# ifdef HAVE_JWZGLES
+                    GL_UNSIGNED_SHORT,
+# else
+                    GL_UNSIGNED_INT,
+# endif
+                    gs->indices + b->first);
+  }
+
+  if (col)
+  {
+    glDisableClientState (GL_COLOR_ARRAY);
+    glDisable (GL_COLOR_MATERIAL);
+  }
+  if (tex)
+    glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState (GL_NORMAL_ARRAY);
+  glDisableClientState (GL_VERTEX_ARRAY);
+}
+
+
+void
+gridsurf_free (gridsurf_strips *gs)
+{
+  if (gs->indices) free (gs->indices);
+  if (gs->batches) free (gs->batches);
+  memset (gs, 0, sizeof(*gs));
+}
@@ -0,0 +1,75 @@
+/* gridsurf.h --- fixed-function drawing of parametric surface grids.
+ * xscreensaver, Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ *
+ * The surface hacks (klein, projectiveplane, hypertorus, romanboy,
+ * etruscanvenus) evaluate their surface on a grid of (rows+1)*(cols+1)
+ * vertices, where vertex (row,col) is at index row*(cols+1)+col, and used
+ * to draw it with one glBegin(GL_TRIANGLE_STRIP) per row.  These draw the
+ * same strips with a single glDrawElements call instead.
+ */
+
+#ifndef __GRIDSURF_H__
+#define __GRIDSURF_H__
+
+/* Which strips of the grid to draw, and how. */
+typedef struct {
+  int rows, cols;
+  Bool columns_p;	/* strips of constant column, instead of row */
+  int band_period;	/* if nonzero, skip strip s when */
+  int band_lo, band_hi;	/*   band_lo <= s % band_period < band_hi */
+  Bool wireframe_p;	/* quad outlines instead of triangles */
+} gridsurf_layout;
+
+/* GLES 1 only takes GL_UNSIGNED_INT indices with OES_element_index_uint. */
+#ifdef HAVE_JWZGLES
+typedef GLushort gridsurf_index;
+#else
+typedef GLuint gridsurf_index;
+#endif
+
+/* A run of indices that all lie within reach of the same first vertex. */
+typedef struct {
+  int base, first, count;
+} gridsurf_batch;
+
+/* The index list for a layout, rebuilt only when the layout changes.
+   Zero it before first use. */
+typedef struct {
+  gridsurf_layout layout;
+  gridsurf_index *indices;
+  int count, size;
+  gridsurf_batch *batches;
+  int nbatches, batches_size;
+} gridsurf_strips;
+
+/* Rotates the n 4D points x, and their partial derivatives xu and xv, by
+   mat; translates them by offset4d; projects them to 3D, either
+   perspectively from the origin or orthographically scaled by ortho_scale;
+   and translates them by offset3d.  Writes the 3D points to pp and the
+   unit normals of the projected surface to pn. */
+extern void gridsurf_project_4d (int n, float (*x)[4],
+                                 float (*xu)[4], float (*xv)[4],
+                                 float mat[4][4],
+                                 const float offset4d[4],
+                                 Bool perspective_p, float ortho_scale,
+                                 const float offset3d[3],
+                                 float (*pp)[3], float (*pn)[3]);
+
+/* Draws the grid with 3 floats per vertex in pp and pn, 2 in tex and 4 in
+   col.  tex and col may be 0.  If col is given, it sets both the current
+   color and the front and back ambient and diffuse material. */
+extern void gridsurf_draw (gridsurf_strips *, const gridsurf_layout *,
+                           const GLfloat *pp, const GLfloat *pn,
+                           const GLfloat *tex, const GLfloat *col);
+
+extern void gridsurf_free (gridsurf_strips *);
+
+#endif /* __GRIDSURF_H__ */
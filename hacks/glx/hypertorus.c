@@ -131,6 +131,7 @@ static const char sccsid[] = "@(#)hypertorus.c  1.2 05/09/28 xlockmore";
 
 #include "glsl-utils.h"
 #include "gltrackball.h"
+#include "gridsurf.h"
 
 
 #ifdef USE_MODULES
@@ -240,6 +241,15 @@ typedef struct {
   int current_trackball;
   Bool button_pressed;
   float speed_scale;
+  /* The 4d points, derivatives, projections, and colors of the
+     fixed-function path */
+  float x[(NUMU+1)*(NUMV+1)][4];
+  float xu[(NUMU+1)*(NUMV+1)][4];
+  float xv[(NUMU+1)*(NUMV+1)][4];
+  float pp[(NUMU+1)*(NUMV+1)][3];
+  float pn[(NUMU+1)*(NUMV+1)][3];
+  float ffcol[(NUMU+1)*(NUMV+1)][4];
+  gridsurf_strips strips;
 #ifdef HAVE_GLSL
   GLfloat uv[(NUMU+1)*(NUMV+1)][2];
   GLfloat col[(NUMU+1)*(NUMV+1)][4];
@@ -758,12 +768,11 @@ static int hypertorus_ff(ModeInfo *mi, double umin, double umax, double vmin,
   static const GLfloat mat_diff_trans_green[]   = { 0.0, 1.0, 0.0, 0.7 };
   static const GLfloat mat_diff_trans_oneside[] = { 0.9, 0.4, 0.3, 0.7 };
   float mat_diff_dyn[4], mat_diff_dyn_compl[4];
-  float p[3], pu[3], pv[3], n[3], mat[4][4], matc[3][3], col[4];
-  int i, j, k, l, m, b, skew;
+  float mat[4][4], matc[3][3];
+  int l, m, o, b, skew;
   double u, v, ur, vr;
   double cu, su, cv, sv;
-  double xx[4], xxu[4], xxv[4], x[4], xu[4], xv[4];
-  double r, s, t;
+  gridsurf_layout layout;
   float q1[4], q2[4], r1[4][4], r2[4][4];
   hypertorusstruct *hp = &hyper[MI_SCREEN(mi)];
   int polys;
@@ -902,103 +911,58 @@ static int hypertorus_ff(ModeInfo *mi, double umin, double umax, double vmin,
   skew = num_spirals;
   ur = umax-umin;
   vr = vmax-vmin;
-  for (i=0; i<numu; i++)
+  for (l=0; l<=numu; l++)
   {
-    if ((appearance == APPEARANCE_BANDS ||
-         appearance == APPEARANCE_SPIRALS) && ((i & 3) >= 2))
-      continue;
-    if (display_mode == DISP_WIREFRAME)
-      glBegin(GL_QUAD_STRIP);
-    else
-      glBegin(GL_TRIANGLE_STRIP);
-    for (j=0; j<=numv; j++)
+    for (m=0; m<=numv; m++)
     {
-      for (k=0; k<=1; k++)
+      o = l*(numv+1)+m;
+      u = ur*l/numu+umin;
+      v = vr*m/numv+vmin;
+      if (appearance == APPEARANCE_SPIRALS)
       {
-        l = i+k;
-        m = j;
-        u = ur*l/numu+umin;
-        v = vr*m/numv+vmin;
-        if (appearance == APPEARANCE_SPIRALS)
-        {
-          u += 4.0*skew/numv*v;
-          b = ((i/4)&(skew-1))*(numu/(4*skew));
-          color(ur*4*b/numu+umin,matc,col);
-        }
-        else
-        {
-          color(u,matc,col);
-        }
+        u += 4.0*skew/numv*v;
+        b = ((l/4)&(skew-1))*(numu/(4*skew));
         if (colors == COLORS_COLORWHEEL)
-        {
-          glColor3fv(col);
-          glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,col);
-        }
-        cu = cos(u);
-        su = sin(u);
-        cv = cos(v);
-        sv = sin(v);
-        xx[0] = cu;
-        xx[1] = su;
-        xx[2] = cv;
-        xx[3] = sv;
-        xxu[0] = -su;
-        xxu[1] = cu;
-        xxu[2] = 0.0;
-        xxu[3] = 0.0;
-        xxv[0] = 0.0;
-        xxv[1] = 0.0;
-        xxv[2] = -sv;
-        xxv[3] = cv;
-        for (l=0; l<4; l++)
-        {
-          r = 0.0;
-          s = 0.0;
-          t = 0.0;
-          for (m=0; m<4; m++)
-          {
-            r += mat[l][m]*xx[m];
-            s += mat[l][m]*xxu[m];
-            t += mat[l][m]*xxv[m];
-          }
-          x[l] = r;
-          xu[l] = s;
-          xv[l] = t;
-        }
-        if (projection_4d == DISP_4D_ORTHOGRAPHIC)
-        {
-          for (l=0; l<3; l++)
-          {
-            p[l] = (x[l]+offset4d[l])/1.5+offset3d[l];
-            pu[l] = xu[l];
-            pv[l] = xv[l];
-          }
-        }
-        else
-        {
-          s = x[3]+offset4d[3];
-          t = s*s;
-          for (l=0; l<3; l++)
-          {
-            r = x[l]+offset4d[l];
-            p[l] = r/s+offset3d[l];
-            pu[l] = (xu[l]*s-r*xu[3])/t;
-            pv[l] = (xv[l]*s-r*xv[3])/t;
-          }
-        }
-        n[0] = pu[1]*pv[2]-pu[2]*pv[1];
-        n[1] = pu[2]*pv[0]-pu[0]*pv[2];
-        n[2] = pu[0]*pv[1]-pu[1]*pv[0];
-        t = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
-        n[0] /= t;
-        n[1] /= t;
-        n[2] /= t;
-        glNormal3fv(n);
-        glVertex3fv(p);
+          color(ur*4*b/numu+umin,matc,hp->ffcol[o]);
+      }
+      else if (colors == COLORS_COLORWHEEL)
+      {
+        color(u,matc,hp->ffcol[o]);
       }
+      cu = cos(u);
+      su = sin(u);
+      cv = cos(v);
+      sv = sin(v);
+      hp->x[o][0] = cu;
+      hp->x[o][1] = su;
+      hp->x[o][2] = cv;
+      hp->x[o][3] = sv;
+      hp->xu[o][0] = -su;
+      hp->xu[o][1] = cu;
+      hp->xu[o][2] = 0.0;
+      hp->xu[o][3] = 0.0;
+      hp->xv[o][0] = 0.0;
+      hp->xv[o][1] = 0.0;
+      hp->xv[o][2] = -sv;
+      hp->xv[o][3] = cv;
     }
-    glEnd();
   }
+  gridsurf_project_4d((numu+1)*(numv+1),hp->x,hp->xu,hp->xv,mat,offset4d,
+                      projection_4d == DISP_4D_PERSPECTIVE,1.0f/1.5f,
+                      offset3d,hp->pp,hp->pn);
+
+  /* In the spirals appearance, the strips that are drawn are the same as
+     in the bands appearance; only the vertices have moved. */
+  layout.rows = numu;
+  layout.cols = numv;
+  layout.columns_p = False;
+  layout.band_period = (appearance == APPEARANCE_BANDS ||
+                        appearance == APPEARANCE_SPIRALS) ? 4 : 0;
+  layout.band_lo = 2;
+  layout.band_hi = 4;
+  layout.wireframe_p = (display_mode == DISP_WIREFRAME);
+  gridsurf_draw(&hp->strips,&layout,hp->pp[0],hp->pn[0],NULL,
+                (colors == COLORS_COLORWHEEL) ? hp->ffcol[0] : NULL);
 
   polys = 2*numu*numv;
   if (appearance != APPEARANCE_SOLID)
@@ -1932,6 +1896,7 @@ ENTRYPOINT void free_hypertorus(ModeInfo *mi)
   glXMakeCurrent (MI_DISPLAY(mi), MI_WINDOW(mi), *hp->glx_context);
   gltrackball_free (hp->trackballs[0]);
   gltrackball_free (hp->trackballs[1]);
+  gridsurf_free (&hp->strips);
 #ifdef HAVE_GLSL
   if (hp->use_shaders)
   {
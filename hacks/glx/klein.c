@@ -180,6 +180,7 @@ static const char sccsid[] = "@(#)klein.c  1.1 04/10/08 xlockmore";
 
 #include "glsl-utils.h"
 #include "gltrackball.h"
+#include "gridsurf.h"
 
 
 #ifdef USE_MODULES
@@ -338,6 +339,8 @@ typedef struct {
   float tex[(NUMU+1)*(NUMV+1)][2];
   /* The "curlicue" texture */
   GLuint tex_name;
+  /* The triangles of the fixed-function path */
+  gridsurf_strips strips;
   /* Aspect ratio of the current window */
   float aspect;
   /* Trackball states */
@@ -1791,16 +1794,33 @@ static void set_opengl_state_pf(ModeInfo *mi, float mat[4][4],
 #endif /* HAVE_GLSL */
 
 
+/* Draw the projected points as rows strips of cols quads, with the
+   appearance and colors that are stored in the kleinstruct kb. */
+static void draw_ff(kleinstruct *kb, int rows, int cols)
+{
+  gridsurf_layout layout;
+
+  layout.rows = rows;
+  layout.cols = cols;
+  layout.columns_p = False;
+  layout.band_period = (kb->appearance == APPEARANCE_BANDS) ? NUMB : 0;
+  layout.band_lo = NUMB/2;
+  layout.band_hi = NUMB;
+  layout.wireframe_p = (kb->display_mode == DISP_WIREFRAME);
+  gridsurf_draw(&kb->strips,&layout,kb->pp[0],kb->pn[0],kb->tex[0],
+                (kb->colors != COLORS_ONESIDED &&
+                 kb->colors != COLORS_TWOSIDED) ? kb->col[0] : NULL);
+}
+
+
 /* Draw a figure-8 Klein bottle projected into 3D. */
 static int figure8_ff(ModeInfo *mi, double umin, double umax, double vmin,
                       double vmax)
 {
   int polys;
-  float pu[3], pv[3], mat[4][4], matc[3][3];
-  int i, j, k, l, m, o;
+  float mat[4][4], matc[3][3];
+  int l, m, o;
   double u, v, ur, vr;
-  double y[4], yu[4], yv[4];
-  double q, r, s, t;
   float q1[4], q2[4], r1[4][4], r2[4][4];
   kleinstruct *kb = &klein[MI_SCREEN(mi)];
 
@@ -1827,96 +1847,36 @@ static int figure8_ff(ModeInfo *mi, double umin, double umax, double vmin,
   }
 
   /* Project the points from 4D to 3D. */
-  for (i=0; i<=NUMU; i++)
-  {
-    for (j=0; j<=NUMV; j++)
-    {
-      o = i*(NUMV+1)+j;
-      for (l=0; l<4; l++)
-      {
-        y[l] = (mat[l][0]*kb->x[o][0]+mat[l][1]*kb->x[o][1]+
-                mat[l][2]*kb->x[o][2]+mat[l][3]*kb->x[o][3]);
-        yu[l] = (mat[l][0]*kb->xu[o][0]+mat[l][1]*kb->xu[o][1]+
-                 mat[l][2]*kb->xu[o][2]+mat[l][3]*kb->xu[o][3]);
-        yv[l] = (mat[l][0]*kb->xv[o][0]+mat[l][1]*kb->xv[o][1]+
-                 mat[l][2]*kb->xv[o][2]+mat[l][3]*kb->xv[o][3]);
-      }
-      if (kb->projection_4d == DISP_4D_ORTHOGRAPHIC)
-      {
-        for (l=0; l<3; l++)
-        {
-          kb->pp[o][l] = (y[l]+kb->offset4d[l])+kb->offset3d[l];
-          pu[l] = yu[l];
-          pv[l] = yv[l];
-        }
-      }
-      else
-      {
-        s = y[3]+kb->offset4d[3];
-        q = 1.0/s;
-        t = q*q;
-        for (l=0; l<3; l++)
-        {
-          r = y[l]+kb->offset4d[l];
-          kb->pp[o][l] = r*q+kb->offset3d[l];
-          pu[l] = (yu[l]*s-r*yu[3])*t;
-          pv[l] = (yv[l]*s-r*yv[3])*t;
-        }
-      }
-      kb->pn[o][0] = pu[1]*pv[2]-pu[2]*pv[1];
-      kb->pn[o][1] = pu[2]*pv[0]-pu[0]*pv[2];
-      kb->pn[o][2] = pu[0]*pv[1]-pu[1]*pv[0];
-      t = 1.0/sqrt(kb->pn[o][0]*kb->pn[o][0]+kb->pn[o][1]*kb->pn[o][1]+
-                   kb->pn[o][2]*kb->pn[o][2]);
-      kb->pn[o][0] *= t;
-      kb->pn[o][1] *= t;
-      kb->pn[o][2] *= t;
-    }
-  }
+  gridsurf_project_4d((NUMU+1)*(NUMV+1),kb->x,kb->xu,kb->xv,mat,kb->offset4d,
+                      kb->projection_4d == DISP_4D_PERSPECTIVE,1.0f,
+                      kb->offset3d,kb->pp,kb->pn);
 
-  ur = umax-umin;
-  vr = vmax-vmin;
-  for (i=0; i<NUMU; i++)
+  if (kb->change_colors &&
+      (kb->colors == COLORS_DEPTH || kb->colors == COLORS_RAINBOW))
   {
-    if (kb->appearance == APPEARANCE_BANDS && ((i & (NUMB-1)) >= NUMB/2))
-      continue;
-    if (kb->display_mode == DISP_WIREFRAME)
-      glBegin(GL_QUAD_STRIP);
-    else
-      glBegin(GL_TRIANGLE_STRIP);
-    for (j=0; j<=NUMV; j++)
+    ur = umax-umin;
+    vr = vmax-vmin;
+    for (l=0; l<=NUMU; l++)
     {
-      for (k=0; k<=1; k++)
+      for (m=0; m<=NUMV; m++)
       {
-        l = i+k;
-        m = j;
         o = l*(NUMV+1)+m;
-        glNormal3fv(kb->pn[o]);
-        glTexCoord2fv(kb->tex[o]);
-        if (kb->change_colors)
+        if (kb->colors == COLORS_DEPTH)
         {
-          if (kb->colors == COLORS_DEPTH)
-          {
-            u = -ur*m/NUMU+umin;
-            color(kb,(cos(u)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
-          }
-          else if (kb->colors == COLORS_RAINBOW)
-          {
-            v = vr*l/NUMV+vmin;
-            color(kb,v,matc,kb->col[o]);
-          }
+          u = -ur*m/NUMU+umin;
+          color(kb,(cos(u)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
         }
-        if (kb->colors != COLORS_ONESIDED && kb->colors != COLORS_TWOSIDED)
+        else
         {
-          glColor3fv(kb->col[o]);
-          glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,kb->col[o]);
+          v = vr*l/NUMV+vmin;
+          color(kb,v,matc,kb->col[o]);
         }
-        glVertex3fv(kb->pp[o]);
       }
     }
-    glEnd();
   }
 
+  draw_ff(kb,NUMU,NUMV);
+
   polys = 2*NUMU*NUMV;
   if (kb->appearance != APPEARANCE_SOLID)
     polys /= 2;
@@ -2154,11 +2114,9 @@ static int pinched_torus_ff(ModeInfo *mi, double umin, double umax,
                             double vmin, double vmax)
 {
   int polys;
-  float pu[3], pv[3], mat[4][4], matc[3][3];
-  int i, j, k, l, m, o;
+  float mat[4][4], matc[3][3];
+  int l, m, o;
   double u, v, ur, vr;
-  double y[4], yu[4], yv[4];
-  double q, r, s, t;
   float q1[4], q2[4], r1[4][4], r2[4][4];
   kleinstruct *kb = &klein[MI_SCREEN(mi)];
 
@@ -2185,96 +2143,36 @@ static int pinched_torus_ff(ModeInfo *mi, double umin, double umax,
   }
 
   /* Project the points from 4D to 3D. */
-  for (i=0; i<=NUMU; i++)
-  {
-    for (j=0; j<=NUMV; j++)
-    {
-      o = i*(NUMV+1)+j;
-      for (l=0; l<4; l++)
-      {
-        y[l] = (mat[l][0]*kb->x[o][0]+mat[l][1]*kb->x[o][1]+
-                mat[l][2]*kb->x[o][2]+mat[l][3]*kb->x[o][3]);
-        yu[l] = (mat[l][0]*kb->xu[o][0]+mat[l][1]*kb->xu[o][1]+
-                 mat[l][2]*kb->xu[o][2]+mat[l][3]*kb->xu[o][3]);
-        yv[l] = (mat[l][0]*kb->xv[o][0]+mat[l][1]*kb->xv[o][1]+
-                 mat[l][2]*kb->xv[o][2]+mat[l][3]*kb->xv[o][3]);
-      }
-      if (kb->projection_4d == DISP_4D_ORTHOGRAPHIC)
-      {
-        for (l=0; l<3; l++)
-        {
-          kb->pp[o][l] = (y[l]+kb->offset4d[l])+kb->offset3d[l];
-          pu[l] = yu[l];
-          pv[l] = yv[l];
-        }
-      }
-      else
-      {
-        s = y[3]+kb->offset4d[3];
-        q = 1.0/s;
-        t = q*q;
-        for (l=0; l<3; l++)
-        {
-          r = y[l]+kb->offset4d[l];
-          kb->pp[o][l] = r*q+kb->offset3d[l];
-          pu[l] = (yu[l]*s-r*yu[3])*t;
-          pv[l] = (yv[l]*s-r*yv[3])*t;
-        }
-      }
-      kb->pn[o][0] = pu[1]*pv[2]-pu[2]*pv[1];
-      kb->pn[o][1] = pu[2]*pv[0]-pu[0]*pv[2];
-      kb->pn[o][2] = pu[0]*pv[1]-pu[1]*pv[0];
-      t = 1.0/sqrt(kb->pn[o][0]*kb->pn[o][0]+kb->pn[o][1]*kb->pn[o][1]+
-                   kb->pn[o][2]*kb->pn[o][2]);
-      kb->pn[o][0] *= t;
-      kb->pn[o][1] *= t;
-      kb->pn[o][2] *= t;
-    }
-  }
+  gridsurf_project_4d((NUMU+1)*(NUMV+1),kb->x,kb->xu,kb->xv,mat,kb->offset4d,
+                      kb->projection_4d == DISP_4D_PERSPECTIVE,1.0f,
+                      kb->offset3d,kb->pp,kb->pn);
 
-  ur = umax-umin;
-  vr = vmax-vmin;
-  for (i=0; i<NUMU; i++)
+  if (kb->change_colors &&
+      (kb->colors == COLORS_DEPTH || kb->colors == COLORS_RAINBOW))
   {
-    if (kb->appearance == APPEARANCE_BANDS && ((i & (NUMB-1)) >= NUMB/2))
-      continue;
-    if (kb->display_mode == DISP_WIREFRAME)
-      glBegin(GL_QUAD_STRIP);
-    else
-      glBegin(GL_TRIANGLE_STRIP);
-    for (j=0; j<=NUMV; j++)
+    ur = umax-umin;
+    vr = vmax-vmin;
+    for (l=0; l<=NUMU; l++)
     {
-      for (k=0; k<=1; k++)
+      for (m=0; m<=NUMV; m++)
       {
-        l = i+k;
-        m = j;
         o = l*(NUMV+1)+m;
-        glNormal3fv(kb->pn[o]);
-        glTexCoord2fv(kb->tex[o]);
-        if (kb->change_colors)
+        v = vr*l/NUMV+vmin;
+        if (kb->colors == COLORS_DEPTH)
         {
-          v = vr*l/NUMV+vmin;
-          if (kb->colors == COLORS_DEPTH)
-          {
-            u = -ur*m/NUMU+umin;
-            color(kb,(sin(u)*sin(0.5*v)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
-          }
-          else if (kb->colors == COLORS_RAINBOW)
-          {
-            color(kb,v,matc,kb->col[o]);
-          }
+          u = -ur*m/NUMU+umin;
+          color(kb,(sin(u)*sin(0.5*v)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
         }
-        if (kb->colors != COLORS_ONESIDED && kb->colors != COLORS_TWOSIDED)
+        else
         {
-          glColor3fv(kb->col[o]);
-          glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,kb->col[o]);
+          color(kb,v,matc,kb->col[o]);
         }
-        glVertex3fv(kb->pp[o]);
       }
     }
-    glEnd();
   }
 
+  draw_ff(kb,NUMU,NUMV);
+
   polys = 2*NUMU*NUMV;
   if (kb->appearance != APPEARANCE_SOLID)
     polys /= 2;
@@ -2511,11 +2409,9 @@ static int lawson_ff(ModeInfo *mi, double umin, double umax, double vmin,
                      double vmax)
 {
   int polys;
-  float pu[3], pv[3], mat[4][4], matc[3][3];
-  int i, j, k, l, m, o;
+  float mat[4][4], matc[3][3];
+  int l, m, o;
   double u, v, ur, vr;
-  double y[4], yu[4], yv[4];
-  double q, r, s, t;
   float q1[4], q2[4], r1[4][4], r2[4][4];
   kleinstruct *kb = &klein[MI_SCREEN(mi)];
 
@@ -2542,96 +2438,36 @@ static int lawson_ff(ModeInfo *mi, double umin, double umax, double vmin,
   }
 
   /* Project the points from 4D to 3D. */
-  for (i=0; i<=NUMV; i++)
-  {
-    for (j=0; j<=NUMU; j++)
-    {
-      o = i*(NUMU+1)+j;
-      for (l=0; l<4; l++)
-      {
-        y[l] = (mat[l][0]*kb->x[o][0]+mat[l][1]*kb->x[o][1]+
-                mat[l][2]*kb->x[o][2]+mat[l][3]*kb->x[o][3]);
-        yu[l] = (mat[l][0]*kb->xu[o][0]+mat[l][1]*kb->xu[o][1]+
-                 mat[l][2]*kb->xu[o][2]+mat[l][3]*kb->xu[o][3]);
-        yv[l] = (mat[l][0]*kb->xv[o][0]+mat[l][1]*kb->xv[o][1]+
-                 mat[l][2]*kb->xv[o][2]+mat[l][3]*kb->xv[o][3]);
-      }
-      if (kb->projection_4d == DISP_4D_ORTHOGRAPHIC)
-      {
-        for (l=0; l<3; l++)
-        {
-          kb->pp[o][l] = (y[l]+kb->offset4d[l])+kb->offset3d[l];
-          pu[l] = yu[l];
-          pv[l] = yv[l];
-        }
-      }
-      else
-      {
-        s = y[3]+kb->offset4d[3];
-        q = 1.0/s;
-        t = q*q;
-        for (l=0; l<3; l++)
-        {
-          r = y[l]+kb->offset4d[l];
-          kb->pp[o][l] = r*q+kb->offset3d[l];
-          pu[l] = (yu[l]*s-r*yu[3])*t;
-          pv[l] = (yv[l]*s-r*yv[3])*t;
-        }
-      }
-      kb->pn[o][0] = pu[1]*pv[2]-pu[2]*pv[1];
-      kb->pn[o][1] = pu[2]*pv[0]-pu[0]*pv[2];
-      kb->pn[o][2] = pu[0]*pv[1]-pu[1]*pv[0];
-      t = 1.0/sqrt(kb->pn[o][0]*kb->pn[o][0]+kb->pn[o][1]*kb->pn[o][1]+
-                   kb->pn[o][2]*kb->pn[o][2]);
-      kb->pn[o][0] *= t;
-      kb->pn[o][1] *= t;
-      kb->pn[o][2] *= t;
-    }
-  }
+  gridsurf_project_4d((NUMU+1)*(NUMV+1),kb->x,kb->xu,kb->xv,mat,kb->offset4d,
+                      kb->projection_4d == DISP_4D_PERSPECTIVE,1.0f,
+                      kb->offset3d,kb->pp,kb->pn);
 
-  ur = umax-umin;
-  vr = vmax-vmin;
-  for (i=0; i<NUMV; i++)
+  if (kb->change_colors &&
+      (kb->colors == COLORS_DEPTH || kb->colors == COLORS_RAINBOW))
   {
-    if (kb->appearance == APPEARANCE_BANDS && ((i & (NUMB-1)) >= NUMB/2))
-      continue;
-    if (kb->display_mode == DISP_WIREFRAME)
-      glBegin(GL_QUAD_STRIP);
-    else
-      glBegin(GL_TRIANGLE_STRIP);
-    for (j=0; j<=NUMU; j++)
+    ur = umax-umin;
+    vr = vmax-vmin;
+    for (l=0; l<=NUMV; l++)
     {
-      for (k=0; k<=1; k++)
+      for (m=0; m<=NUMU; m++)
       {
-        l = i+k;
-        m = j;
         o = l*(NUMU+1)+m;
-        glNormal3fv(kb->pn[o]);
-        glTexCoord2fv(kb->tex[o]);
-        if (kb->change_colors)
+        v = vr*l/NUMV+vmin;
+        if (kb->colors == COLORS_DEPTH)
         {
-          v = vr*l/NUMV+vmin;
-          if (kb->colors == COLORS_DEPTH)
-          {
-            u = -ur*m/NUMU+umin;
-            color(kb,(sin(u)*cos(0.5*v)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
-          }
-          else if (kb->colors == COLORS_RAINBOW)
-          {
-            color(kb,v,matc,kb->col[o]);
-          }
+          u = -ur*m/NUMU+umin;
+          color(kb,(sin(u)*cos(0.5*v)+1.0)*M_PI*2.0/3.0,matc,kb->col[o]);
         }
-        if (kb->colors != COLORS_ONESIDED && kb->colors != COLORS_TWOSIDED)
+        else
         {
-          glColor3fv(kb->col[o]);
-          glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,kb->col[o]);
+          color(kb,v,matc,kb->col[o]);
         }
-        glVertex3fv(kb->pp[o]);
       }
     }
-    glEnd();
   }
 
+  draw_ff(kb,NUMV,NUMU);
+
   polys = 2*NUMU*NUMV;
   if (kb->appearance != APPEARANCE_SOLID)
     polys /= 2;
@@ -3549,6 +3385,7 @@ ENTRYPOINT void free_klein(ModeInfo *mi)
   gltrackball_free (kb->trackballs[0]);
   gltrackball_free (kb->trackballs[1]);
   if (kb->tex_name) glDeleteTextures (1, &kb->tex_name);
+  gridsurf_free (&kb->strips);
 #ifdef HAVE_GLSL
   if (kb->use_shaders)
   {
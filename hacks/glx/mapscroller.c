@@ -67,6 +67,8 @@
 #define TILE_PIXEL_SIZE 256
 #define MIN_LEVEL 5
 #define MAX_LEVEL 18  /* Some servers go to 19, but not all */
+#define PREFETCH_DEPTH 2   /* Request tiles this far past the grid, ahead */
+#define PREFETCH_MAX   64  /* Outstanding prefetch requests */
 
 typedef struct { double lat, lon; } LL;
 typedef struct { double x, y; } XY;
@@ -84,9 +86,29 @@ typedef struct {
   enum { BLANK, LOADING, OK, FAILED, RETRY } status;
   int retries;
   GLuint texid;   /* Non-zero if we have the texture image data */
+  int slot;       /* Where texid lives in texcache */
   GLfloat opacity;
 } tile;
 
+typedef struct {
+  XYi map;
+  int map_level;
+} tile_key;
+
+/* Every tile image that we have loaded, including those that have scrolled
+   off the grid or that were prefetched before reaching it, so that they can
+   come back without another trip through the loader.  When it is full, the
+   least recently used texture that is not on the grid is overwritten in
+   place, so texture names are only allocated once per slot.
+ */
+typedef struct {
+  tile_key key;   /* map_level is 0 if the slot is empty */
+  GLuint texid;
+  int width, height;
+  Bool failed_p;  /* The server didn't have it, so don't ask again */
+  unsigned long used;  /* Value of 'frame' when last on the grid */
+} tile_texture;
+
 typedef struct {
   GLXContext *glx_context;
   char *url_template;
@@ -99,6 +121,11 @@ typedef struct {
   double heading_ratio;
   int grid_w, grid_h;
   tile *tiles;
+  tile_texture *texcache;
+  int texcache_size;
+  unsigned long frame;
+  tile_key prefetch[PREFETCH_MAX];  /* Requested, but not yet on the grid */
+  int prefetch_count;
   texture_font_data *font_data;
   XImage *oceans;
   Bool ocean_p;
@@ -269,11 +296,199 @@ free_tiles (ModeInfo *mi)
 {
   map_configuration *bp = &bps[MI_SCREEN(mi)];
   int i;
-  for (i = 0; i < bp->grid_w * bp->grid_h; i++)
-    if (bp->tiles[i].texid)
-      glDeleteTextures (1, &bp->tiles[i].texid);
   free (bp->tiles);
   bp->tiles = 0;
+  for (i = 0; i < bp->texcache_size; i++)
+    if (bp->texcache[i].texid)
+      glDeleteTextures (1, &bp->texcache[i].texid);
+  free (bp->texcache);
+  bp->texcache = 0;
+  bp->texcache_size = 0;
+}
+
+
+static int
+find_texture (map_configuration *bp, long x, long y, int z)
+{
+  int i;
+  for (i = 0; i < bp->texcache_size; i++)
+    {
+      tile_texture *tt = &bp->texcache[i];
+      if (tt->key.map.x == x &&
+          tt->key.map.y == y &&
+          tt->key.map_level == z)
+        return i;
+    }
+  return -1;
+}
+
+
+/* Stores a tile's image in the texture cache, or notes that it has none.
+   Returns the slot, or -1 if every slot is in use on the grid.
+ */
+static int
+load_texture (ModeInfo *mi, long x, long y, int z, XImage *image,
+              const char *file)
+{
+  map_configuration *bp = &bps[MI_SCREEN(mi)];
+  int slot = find_texture (bp, x, y, z);
+  tile_texture *tt;
+
+  if (slot < 0)   /* Take an empty slot, or else the least recently used. */
+    {
+      int i;
+      for (i = 0; i < bp->texcache_size; i++)
+        {
+          tile_texture *tt2 = &bp->texcache[i];
+          if (tt2->key.map_level == 0)
+            {
+              slot = i;
+              break;
+            }
+          if (tt2->used != bp->frame &&
+              (slot < 0 || tt2->used < bp->texcache[slot].used))
+            slot = i;
+        }
+      if (slot < 0)
+        return -1;
+    }
+
+  tt = &bp->texcache[slot];
+  if (verbose_p > 2 && tt->key.map_level &&
+      (tt->key.map.x != x || tt->key.map.y != y || tt->key.map_level != z))
+    fprintf (stderr, "%s: evicting tile %ld %ld %d\n", blurb(mi),
+             tt->key.map.x, tt->key.map.y, tt->key.map_level);
+  tt->key.map.x = x;
+  tt->key.map.y = y;
+  tt->key.map_level = z;
+  tt->used = bp->frame;
+  tt->failed_p = !image;
+
+  if (image)
+    {
+      char buf[1024];
+      if (!tt->texid)
+        glGenTextures (1, &tt->texid);
+      if (!tt->texid) abort();
+      glBindTexture (GL_TEXTURE_2D, tt->texid);
+
+      clear_gl_error();
+      glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+      glPixelStorei (GL_UNPACK_ROW_LENGTH, image->width);
+      if (tt->width == image->width && tt->height == image->height)
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0,
+                         image->width, image->height,
+                         GL_RGBA, GL_UNSIGNED_BYTE, image->data);
+      else
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
+                      image->width, image->height, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, image->data);
+      tt->width  = image->width;
+      tt->height = image->height;
+      sprintf (buf, "texture %d: %.100s (%dx%d)", tt->texid,
+               file, image->width, image->height);
+      check_gl_error (buf);
+      if (verbose_p > 3)
+        fprintf (stderr, "%s: %s\n", blurb(mi), buf);
+    }
+
+  return slot;
+}
+
+
+static int
+find_prefetched (map_configuration *bp, long x, long y, int z)
+{
+  int i;
+  for (i = 0; i < bp->prefetch_count; i++)
+    {
+      tile_key *k = &bp->prefetch[i];
+      if (k->map.x == x && k->map.y == y && k->map_level == z)
+        return i;
+    }
+  return -1;
+}
+
+
+/* Returns whether this tile had been prefetched, and forgets it.
+ */
+static Bool
+take_prefetched (map_configuration *bp, long x, long y, int z)
+{
+  int i = find_prefetched (bp, x, y, z);
+  if (i < 0) return False;
+  bp->prefetch[i] = bp->prefetch[--bp->prefetch_count];
+  return True;
+}
+
+
+static void
+request_tile (ModeInfo *mi, long x, long y, int z)
+{
+  map_configuration *bp = &bps[MI_SCREEN(mi)];
+  int L;
+  char buf[1024];
+  sprintf (buf, "%ld %ld %d\n", x, y, z);
+  L = strlen (buf);
+  if (L != write (bp->pipe_out, buf, L))
+    {
+      sprintf (buf, "%.100s: write", blurb(mi));
+      perror (buf);
+      exit (1);
+    }
+}
+
+
+/* Request the tiles that will scroll onto the grid next, given our heading,
+   so that they are loaded by the time they get there.
+ */
+static void
+prefetch_tiles (ModeInfo *mi, XYi topleft_tile)
+{
+  map_configuration *bp = &bps[MI_SCREEN(mi)];
+  long map_w = exp2 (bp->map_level);
+  long map_h = map_w;
+  double dx = bp->heading[2].x;
+  double dy = bp->heading[2].y;
+  double d = sqrt (dx*dx + dy*dy);
+  XYi off;
+  int x, y;
+
+  if (d <= 0) return;
+  off.x = floor ( dx / d * PREFETCH_DEPTH + 0.5);
+  off.y = floor (-dy / d * PREFETCH_DEPTH + 0.5);  /* Tile Y goes south */
+
+  for (y = 0; y < bp->grid_h; y++)
+    for (x = 0; x < bp->grid_w; x++)
+      {
+        XYi g, m;
+        g.x = x + off.x;
+        g.y = y + off.y;
+        if (g.x >= 0 && g.x < bp->grid_w &&
+            g.y >= 0 && g.y < bp->grid_h)
+          continue;   /* Already on the grid */
+
+        m.x = topleft_tile.x + g.x;
+        m.y = topleft_tile.y + g.y;
+        while (m.x < 0) m.x += map_w;
+        while (m.y < 0) m.y += map_h;
+        while (m.x >= map_w) m.x -= map_w;
+        while (m.y >= map_h) m.y -= map_h;
+
+        if (find_texture   (bp, m.x, m.y, bp->map_level) >= 0 ||
+            find_prefetched (bp, m.x, m.y, bp->map_level) >= 0)
+          continue;
+        if (bp->prefetch_count >= PREFETCH_MAX)
+          return;
+
+        bp->prefetch[bp->prefetch_count].map = m;
+        bp->prefetch[bp->prefetch_count].map_level = bp->map_level;
+        bp->prefetch_count++;
+        request_tile (mi, m.x, m.y, bp->map_level);
+        if (verbose_p > 1)
+          fprintf (stderr, "%s: prefetching tile %ld %ld %d\n",
+                   blurb(mi), m.x, m.y, bp->map_level);
+      }
 }
 
 
@@ -322,6 +537,22 @@ reshape_tiles (ModeInfo *mi)
   bp->grid_w = w2;
   bp->grid_h = h2;
   bp->tiles = (tile *) calloc (w2 * (h2 + 1), sizeof (*bp->tiles));
+  bp->frame++;
+
+  /* Room for the grid, the prefetched tiles, and some that have scrolled
+     off, in case we turn around. */
+  {
+    int n = w2 * h2 * 3 / 2 + PREFETCH_MAX;
+    if (n > bp->texcache_size)
+      {
+        bp->texcache = (tile_texture *)
+          realloc (bp->texcache, n * sizeof(*bp->texcache));
+        if (! bp->texcache) abort();
+        memset (bp->texcache + bp->texcache_size, 0,
+                (n - bp->texcache_size) * sizeof(*bp->texcache));
+        bp->texcache_size = n;
+      }
+  }
 
   /* Generate blank tiles for our current grid. */
   for (y = 0; y < h2; y++)
@@ -375,8 +606,21 @@ reshape_tiles (ModeInfo *mi)
     for (i = 0; i < w2 * h2; i++)
       {
         tile *t = &bp->tiles[i];
-        if (t->status == BLANK ||
-            (t->status == RETRY && t->retries < 3))
+        int slot = (t->status == BLANK
+                    ? find_texture (bp, t->map.x, t->map.y, t->map_level)
+                    : -1);
+        if (slot >= 0)   /* We've been here before */
+          {
+            tile_texture *tt = &bp->texcache[slot];
+            t->status = (tt->failed_p ? FAILED : OK);
+            t->texid  = (tt->failed_p ? 0 : tt->texid);
+            t->slot   = slot;
+          }
+        else if (t->status == BLANK &&
+                 take_prefetched (bp, t->map.x, t->map.y, t->map_level))
+          t->status = LOADING;   /* Already asked for it */
+        else if (t->status == BLANK ||
+                 (t->status == RETRY && t->retries < 3))
           {
             queue[count++] = t;
             if (t->status == RETRY)
@@ -400,27 +644,22 @@ reshape_tiles (ModeInfo *mi)
     for (i = 0; i < count; i++)
       {
         tile *t = queue[i];
-        int L;
-        char buf[1024];
         t->status = LOADING;
-        sprintf (buf, "%ld %ld %d\n", t->map.x, t->map.y, t->map_level);
-        L = strlen (buf);
-        if (L != write (bp->pipe_out, buf, L))
-          {
-            sprintf (buf, "%.100s: write", blurb(mi));
-            perror (buf);
-            exit (1);
-          }
+        request_tile (mi, t->map.x, t->map.y, t->map_level);
         if (verbose_p > 1)
-         fprintf (stderr, "%s: requesting tile %s", blurb(mi), buf);
+         fprintf (stderr, "%s: requesting tile %ld %ld %d\n", blurb(mi),
+                  t->map.x, t->map.y, t->map_level);
       }
     free (queue);
+
+    prefetch_tiles (mi, topleft_tile);
   }
 
-  /* Free textures of any now-unused tiles. */
-  for (i = 0; i < ow * oh; i++)
-    if (otiles[i].texid)
-      glDeleteTextures (1, &otiles[i].texid);
+  /* The textures of tiles that have left the grid stay in texcache, but
+     those still on it must not be reused. */
+  for (i = 0; i < w2 * h2; i++)
+    if (bp->tiles[i].texid)
+      bp->texcache[bp->tiles[i].slot].used = bp->frame;
 
   free (otiles);
 }
@@ -790,13 +1029,15 @@ read_loader (ModeInfo *mi)
     }
 
   /* Line looks like "x y z \t FILE"
-     Find the tile it corresponds to and texturize it. */
+     Find the tiles it corresponds to and texturize them. */
   {
-    int i;
+    int i, slot = -1;
     long x, y, z;
     char *coords, *file;
     char *s = strchr (buf, '\t');
     Bool matched_p = False;
+    Bool prefetched_p;
+    int status;
     if (!s) abort();
     coords = buf;
     *s = 0;
@@ -805,6 +1046,7 @@ read_loader (ModeInfo *mi)
       abort();
 
     bp->tile_count++;
+    prefetched_p = take_prefetched (bp, x, y, z);
 
     for (i = 0; i < bp->grid_w * bp->grid_h; i++)
       {
@@ -813,77 +1055,88 @@ read_loader (ModeInfo *mi)
             t->map.y == y &&
             t->map_level == z &&
             !t->texid)
-          {
-            char buf2[1024];
-            XImage *image;
-            struct stat st;
-            matched_p = True;
-
-            if (strlen(file) == 3)   /* HTTP error code */
-              {
-                /* 504 timeout error code: retry; all others: don't.
-                   The perl script returns 504 if and only if it did not
-                   get a response. All other codes are from the server.
-                 */
-                t->status = (!strcmp (file, "504") ? RETRY : FAILED);
-                if (verbose_p)
-                  fprintf (stderr, "%s: error %s: tile: %s pos: %.4f, %.4f\n",
-                           blurb(mi), file, buf,
-                           tiley2lat (y, z), tilex2lon (x, z));
-                break;
-              }
+          matched_p = True;
+      }
 
-            if (stat (file, &st))
-              {
-                /* This can happen if mapscroller.pl has a file cached but
-                   the cache was cleared by another copy running on another
-                   screen. */
-                if (verbose_p)
-                  fprintf (stderr, "%s: file does not exist: %s\n",
-                           blurb(mi), file);
-                t->status = RETRY;
-                break;
-              }
+    if (!matched_p && !prefetched_p)
+      {
+        if (verbose_p > 2)
+          fprintf (stderr, "%s: got unmatched tile %ld %ld %ld\n", blurb(mi),
+                   x, y, z);
+        return;
+      }
 
-            image = file_to_ximage (MI_DISPLAY(mi), MI_VISUAL(mi), file);
-            if (!image)
-              {
-                if (verbose_p)
-                  fprintf (stderr, "%s: file unloadable: %s\n",
-                           blurb(mi), file);
-                t->status = RETRY;
-                break;
-              }
+    if (strlen(file) == 3)   /* HTTP error code */
+      {
+        /* 504 timeout error code: retry; all others: don't.
+           The perl script returns 504 if and only if it did not
+           get a response. All other codes are from the server.
+         */
+        status = (!strcmp (file, "504") ? RETRY : FAILED);
+        if (verbose_p)
+          fprintf (stderr, "%s: error %s: tile: %s pos: %.4f, %.4f\n",
+                   blurb(mi), file, buf,
+                   tiley2lat (y, z), tilex2lon (x, z));
+        if (status == FAILED)
+          slot = load_texture (mi, x, y, z, 0, file);
+      }
+    else
+      {
+        struct stat st;
+        XImage *image;
 
-            t->status = OK;
-            if (t->texid) abort();
-            glGenTextures (1, &t->texid);
-            if (!t->texid) abort();
-            glBindTexture (GL_TEXTURE_2D, t->texid);
-
-            clear_gl_error();
-            glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
-            glPixelStorei (GL_UNPACK_ROW_LENGTH, image->width);
-            glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
-                          image->width, image->height, 0,
-                          GL_RGBA, GL_UNSIGNED_BYTE, image->data);
-            sprintf (buf2, "texture %d: %.100s (%dx%d)", t->texid,
-                     file, image->width, image->height);
-            check_gl_error (buf2);
+        if (stat (file, &st))
+          {
+            /* This can happen if mapscroller.pl has a file cached but
+               the cache was cleared by another copy running on another
+               screen. */
+            if (verbose_p)
+              fprintf (stderr, "%s: file does not exist: %s\n",
+                       blurb(mi), file);
+            status = RETRY;
+          }
+        else if (! (image = file_to_ximage (MI_DISPLAY(mi), MI_VISUAL(mi),
+                                            file)))
+          {
+            if (verbose_p)
+              fprintf (stderr, "%s: file unloadable: %s\n",
+                       blurb(mi), file);
+            status = RETRY;
+            /* Don't prefetch it again. */
+            if (! matched_p)
+              load_texture (mi, x, y, z, 0, file);
+          }
+        else
+          {
+            slot = load_texture (mi, x, y, z, image, file);
+            status = (slot < 0 ? RETRY : OK);
             XDestroyImage (image);
-            if (verbose_p > 3)
-              fprintf (stderr, "%s: %s\n", blurb(mi), buf2);
-            else if (verbose_p > 1)
-              fprintf (stderr, "%s: got tile %ld %ld %ld\n", blurb(mi),
-                       x, y, z);
+            if (verbose_p > 1)
+              fprintf (stderr, "%s: got %stile %ld %ld %ld\n", blurb(mi),
+                       (matched_p ? "" : "prefetched "), x, y, z);
           }
       }
 
-    if (verbose_p > 2 && !matched_p)
-      fprintf (stderr, "%s: got unmatched tile %ld %ld %ld\n", blurb(mi),
-               x, y, z);
-
-
+    for (i = 0; i < bp->grid_w * bp->grid_h; i++)
+      {
+        tile *t = &bp->tiles[i];
+        if (t->map.x == x &&
+            t->map.y == y &&
+            t->map_level == z &&
+            !t->texid)
+          {
+            t->status = status;
+            if (slot >= 0)
+              {
+                t->slot = slot;
+                if (status == OK)
+                  {
+                    t->texid = bp->texcache[slot].texid;
+                    bp->texcache[slot].used = bp->frame;
+                  }
+              }
+          }
+      }
   }
 }
 
@@ -29,7 +29,7 @@ BEGIN { eval 'use LWP::Simple' }
 
 my $progname = $0; $progname =~ s@.*/@@g;
 $progname =~ s@\.pl$@@g;
-my ($version) = ('$Revision: 1.10 $' =~ m/\s(\d[.\d]+)\s/s);
+my ($version) = ('$Revision: 1.11 $' =~ m/\s(\d[.\d]+)\s/s);
 
 my $verbose = 0;
 my $url_template = undef;
@@ -229,6 +229,16 @@ sub load_tile($$$$) {
 
   my $timeout = 30;
 
+  # A directory of tiles standing in for a tile server, for testing offline.
+  # No need to cache those.
+  #
+  if ($url_template =~ m@^file:@si) {
+    my $file = apply_template ($x, $y, $z);
+    $file =~ s@^file:(//)?@@si;
+    print STDERR blurb() . "local: $file\n" if ($verbose > 1);
+    return (-f $file ? $file : '404');
+  }
+
   # Sanitize the template into a directory name
   my $site = lc($url_template);
   $site =~ s/[?#].*$//s;
@@ -413,11 +423,14 @@ sub clean_cache() {
 
 
 sub mapscroller() {
-  init_lwp();
-  my $ua = $LWP::Simple::ua;
-  my $name = "xscreensaver-$progname";
-  $name =~ s/\.pl$//s;
-  $ua->agent ("$name/$version");
+  my $ua = undef;
+  if (! ($url_template =~ m@^file:@si)) {
+    init_lwp();
+    $ua = $LWP::Simple::ua;
+    my $name = "xscreensaver-$progname";
+    $name =~ s/\.pl$//s;
+    $ua->agent ("$name/$version");
+  }
 
   my $scanned_p = 0;
   my $last_cleaned = time();
@@ -467,6 +480,7 @@ sub usage() {
     "\n" .
     "This is a helper program for the 'mapscroller' screen saver.\n" .
     "Reads \"X Y Z\" on stdin and writes cached tile filenames to stdout.\n" .
+    "A file: URL template reads the tiles from a local directory.\n" .
     "\n";
   exit 1;
 }
@@ -488,7 +502,7 @@ sub main() {
     else { usage; }
   }
 
-  usage unless (($url_template || '') =~ m@^https?://@s);
+  usage unless (($url_template || '') =~ m@^(https?|file):@s);
 
   my $s = $cache_size;
   if    ($s =~ s@\s*KB?$@@si) { $s = $s * 1024; }
@@ -249,6 +249,7 @@ static const char sccsid[] = "@(#)projectiveplane.c  1.1 14/01/03 xlockmore";
 
 #include "glsl-utils.h"
 #include "gltrackball.h"
+#include "gridsurf.h"
 
 #include <float.h>
 
@@ -404,6 +405,8 @@ typedef struct {
   float tex[(NUMU+1)*(NUMV+1)][2];
   /* The "curlicue" texture */
   GLuint tex_name;
+  /* The triangles of the fixed-function path */
+  gridsurf_strips strips;
   /* Aspect ratio of the current window */
   float aspect;
   /* Trackball states */
@@ -1194,11 +1197,10 @@ static int projective_plane_ff(ModeInfo *mi, double umin, double umax,
   static const GLfloat mat_diff_trans_green[]   = { 0.0, 1.0, 0.0, 0.7 };
   static const GLfloat mat_diff_trans_oneside[] = { 0.9, 0.4, 0.3, 0.7 };
   float mat_diff_dyn[4], mat_diff_dyn_compl[4];
-  float pu[3], pv[3], mat[4][4], matc[3][3];
-  int i, j, k, l, m, o;
+  float mat[4][4], matc[3][3];
+  int l, m, o;
   double u, v, ur, vr;
-  double y[4], yu[4], yv[4];
-  double q, r, s, t;
+  gridsurf_layout layout;
   float q1[4], q2[4], r1[4][4], r2[4][4];
   projectiveplanestruct *pp = &projectiveplane[MI_SCREEN(mi)];
   int polys;
@@ -1309,52 +1311,9 @@ static int projective_plane_ff(ModeInfo *mi, double umin, double umax,
   }
 
   /* Project the points from 4D to 3D. */
-  for (i=0; i<=NUMV; i++)
-  {
-    for (j=0; j<=NUMU; j++)
-    {
-      o = i*(NUMU+1)+j;
-      for (l=0; l<4; l++)
-      {
-        y[l] = (mat[l][0]*pp->x[o][0]+mat[l][1]*pp->x[o][1]+
-                mat[l][2]*pp->x[o][2]+mat[l][3]*pp->x[o][3]);
-        yu[l] = (mat[l][0]*pp->xu[o][0]+mat[l][1]*pp->xu[o][1]+
-                 mat[l][2]*pp->xu[o][2]+mat[l][3]*pp->xu[o][3]);
-        yv[l] = (mat[l][0]*pp->xv[o][0]+mat[l][1]*pp->xv[o][1]+
-                 mat[l][2]*pp->xv[o][2]+mat[l][3]*pp->xv[o][3]);
-      }
-      if (pp->projection_4d == DISP_4D_ORTHOGRAPHIC)
-      {
-        for (l=0; l<3; l++)
-        {
-          pp->pp[o][l] = (y[l]+pp->offset4d[l])+pp->offset3d[l];
-          pu[l] = yu[l];
-          pv[l] = yv[l];
-        }
-      }
-      else
-      {
-        s = y[3]+pp->offset4d[3];
-        q = 1.0/s;
-        t = q*q;
-        for (l=0; l<3; l++)
-        {
-          r = y[l]+pp->offset4d[l];
-          pp->pp[o][l] = r*q+pp->offset3d[l];
-          pu[l] = (yu[l]*s-r*yu[3])*t;
-          pv[l] = (yv[l]*s-r*yv[3])*t;
-        }
-      }
-      pp->pn[o][0] = pu[1]*pv[2]-pu[2]*pv[1];
-      pp->pn[o][1] = pu[2]*pv[0]-pu[0]*pv[2];
-      pp->pn[o][2] = pu[0]*pv[1]-pu[1]*pv[0];
-      t = 1.0/sqrt(pp->pn[o][0]*pp->pn[o][0]+pp->pn[o][1]*pp->pn[o][1]+
-                   pp->pn[o][2]*pp->pn[o][2]);
-      pp->pn[o][0] *= t;
-      pp->pn[o][1] *= t;
-      pp->pn[o][2] *= t;
-    }
-  }
+  gridsurf_project_4d((NUMU+1)*(NUMV+1),pp->x,pp->xu,pp->xv,mat,pp->offset4d,
+                      pp->projection_4d == DISP_4D_PERSPECTIVE,1.0f,
+                      pp->offset3d,pp->pp,pp->pn);
 
   if (!pp->change_colors)
   {
@@ -1408,103 +1367,59 @@ static int projective_plane_ff(ModeInfo *mi, double umin, double umax,
   }
   glBindTexture(GL_TEXTURE_2D,pp->tex_name);
 
-  ur = umax-umin;
-  vr = vmax-vmin;
-  if (pp->appearance != APPEARANCE_DIRECTION_BANDS)
+  if (pp->change_colors &&
+      (pp->colors == COLORS_DEPTH || pp->colors == COLORS_DIRECTION ||
+       pp->colors == COLORS_DISTANCE))
   {
-    for (i=0; i<NUMV; i++)
+    ur = umax-umin;
+    vr = vmax-vmin;
+    for (l=0; l<=NUMV; l++)
     {
-      if (pp->appearance == APPEARANCE_DISTANCE_BANDS &&
-          ((i & (NUMB-1)) >= NUMB/4) && ((i & (NUMB-1)) < 3*NUMB/4))
-        continue;
-      if (pp->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (j=0; j<=NUMU; j++)
+      for (m=0; m<=NUMU; m++)
       {
-        for (k=0; k<=1; k++)
+        o = l*(NUMU+1)+m;
+        if (pp->colors == COLORS_DEPTH)
         {
-          l = i+k;
-          m = j;
-          o = l*(NUMU+1)+m;
-          glNormal3fv(pp->pn[o]);
-          glTexCoord2fv(pp->tex[o]);
-          if (pp->change_colors)
-          {
-            if (pp->colors == COLORS_DEPTH)
-            {
-              color(pp,(2.0*pp->x[o][3]+1.0)*M_PI*2.0/3.0,matc,pp->col[o]);
-            }
-            else if (pp->colors == COLORS_DIRECTION)
-            {
-              u = -ur*m/NUMU+umin;
-              color(pp,2.0*M_PI+fmod(2.0*u,2.0*M_PI),matc,pp->col[o]);
-            }
-            else if (pp->colors == COLORS_DISTANCE)
-            {
-              v = vr*l/NUMV+vmin;
-              color(pp,v*(5.0/6.0),matc,pp->col[o]);
-            }
-          }
-          if (pp->colors != COLORS_ONESIDED && pp->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(pp->col[o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,pp->col[o]);
-          }
-          glVertex3fv(pp->pp[o]);
+          color(pp,(2.0*pp->x[o][3]+1.0)*M_PI*2.0/3.0,matc,pp->col[o]);
+        }
+        else if (pp->colors == COLORS_DIRECTION)
+        {
+          if (pp->appearance != APPEARANCE_DIRECTION_BANDS)
+            u = -ur*m/NUMU+umin;
+          else
+            u = ur*m/NUMU+umin;
+          color(pp,2.0*M_PI+fmod(2.0*u,2.0*M_PI),matc,pp->col[o]);
+        }
+        else /* pp->colors == COLORS_DISTANCE */
+        {
+          v = vr*l/NUMV+vmin;
+          color(pp,v*(5.0/6.0),matc,pp->col[o]);
         }
       }
-      glEnd();
     }
   }
+
+  layout.rows = NUMV;
+  layout.cols = NUMU;
+  layout.wireframe_p = (pp->display_mode == DISP_WIREFRAME);
+  if (pp->appearance != APPEARANCE_DIRECTION_BANDS)
+  {
+    layout.columns_p = False;
+    layout.band_period =
+      (pp->appearance == APPEARANCE_DISTANCE_BANDS) ? NUMB : 0;
+    layout.band_lo = NUMB/4;
+    layout.band_hi = 3*NUMB/4;
+  }
   else /* pp->appearance == APPEARANCE_DIRECTION_BANDS */
   {
-    for (j=0; j<NUMU; j++)
-    {
-      if ((j & (NUMB-1)) >= NUMB/2)
-        continue;
-      if (pp->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (i=0; i<=NUMV; i++)
-      {
-        for (k=0; k<=1; k++)
-        {
-          l = i;
-          m = j+k;
-          o = l*(NUMU+1)+m;
-          glNormal3fv(pp->pn[o]);
-          glTexCoord2fv(pp->tex[o]);
-          if (pp->change_colors)
-          {
-            if (pp->colors == COLORS_DEPTH)
-            {
-              color(pp,(2.0*pp->x[o][3]+1.0)*M_PI*2.0/3.0,matc,pp->col[o]);
-            }
-            else if (pp->colors == COLORS_DIRECTION)
-            {
-              u = ur*m/NUMU+umin;
-              color(pp,2.0*M_PI+fmod(2.0*u,2.0*M_PI),matc,pp->col[o]);
-            }
-            else if (pp->colors == COLORS_DISTANCE)
-            {
-              v = vr*l/NUMV+vmin;
-              color(pp,v*(5.0/6.0),matc,pp->col[o]);
-            }
-          }
-          if (pp->colors != COLORS_ONESIDED && pp->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(pp->col[o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,pp->col[o]);
-          }
-          glVertex3fv(pp->pp[o]);
-        }
-      }
-      glEnd();
-    }
+    layout.columns_p = True;
+    layout.band_period = NUMB;
+    layout.band_lo = NUMB/2;
+    layout.band_hi = NUMB;
   }
+  gridsurf_draw(&pp->strips,&layout,pp->pp[0],pp->pn[0],pp->tex[0],
+                (pp->colors != COLORS_ONESIDED &&
+                 pp->colors != COLORS_TWOSIDED) ? pp->col[0] : NULL);
 
   polys = 2*NUMU*NUMV;
   if (pp->appearance != APPEARANCE_SOLID)
@@ -2618,6 +2533,7 @@ ENTRYPOINT void free_projectiveplane(ModeInfo *mi)
   gltrackball_free (pp->trackballs[0]);
   gltrackball_free (pp->trackballs[1]);
   if (pp->tex_name) glDeleteTextures (1, &pp->tex_name);
+  gridsurf_free (&pp->strips);
 #ifdef HAVE_GLSL
   if (pp->use_shaders)
   {
@@ -233,6 +233,7 @@ static const char sccsid[] = "@(#)romanboy.c  1.1 14/10/03 xlockmore";
 
 #include "glsl-utils.h"
 #include "gltrackball.h"
+#include "gridsurf.h"
 
 #include <float.h>
 
@@ -379,6 +380,8 @@ typedef struct {
   float *tex;
   /* The "curlicue" texture */
   GLuint tex_name;
+  /* The triangles of the fixed-function path */
+  gridsurf_strips strips;
   /* Aspect ratio of the current window */
   float aspect;
   /* Trackball states */
@@ -1000,7 +1003,7 @@ static int roman_boy_ff(ModeInfo *mi, double umin, double umax,
   static const GLfloat mat_diff_trans_oneside[] = { 0.9, 0.4, 0.3, 0.7 };
   float mat_diff_dyn[4], mat_diff_dyn_compl[4];
   float p[3], pu[3], pv[3], n[3], mat[3][3], matc[3][3];
-  int i, j, k, l, m, o, g;
+  int i, j, l, m, o, g;
   float u, v, ur, vr, oz;
   float xx[3], xxu[3], xxv[3];
   float r, s, t;
@@ -1008,6 +1011,7 @@ static int roman_boy_ff(ModeInfo *mi, double umin, double umax,
   float cu, su, cgu, sgu, cgm1u, sgm1u, cv, c2v, s2v, cv2;
   float sqrt2og, h1m1og, gm1, nomx, nomy, nomux, nomuy, nomvx, nomvy;
   float den, den2, denu, denv;
+  gridsurf_layout layout;
   float qu[4], r1[3][3], r2[3][3];
   romanboystruct *pp = &romanboy[MI_SCREEN(mi)];
   int polys;
@@ -1396,73 +1400,31 @@ static int roman_boy_ff(ModeInfo *mi, double umin, double umax,
     }
   }
 
+  layout.rows = numv;
+  layout.cols = numu;
+  layout.wireframe_p = (pp->display_mode == DISP_WIREFRAME);
   if (pp->appearance != APPEARANCE_DIRECTION_BANDS)
   {
-    for (i=0; i<numv; i++)
-    {
-      if (pp->appearance == APPEARANCE_DISTANCE_BANDS &&
-          ((i & (NUMB-1)) >= NUMB/4) && ((i & (NUMB-1)) < 3*NUMB/4))
-        continue;
-      if (pp->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (j=0; j<=numu; j++)
-      {
-        for (k=0; k<=1; k++)
-        {
-          l = i+k;
-          m = j;
-          o = l*(numu+1)+m;
-          glTexCoord2fv(&pp->tex[2*o]);
-          if (pp->colors != COLORS_ONESIDED && pp->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(&pp->col[4*o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,
-                         &pp->col[4*o]);
-          }
-          glNormal3fv(&pp->pn[3*o]);
-          glVertex3fv(&pp->pp[3*o]);
-        }
-      }
-      glEnd();
-    }
+    layout.columns_p = False;
+    layout.band_period =
+      (pp->appearance == APPEARANCE_DISTANCE_BANDS) ? NUMB : 0;
+    layout.band_lo = NUMB/4;
+    layout.band_hi = 3*NUMB/4;
     polys = 2*numv*(numu+1);
     if (pp->appearance == APPEARANCE_DISTANCE_BANDS)
       polys /= 2;
   }
   else /* pp->appearance == APPEARANCE_DIRECTION_BANDS */
   {
-    for (j=0; j<numu; j++)
-    {
-      if ((j & (NUMB-1)) >= NUMB/2)
-        continue;
-      if (pp->display_mode == DISP_WIREFRAME)
-        glBegin(GL_QUAD_STRIP);
-      else
-        glBegin(GL_TRIANGLE_STRIP);
-      for (i=0; i<=numv; i++)
-      {
-        for (k=0; k<=1; k++)
-        {
-          l = i;
-          m = j+k;
-          o = l*(numu+1)+m;
-          glTexCoord2fv(&pp->tex[2*o]);
-          if (pp->colors != COLORS_ONESIDED && pp->colors != COLORS_TWOSIDED)
-          {
-            glColor3fv(&pp->col[4*o]);
-            glMaterialfv(GL_FRONT_AND_BACK,GL_AMBIENT_AND_DIFFUSE,
-                         &pp->col[4*o]);
-          }
-          glNormal3fv(&pp->pn[3*o]);
-          glVertex3fv(&pp->pp[3*o]);
-        }
-      }
-      glEnd();
-    }
+    layout.columns_p = True;
+    layout.band_period = NUMB;
+    layout.band_lo = NUMB/2;
+    layout.band_hi = NUMB;
     polys = numu*(numv+1);
   }
+  gridsurf_draw(&pp->strips,&layout,pp->pp,pp->pn,pp->tex,
+                (pp->colors != COLORS_ONESIDED &&
+                 pp->colors != COLORS_TWOSIDED) ? pp->col : NULL);
 
   return polys;
 }
@@ -2538,6 +2500,7 @@ ENTRYPOINT void free_romanboy(ModeInfo *mi)
   if (pp->tex) free(pp->tex);
   gltrackball_free (pp->trackball);
   if (pp->tex_name) glDeleteTextures (1, &pp->tex_name);
+  gridsurf_free (&pp->strips);
 #ifdef HAVE_GLSL
   if (pp->uv) free(pp->uv);
   if (pp->indices) free(pp->indices);
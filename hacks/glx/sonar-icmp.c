@@ -11,6 +11,7 @@
  * This implements the "ping" sensor for sonar.
  */
 
+#define _GNU_SOURCE  /* for recvmmsg */
 #include "screenhackI.h"
 #include "sonar.h"
 #include "doubletime.h"
@@ -70,6 +71,7 @@
 # include <arpa/inet.h>
 # include <netdb.h>
 # include <errno.h>
+# include <poll.h>
 # ifdef HAVE_GETIFADDRS
 #  include <ifaddrs.h>
 # endif
@@ -132,15 +134,43 @@ sonar_init_ping (Display *dpy, char **error_ret, char **desc_ret,
  */
 static int global_icmpsock = 0;
 
-/* Set by a signal handler. */
-static int timer_expired;
+/* Replies are read by a thread of their own, so that a slow network never
+   makes the display wait.  That thread hands them to get_ping through a
+   single-producer, single-consumer ring, which needs atomic loads and
+   stores.  Without those, get_ping reads the socket itself, without
+   waiting.
+ */
+#if HAVE_PTHREAD && \
+    (defined(__GNUC__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)) || \
+     defined(__clang__))
+# define READER_THREAD
+# define LOAD_ACQUIRE(p)     __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+# define STORE_RELEASE(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#endif
 
+#define REPLY_QUEUE 1024	/* must be a power of 2 */
+#define REPLY_BATCH 32		/* packets per recvmmsg */
 
 
 static u_short checksum(u_short *, int);
 static long delta(struct timeval *, struct timeval *);
 
 
+/* A parsed ICMP echo reply.  The reader thread only fills these in; it is
+   get_ping that matches them to the targets.
+ */
+typedef struct {
+  int size;			/* bytes received */
+  int seq;			/* icmp_seq */
+  unsigned long src;		/* who it actually came from */
+  double msec;			/* round trip time */
+  socklen_t addrlen;		/* who we sent it to, from the payload;
+                                   0 if the payload was bogus */
+  async_netdb_sockaddr_storage_t address;
+} ping_reply;
+
+
 typedef struct {
   Display *dpy;                 /* Only used to get *useThreads. */
 
@@ -148,13 +178,26 @@ typedef struct {
   int icmpsock;			/* socket for sending pings */
   int pid;			/* our process ID */
   int seq;			/* packet sequence number */
-  int timeout;			/* packet timeout */
+  int timeout;			/* ignore replies slower than this, in ms */
 
   int target_count;
   sonar_bogie *targets;		/* the hosts we will ping;
                                    those that pong end up on ssd->pending. */
   sonar_bogie *last_pinged;	/* pointer into 'targets' list */
   double last_ping_time;
+  unsigned long dropped;	/* pings lost to a full send buffer */
+
+  sonar_bogie **hash;		/* resolved targets, by address */
+  unsigned long hash_mask;
+
+# ifdef READER_THREAD
+  int reader;			/* 0: not started; 1: running; -1: no threads */
+  int reader_stop_p;
+  struct io_thread io;
+  unsigned reply_head;		/* written only by the reader thread */
+  unsigned reply_tail;		/* written only by get_ping */
+  ping_reply replies[REPLY_QUEUE];
+# endif
 
   Bool resolve_p;
   Bool times_p;
@@ -168,6 +211,7 @@ typedef struct {
   async_netdb_sockaddr_storage_t address;	/* ip address */
   socklen_t addrlen;
   char *fallback;
+  sonar_bogie *hash_next;	/* next in this bucket of pd->hash */
 } ping_bogie;
 
 
@@ -538,84 +582,107 @@ read_hosts_file (sonar_sensor_data *ssd, const char *filename)
 #endif /* READ_FILES */
 
 
-static sonar_bogie **
-found_duplicate_host (const ping_data *pd, sonar_bogie **list,
-                      sonar_bogie *bogie)
+/* The part of the address that two targets must share to be the same host.
+ */
+static const void *
+address_key (const async_netdb_sockaddr_storage_t *address, socklen_t addrlen,
+             size_t *len_ret)
 {
-  if (pd->debug_p)
-  {
-    fprintf (stderr, "%s: deleted duplicate: ", progname);
-    print_host (stderr, bogie);
-  }
+  const struct sockaddr *addr = (const struct sockaddr *) address;
+  switch (addr->sa_family)
+    {
+    case AF_INET:
+      *len_ret = sizeof(struct in_addr);
+      return &((const struct sockaddr_in *) addr)->sin_addr;
+#ifdef AF_INET6
+    case AF_INET6:
+      *len_ret = sizeof(struct in6_addr);
+      return &((const struct sockaddr_in6 *) addr)->sin6_addr;
+#endif
+    default:
+      /* Fallback behavior: Just use the whole address.
+
+         For this to work, unused space in the sockaddr must be
+         set to zero. Which may actually be the case:
+         - async_addr_from_name_finish won't put garbage into
+           sockaddr_in.sin_zero or elsewhere unless getaddrinfo
+           does.
+         - ping_bogie is allocated with calloc(). */
+      *len_ret = addrlen;
+      return addr;
+    }
+}
 
-  return list;
+
+static unsigned long
+address_hash (const ping_data *pd, const async_netdb_sockaddr_storage_t *addr,
+              socklen_t addrlen)
+{
+  size_t len;
+  const unsigned char *key = address_key (addr, addrlen, &len);
+  unsigned long h = 2166136261UL;	/* FNV-1a */
+  while (len--)
+    h = ((h ^ *key++) * 16777619UL) & 0xFFFFFFFFUL;
+  return h & pd->hash_mask;
 }
 
 
-static sonar_bogie **
-find_duplicate_host (const ping_data *pd, sonar_bogie **list,
-                     sonar_bogie *bogie)
+static void
+hash_init (ping_data *pd, int count)
+{
+  unsigned long size = 64;
+  while (size < count * 2)
+    size <<= 1;
+  pd->hash = (sonar_bogie **) calloc (size, sizeof(*pd->hash));
+  if (! pd->hash) abort();
+  pd->hash_mask = size - 1;
+}
+
+
+/* Only resolved targets go in the hash; they stay there until freed.
+ */
+static void
+hash_add (ping_data *pd, sonar_bogie *b)
+{
+  ping_bogie *pb = (ping_bogie *) b->closure;
+  unsigned long i = address_hash (pd, &pb->address, pb->addrlen);
+  pb->hash_next = pd->hash[i];
+  pd->hash[i] = b;
+}
+
+
+/* Returns the target with the same host address as this bogie, if any.
+ */
+static sonar_bogie *
+find_duplicate_host (const ping_data *pd, sonar_bogie *bogie)
 {
   const ping_bogie *pb = (const ping_bogie *) bogie->closure;
   const struct sockaddr *addr1 = (const struct sockaddr *) &(pb->address);
+  size_t len1;
+  const void *key1 = address_key (&pb->address, pb->addrlen, &len1);
+  sonar_bogie *b;
 
-  while(*list)
+  for (b = pd->hash[address_hash (pd, &pb->address, pb->addrlen)];
+       b;
+       b = ((const ping_bogie *) b->closure)->hash_next)
     {
-      const ping_bogie *pb2 = (const ping_bogie *) (*list)->closure;
-
-      if (!pb2->lookup_addr)
+      const ping_bogie *pb2 = (const ping_bogie *) b->closure;
+      const struct sockaddr *addr2 = (const struct sockaddr *) &(pb2->address);
+      size_t len2;
+      const void *key2 = address_key (&pb2->address, pb2->addrlen, &len2);
+
+      if (b != bogie &&
+          addr1->sa_family == addr2->sa_family &&
+          len1 == len2 &&
+          ! memcmp (key1, key2, len1))
         {
-          const struct sockaddr *addr2 =
-            (const struct sockaddr *) &(pb2->address);
-
-          if (addr1->sa_family == addr2->sa_family)
+          if (pd->debug_p)
             {
-              switch (addr1->sa_family)
-                {
-                case AF_INET:
-                  {
-                    unsigned long ip1 =
-                      ((const struct sockaddr_in *)addr1)->sin_addr.s_addr;
-                    const struct sockaddr_in *i2 =
-                      (const struct sockaddr_in *)addr2;
-                    unsigned long ip2 = i2->sin_addr.s_addr;
-
-                    if (ip1 == ip2)
-                      return found_duplicate_host (pd, list, bogie);
-                  }
-                  break;
-#ifdef AF_INET6
-                case AF_INET6:
-                  {
-                    if (! memcmp(
-                            &((const struct sockaddr_in6 *)addr1)->sin6_addr,
-                            &((const struct sockaddr_in6 *)addr2)->sin6_addr,
-                            16))
-                      return found_duplicate_host (pd, list, bogie);
-                  }
-                  break;
-#endif
-                default:
-                  {
-                    /* Fallback behavior: Just memcmp the two addresses.
-
-                       For this to work, unused space in the sockaddr must be
-                       set to zero. Which may actually be the case:
-                       - async_addr_from_name_finish won't put garbage into
-                         sockaddr_in.sin_zero or elsewhere unless getaddrinfo
-                         does.
-                       - ping_bogie is allocated with calloc(). */
-
-                    if (pb->addrlen == pb2->addrlen &&
-                        ! memcmp(addr1, addr2, pb->addrlen))
-                      return found_duplicate_host (pd, list, bogie);
-                  }
-                  break;
-                }
+              fprintf (stderr, "%s: deleted duplicate: ", progname);
+              print_host (stderr, bogie);
             }
+          return b;
         }
-
-      list = &(*list)->next;
     }
 
   return NULL;
@@ -626,27 +693,28 @@ static sonar_bogie *
 delete_duplicate_hosts (sonar_sensor_data *ssd, sonar_bogie *list)
 {
   ping_data *pd = (ping_data *) ssd->closure;
-  sonar_bogie *head = list;
-  sonar_bogie *sb = head;
+  sonar_bogie **sbp = &list;
 
-  while (sb)
+  while (*sbp)
     {
+      sonar_bogie *sb = *sbp;
       ping_bogie *pb = (ping_bogie *) sb->closure;
 
-      if (!pb->lookup_addr)
+      if (pb->lookup_addr)	/* Not resolved yet: ping_scan checks it. */
+        sbp = &sb->next;
+      else if (find_duplicate_host (pd, sb))
         {
-          sonar_bogie **sb2 = find_duplicate_host (pd, &sb->next, sb);
-          if (sb2)
-            *sb2 = (*sb2)->next;
-            /* #### sb leaked */
-          else
-            sb = sb->next;
+          *sbp = sb->next;
+          sonar_free_bogie (ssd, sb);
         }
       else
-        sb = sb->next;
+        {
+          hash_add (pd, sb);
+          sbp = &sb->next;
+        }
     }
 
-  return head;
+  return list;
 }
 
 
@@ -975,7 +1043,7 @@ send_ping (ping_data *pd, const sonar_bogie *b)
   memcpy(&packet[sizeof(struct ICMP)], &tval, sizeof tval);
 
   /* We store the sockaddr of the host we're pinging in the packet, and parse
-     that out of the return packet later (see get_ping() for why).
+     that out of the return packet later (see reply_bogie() for why).
      After that, we also include the name and version of this program,
      just to give a clue to anyone sniffing and wondering what's up.
    */
@@ -994,6 +1062,16 @@ send_ping (ping_data *pd, const sonar_bogie *b)
              (struct sockaddr *)&pb->address, sizeof(pb->address))
       != pcktsiz)
     {
+      /* The socket is non-blocking, so when the send buffer is full the
+         ping is just lost, and the host will look like it didn't answer.
+       */
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          pd->dropped++;
+          if (pd->debug_p)
+            fprintf (stderr, "%s: send buffer full: dropped ping to %s"
+                     " (%lu so far)\n", progname, b->name, pd->dropped);
+        }
 #if 0
       char buf[BUFSIZ];
       sprintf(buf, "%s: pinging %.100s", progname, b->name);
@@ -1004,14 +1082,6 @@ send_ping (ping_data *pd, const sonar_bogie *b)
   free (packet);
 }
 
-/* signal handler */
-static void
-sigcatcher (int sig)
-{
-  timer_expired = 1;
-}
-
-
 /* Compute the checksum on a ping packet.
  */
 static u_short
@@ -1068,214 +1138,342 @@ copy_ping_bogie (sonar_sensor_data *ssd, const sonar_bogie *b)
 }
 
 
-/* Look for all outstanding ping replies.
+/* Parses a packet read from the ICMP socket.  Returns False if it is not
+   an echo reply to one of our own pings.  This runs on the reader thread,
+   so it must not touch the targets.
  */
-static sonar_bogie *
-get_ping (sonar_sensor_data *ssd)
+static Bool
+parse_reply (const ping_data *pd, const u_char *packet, int size,
+             struct timeval *now, ping_reply *r)
 {
-  ping_data *pd = (ping_data *) ssd->closure;
-  struct sockaddr from;
-  socklen_t fromlen;
-  int result;
-  u_char packet[1024];
-  struct timeval now;
-  struct timeval then;
-  struct ip *ip;
+  const struct ip *ip = (const struct ip *) packet;
   int iphdrlen;
-  struct ICMP *icmph;
-  sonar_bogie *bl = 0;
-  sonar_bogie *new = 0;
-  struct sigaction sa;
-  struct itimerval it;
-  fd_set rfds;
-  struct timeval tv;
-
-  /* Set up a signal to interrupt our wait for a packet */
-
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = 0;
-  sa.sa_handler = sigcatcher;
-  if (sigaction(SIGALRM, &sa, 0) == -1) 
+  const struct ICMP *icmph;
+  const u_char *host_id, *host_end;
+  struct timeval then;
+  socklen_t addrlen;
+
+  if (size < (int) sizeof(*ip))
+    return False;
+  iphdrlen = IP_HDRLEN(ip) << 2;
+  if (size < iphdrlen + (int) (sizeof(struct ICMP) + sizeof(then)))
+    return False;
+  icmph = (const struct ICMP *) &packet[iphdrlen];
+
+  /* Ignore anything but ICMP Replies */
+  if (ICMP_TYPE(icmph) != ICMP_ECHOREPLY)
+    return False;
+
+  /* Ignore packets not set from us */
+  if (ICMP_ID(icmph) != pd->pid)
+    return False;
+
+  r->size = size;
+  r->seq  = ICMP_SEQ(icmph);
+  r->src  = ip->ip_src.s_addr;
+
+  /* struct timeval data in packet is not aligned, move the data to
+     the aligned buffer
+   */
+  memcpy (&then, &packet[iphdrlen + sizeof(struct ICMP)], sizeof then);
+  r->msec = delta (&then, now) / 1000.0;
+
+  /* See reply_bogie for why we use the address in the payload rather than
+     ip_src.  Ensure that a maliciously-crafted return packet can't make
+     us overflow.
+   */
+  r->addrlen = 0;
+  host_id = &packet[iphdrlen + sizeof(struct ICMP) + sizeof(then)];
+  if (host_id + sizeof(addrlen) <= packet + size)
     {
-      char msg[1024];
-      sprintf(msg, "%s: unable to trap SIGALRM", progname);
-      perror(msg);
-      exit(1);
+      memcpy (&addrlen, host_id, sizeof(addrlen));
+      host_id += sizeof(addrlen);
+      host_end = host_id + addrlen;
+      if (addrlen <= sizeof(r->address) &&
+          host_id <= host_end && host_end <= packet + size)
+        {
+          memset (&r->address, 0, sizeof(r->address));
+          memcpy (&r->address, host_id, addrlen);
+          r->addrlen = addrlen;
+        }
     }
 
-  /* Set up a timer to interupt us if we don't get a packet */
+  return True;
+}
 
-  it.it_interval.tv_sec = 0;
-  it.it_interval.tv_usec = 0;
-  it.it_value.tv_sec = 0;
-  it.it_value.tv_usec = pd->timeout;
-  timer_expired = 0;
-  setitimer(ITIMER_REAL, &it, 0);
 
-  /* Wait for a result packet */
+/* Reads and parses as many replies as are waiting on the socket, without
+   blocking, up to 'max'.  Returns how many it stored in 'out'.
+ */
+static int
+read_replies (const ping_data *pd, ping_reply *out, int max)
+{
+  u_char packets[REPLY_BATCH][1024];
+  int sizes[REPLY_BATCH];
+  struct timeval now;
+  int count = 0;
 
-  fromlen = sizeof(from);
-  while (! timer_expired)
+  while (count < max)
     {
-      tv.tv_usec = pd->timeout;
-      tv.tv_sec = 0;
-#if 0
-      /* This breaks on BSD, which uses bzero() in the definition of FD_ZERO */
-      FD_ZERO(&rfds);
-#else
-      memset (&rfds, 0, sizeof(rfds));
-#endif
-      FD_SET(pd->icmpsock, &rfds);
-      /* only wait a little while, in case we raced with the timer expiration.
-         From Valentijn Sessink <valentyn@openoffice.nl> */
-      if (select(pd->icmpsock + 1, &rfds, 0, 0, &tv) >0)
+      int n, i;
+      int want = max - count;
+      if (want > REPLY_BATCH) want = REPLY_BATCH;
+
+# ifdef MSG_WAITFORONE	/* Linux: many packets per system call. */
+      {
+        struct mmsghdr msgs[REPLY_BATCH];
+        struct iovec iov[REPLY_BATCH];
+        memset (msgs, 0, sizeof(msgs));
+        for (i = 0; i < want; i++)
+          {
+            iov[i].iov_base = packets[i];
+            iov[i].iov_len  = sizeof(packets[i]);
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+          }
+        n = recvmmsg (pd->icmpsock, msgs, want, MSG_DONTWAIT, 0);
+        for (i = 0; i < n; i++)
+          sizes[i] = msgs[i].msg_len;
+      }
+# else  /* !MSG_WAITFORONE */
+      for (n = 0; n < want; n++)
         {
-          result = (int)recvfrom (pd->icmpsock, packet, sizeof(packet),
-                             0, &from, &fromlen);
+          sizes[n] = (int) recv (pd->icmpsock, packets[n], sizeof(packets[n]),
+                                 MSG_DONTWAIT);
+          if (sizes[n] < 0)
+            break;
+        }
+# endif /* !MSG_WAITFORONE */
 
-          /* Check the packet */
+      if (n <= 0)
+        break;
 
 # ifdef GETTIMEOFDAY_TWO_ARGS
-          gettimeofday(&now, (struct timezone *) 0);
+      gettimeofday(&now, (struct timezone *) 0);
 # else
-          gettimeofday(&now);
+      gettimeofday(&now);
 # endif
-          ip = (struct ip *) packet;
-          iphdrlen = IP_HDRLEN(ip) << 2;
-          icmph = (struct ICMP *) &packet[iphdrlen];
-           /* struct timeval data in packet is not aligned, move the data to
-              the aligned buffer
-             */
-          memcpy(&then, &packet[iphdrlen + sizeof(struct ICMP)], sizeof then);
 
+      for (i = 0; i < n; i++)
+        if (parse_reply (pd, packets[i], sizes[i], &now, &out[count]))
+          count++;
 
-          /* Ignore anything but ICMP Replies */
-          if (ICMP_TYPE(icmph) != ICMP_ECHOREPLY) 
-            continue;
+      if (n < want)	/* drained */
+        break;
+    }
 
-          /* Ignore packets not set from us */
-          if (ICMP_ID(icmph) != pd->pid)
-	    continue;
+  return count;
+}
 
-          /* Find the bogie in 'targets' that corresponds to this packet
-             and copy it, so that this bogie stays in the same spot (th)
-             on the screen, and so that we don't have to resolve it again.
 
-             We could find the bogie by comparing ip->ip_src.s_addr to
-             pb->address, but it is possible that, in certain weird router
-             or NAT situations, that the reply will come back from a 
-             different address than the one we sent it to.  So instead,
-             we parse the sockaddr out of the reply packet payload.
-           */
+# ifdef READER_THREAD
+
+/* Waits for replies and queues them for get_ping, until ping_free_data.
+ */
+static void *
+reader_thread (void *closure)
+{
+  ping_data *pd = (ping_data *) closure;
+
+  while (! LOAD_ACQUIRE (&pd->reader_stop_p))
+    {
+      unsigned head = pd->reply_head;
+      unsigned tail = LOAD_ACQUIRE (&pd->reply_tail);
+      unsigned room = REPLY_QUEUE - (head - tail);
+      unsigned at = head & (REPLY_QUEUE - 1);
+      struct pollfd pfd;
+
+      /* Don't sleep for long, so that ping_free_data isn't kept waiting.
+         If the queue is full, leave the packets in the socket for now. */
+      pfd.fd = pd->icmpsock;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (poll (&pfd, (room ? 1 : 0), 100) <= 0)
+        continue;
+
+      if (room > REPLY_QUEUE - at)   /* Only up to the end of the ring. */
+        room = REPLY_QUEUE - at;
+      head += read_replies (pd, &pd->replies[at], room);
+      STORE_RELEASE (&pd->reply_head, head);
+    }
+
+  io_thread_return (&pd->io);
+  return 0;
+}
+
+# endif /* READER_THREAD */
+
+
+/* Turns a reply into a copy of the target that it came from.
+ */
+static sonar_bogie *
+reply_bogie (sonar_sensor_data *ssd, const ping_reply *r)
+{
+  ping_data *pd = (ping_data *) ssd->closure;
+  sonar_bogie *b = 0;
+  sonar_bogie *new;
+  double msec = r->msec;
+
+  /* Find the bogie in 'targets' that corresponds to this packet
+     and copy it, so that this bogie stays in the same spot (th)
+     on the screen, and so that we don't have to resolve it again.
+
+     We could find the bogie by comparing ip->ip_src.s_addr to
+     pb->address, but it is possible that, in certain weird router
+     or NAT situations, that the reply will come back from a 
+     different address than the one we sent it to.  So instead,
+     we parse the sockaddr out of the reply packet payload.
+   */
+  if (r->addrlen)
+    for (b = pd->hash[address_hash (pd, &r->address, r->addrlen)];
+         b;
+         b = ((ping_bogie *) b->closure)->hash_next)
+      {
+        ping_bogie *pb = (ping_bogie *) b->closure;
+        if (r->addrlen == pb->addrlen &&
+            !memcmp (&pb->address, &r->address, pb->addrlen))
+          break;
+      }
+
+  if (! b)      /* not in targets? */
+    {
+      unsigned int a1, a2, a3, a4;
+      unpack_addr (r->src, &a1, &a2, &a3, &a4);
+      fprintf (stderr, 
+               "%s: UNEXPECTED PING REPLY! "
+               "%4d bytes, icmp_seq=%-4d from %d.%d.%d.%d\n",
+               progname, r->size, r->seq, a1, a2, a3, a4);
+      return 0;
+    }
+
+  /* The --ping-timeout is how long we'll wait for an answer. */
+  if (msec > pd->timeout)
+    {
+      if (pd->debug_p)
+        fprintf (stderr, "%s: late reply from %s: %.0f ms\n",
+                 progname, b->name, msec);
+      return 0;
+    }
+
+  {
+    ping_bogie *pb = (ping_bogie *) b->closure;
+
+    /* Check to see if the name lookup is done. */
+    if (pb->lookup_name &&
+        async_name_from_addr_is_done (pb->lookup_name))
+      {
+        char *host = NULL;
+
+        async_name_from_addr_finish (pb->lookup_name, &host, NULL);
+
+        if (pd->debug_p > 1)
+          fprintf (stderr, "%s:   %s => %s\n", progname, b->name,
+                   host ? host : "<unknown>");
+
+        if (host)
           {
-            const socklen_t *host_id = (socklen_t *) &packet[
-              iphdrlen + sizeof(struct ICMP) + sizeof(struct timeval)];
-
-            sonar_bogie *b;
-
-            /* Ensure that a maliciously-crafted return packet can't
-               make us overflow in memcmp. */
-            if (result > 0 && (const u_char *)(host_id + 1) <= packet + result)
-              {
-                const u_char *host_end = (const u_char *)(host_id + 1) +
-                                         *host_id;
-
-                if ((const u_char *)(host_id + 1) <= host_end &&
-                    host_end <= packet + result)
-                  {
-                    for (b = pd->targets; b; b = b->next)
-                      {
-                        ping_bogie *pb = (ping_bogie *)b->closure;
-                        if (*host_id == pb->addrlen &&
-                            !memcmp(&pb->address, host_id + 1, pb->addrlen) )
-                          {
-                            /* Check to see if the name lookup is done. */
-                            if (pb->lookup_name &&
-                                async_name_from_addr_is_done (pb->lookup_name))
-                              {
-                                char *host = NULL;
-
-                                async_name_from_addr_finish (pb->lookup_name,
-                                                             &host, NULL);
-
-                                if (pd->debug_p > 1)
-                                  fprintf (stderr, "%s:   %s => %s\n",
-                                           progname, b->name,
-                                           host ? host : "<unknown>");
-
-                                if (host)
-                                  {
-                                    free(b->name);
-                                    b->name = host;
-                                  }
-
-                                pb->lookup_name = NULL;
-                              }
-
-                            new = copy_ping_bogie (ssd, b);
-                            break;
-                          }
-                      }
-                  }
-              }
+            free(b->name);
+            b->name = host;
           }
 
-          if (! new)      /* not in targets? */
-            {
-              unsigned int a, b, c, d;
-              unpack_addr (ip->ip_src.s_addr, &a, &b, &c, &d);
-              fprintf (stderr, 
-                       "%s: UNEXPECTED PING REPLY! "
-                       "%4d bytes, icmp_seq=%-4d from %d.%d.%d.%d\n",
-                       progname, result, ICMP_SEQ(icmph), a, b, c, d);
-              continue;
-            }
+        pb->lookup_name = NULL;
+      }
+  }
+
+  new = copy_ping_bogie (ssd, b);
+
+  if (pd->times_p)
+    {
+      if (new->desc) free (new->desc);
+      new->desc = (char *) malloc (30);
+      if      (msec > 99) sprintf (new->desc, "%.0f ms", msec);
+      else if (msec >  9) sprintf (new->desc, "%.1f ms", msec);
+      else if (msec >  1) sprintf (new->desc, "%.2f ms", msec);
+      else                sprintf (new->desc, "%.3f ms", msec);
+    }
 
-          new->next = bl;
-          bl = new;
+  if (pd->debug_p && pd->times_p)  /* ping-like stdout log */
+    {
+      char *s = strdup(new->name);
+      char *s2 = s;
+      if (strlen(s) > 28)
+        {
+          s2 = s + strlen(s) - 28;
+          memcpy (s2, "...", 3);
+        }
+      fprintf (stdout, 
+               "%3d bytes from %28s: icmp_seq=%-4d time=%s\n",
+               r->size, s2, r->seq, new->desc);
+      fflush (stdout);
+      free(s);
+    }
+
+  /* The radius must be between 0.0 and 1.0.
+     We want to display ping times on a logarithmic scale,
+     with the three rings being 2.5, 70 and 2,000 milliseconds.
+   */
+  if (msec <= 0) msec = 0.001;
+  new->r = log (msec * 10) / log (20000);
+
+  /* Don't put anyone *too* close to the center of the screen. */
+  if (new->r < 0) new->r = 0;
+  if (new->r < 0.1) new->r += 0.1;
+
+  return new;
+}
+
+
+/* Collects all outstanding ping replies, without waiting for any.
+ */
+static sonar_bogie *
+get_ping (sonar_sensor_data *ssd)
+{
+  ping_data *pd = (ping_data *) ssd->closure;
+  sonar_bogie *bl = 0;
+  sonar_bogie *new;
 
+# ifdef READER_THREAD
+  /* Not started by sonar_init_ping, since sonar.c calls setuid after that,
+     and see the comment in init_sensor about setuid and pthread_join. */
+  if (! pd->reader)
+    {
+      pd->reader = (io_thread_create (&pd->io, pd, reader_thread, pd->dpy, 0)
+                    ? 1 : -1);
+      if (pd->debug_p)
+        fprintf (stderr, "%s: %s\n", progname,
+                 (pd->reader > 0
+                  ? "reading replies on a thread"
+                  : "no threads: polling for replies"));
+    }
+
+  if (pd->reader > 0)
+    {
+      unsigned tail = pd->reply_tail;
+      unsigned head = LOAD_ACQUIRE (&pd->reply_head);
+      for (; tail != head; tail++)
+        if ((new = reply_bogie (ssd, &pd->replies[tail & (REPLY_QUEUE-1)])))
           {
-            double msec = delta(&then, &now) / 1000.0;
-
-            if (pd->times_p)
-              {
-                if (new->desc) free (new->desc);
-                new->desc = (char *) malloc (30);
-                if      (msec > 99) sprintf (new->desc, "%.0f ms", msec);
-                else if (msec >  9) sprintf (new->desc, "%.1f ms", msec);
-                else if (msec >  1) sprintf (new->desc, "%.2f ms", msec);
-                else                sprintf (new->desc, "%.3f ms", msec);
-              }
-
-            if (pd->debug_p && pd->times_p)  /* ping-like stdout log */
-              {
-                char *s = strdup(new->name);
-                char *s2 = s;
-                if (strlen(s) > 28)
-                  {
-                    s2 = s + strlen(s) - 28;
-                    memcpy (s2, "...", 3);
-                  }
-                fprintf (stdout, 
-                         "%3d bytes from %28s: icmp_seq=%-4d time=%s\n",
-                         result, s2, ICMP_SEQ(icmph), new->desc);
-                fflush (stdout);
-                free(s);
-              }
-
-            /* The radius must be between 0.0 and 1.0.
-               We want to display ping times on a logarithmic scale,
-               with the three rings being 2.5, 70 and 2,000 milliseconds.
-             */
-            if (msec <= 0) msec = 0.001;
-            new->r = log (msec * 10) / log (20000);
-
-            /* Don't put anyone *too* close to the center of the screen. */
-            if (new->r < 0) new->r = 0;
-            if (new->r < 0.1) new->r += 0.1;
+            new->next = bl;
+            bl = new;
           }
-        }
+      STORE_RELEASE (&pd->reply_tail, tail);
+      return bl;
     }
+# endif /* READER_THREAD */
+
+  {
+    ping_reply replies[REPLY_BATCH];
+    int n, i;
+    do {
+      n = read_replies (pd, replies, REPLY_BATCH);
+      for (i = 0; i < n; i++)
+        if ((new = reply_bogie (ssd, &replies[i])))
+          {
+            new->next = bl;
+            bl = new;
+          }
+    } while (n == REPLY_BATCH);
+  }
 
   return bl;
 }
@@ -1296,12 +1494,25 @@ ping_free_data (sonar_sensor_data *ssd, void *closure)
 {
   ping_data *pd = (ping_data *) closure;
   sonar_bogie *b = pd->targets;
+
+# ifdef READER_THREAD
+  if (pd->reader > 0)
+    {
+      STORE_RELEASE (&pd->reader_stop_p, 1);
+      io_thread_finish (&pd->io);
+    }
+# endif
+
   while (b)
     {
       sonar_bogie *b2 = b->next;
       sonar_free_bogie (ssd, b);
       b = b2;
     }
+  if (pd->debug_p && pd->dropped)
+    fprintf (stderr, "%s: %lu pings dropped with the send buffer full\n",
+             progname, pd->dropped);
+  if (pd->hash) free (pd->hash);
   free (pd);
 }
 
@@ -1388,8 +1599,11 @@ ping_scan (sonar_sensor_data *ssd)
                         new_bogie->next = *sbp;
 
                         if (! ((ping_bogie *)new_bogie->closure)->lookup_addr &&
-                            ! find_duplicate_host(pd, &pd->targets, new_bogie))
-                          *sbp = new_bogie;
+                            ! find_duplicate_host (pd, new_bogie))
+                          {
+                            *sbp = new_bogie;
+                            hash_add (pd, new_bogie);
+                          }
                         else
                           sonar_free_bogie (ssd, new_bogie);
                       }
@@ -1408,10 +1622,9 @@ ping_scan (sonar_sensor_data *ssd)
 
                   if (! is_address_ok (pd->debug_p, sb))
                     free_bogie_after_lookup (ssd, sbp, &sb);
-                  else if (find_duplicate_host (pd, &pd->targets, sb))
-                    /* Tricky: find_duplicate_host skips the current bogie when
-                       scanning the targets list because pb->lookup_addr hasn't
-                       been NULL'd yet.
+                  else if (find_duplicate_host (pd, sb))
+                    /* The current bogie isn't in the hash yet, so this
+                       can't find itself.
 
                        Not that it matters much, but behavior here is to
                        keep the existing address.
@@ -1420,7 +1633,10 @@ ping_scan (sonar_sensor_data *ssd)
                 }
 
               if (sb)
-                pb->lookup_addr = NULL;
+                {
+                  pb->lookup_addr = NULL;
+                  hash_add (pd, sb);
+                }
             }
 
           if (sb && !pb->lookup_addr)
@@ -1751,6 +1967,11 @@ sonar_init_ping (Display *dpy, char **error_ret, char **desc_ret,
 
   if (socket_initted_p)
     {
+      /* Neither sending nor reading replies should ever block. */
+      int flags = fcntl (pd->icmpsock, F_GETFL, 0);
+      if (flags >= 0)
+        fcntl (pd->icmpsock, F_SETFL, flags | O_NONBLOCK);
+
       global_icmpsock = pd->icmpsock;
       socket_initted_p = True;
       if (debug_p)
@@ -1793,6 +2014,10 @@ sonar_init_ping (Display *dpy, char **error_ret, char **desc_ret,
 
   pd->targets = parse_mode (ssd, error_ret, desc_ret, subnet,
                             socket_initted_p);
+  pd->target_count = 0;
+  for (b = pd->targets; b; b = b->next)
+    pd->target_count++;
+  hash_init (pd, pd->target_count);
   pd->targets = delete_duplicate_hosts (ssd, pd->targets);
 
   if (debug_p)
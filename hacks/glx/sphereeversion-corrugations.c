@@ -212,10 +212,6 @@ typedef struct {
 } two_jet_vec;
 
 
-typedef void surface_time_function(float u, float v, float t,
-                                   int num_strips, one_jet_vec *val);
-
-
 /* ------------------------------------------------------------------------- */
 
 
@@ -658,19 +654,18 @@ static inline void normalize_one_jet_vec(const one_jet_vec *v,
 }
 
 
-static inline void rotate_one_jet_vec_z_float(const one_jet_vec *v,
-                                              const one_jet *angle,
-                                              one_jet_vec *res)
+static inline void rotate_one_jet_vec_z_sin_cos(const one_jet_vec *v,
+                                                const one_jet *s,
+                                                const one_jet *c,
+                                                one_jet_vec *res)
 {
-  one_jet s, c, vxc, vxs, vyc, vys;
+  one_jet vxc, vxs, vyc, vys;
 
-  sin_one_jet(angle,&s);
-  cos_one_jet(angle,&c);
-  mult_one_jets(&v->x,&c,&vxc);
-  mult_one_jets(&v->y,&s,&vys);
+  mult_one_jets(&v->x,c,&vxc);
+  mult_one_jets(&v->y,s,&vys);
   add_one_jets(&vxc,&vys,&res->x);
-  mult_one_jets(&v->x,&s,&vxs);
-  mult_one_jets(&v->y,&c,&vyc);
+  mult_one_jets(&v->x,s,&vxs);
+  mult_one_jets(&v->y,c,&vyc);
   sub_one_jets(&vyc,&vxs,&res->y);
   copy_one_jet(&v->z,&res->z);
 }
@@ -802,19 +797,37 @@ static inline void interpolate_two_jet_vecs_float(const two_jet_vec *v1,
 /* ------------------------------------------------------------------------- */
 
 
-static void figure_eight(const one_jet_vec *w, const one_jet_vec *h,
-                         const one_jet_vec *bend, const one_jet *form,
-                         const one_jet *v, one_jet_vec *res)
+/* The figure eight is added to every point of the surface, but apart from
+   "form", its shape across the strip depends only on v, and its placement
+   on the surface only on u.  So gen_surface computes the v part once per
+   column and the u part once per row, and only combines them per point. */
+
+typedef struct {
+  one_jet_vec po, h, w, bend;
+  one_jet     fo;
+} figure_eight_row;
+
+
+typedef struct {
+  one_jet sin_vv2, heights, heights_sqs, cos_vv_m1_xm2;
+  one_jet sin_vs, cos_vs;
+} figure_eight_col;
+
+
+typedef void surface_time_function(float u, float t, figure_eight_row *row);
+
+
+static void figure_eight_col_setup(float v, int num_strips,
+                                   figure_eight_col *col)
 {
-  one_jet_vec hh, w_sin_vv2, hh_interp, bend_heights_sqs;
-  one_jet     height, height_neg, heights, heights_sq, heights_sqs;
-  one_jet     vv, vv2, cos_vv, sin_vv2, cos_vv2, cos_vv2_m1;
-  one_jet     cos_vv_m1, cos_vv_m1_xm2, interp;
+  one_jet vj, vs, height, height_neg, heights_sq;
+  one_jet vv, vv2, cos_vv, cos_vv2, cos_vv2_m1, cos_vv_m1;
 
-  fmod_one_jet(v,1.0f,&vv);
+  set_one_jet(v,0.0f,1.0f,&vj);
+  fmod_one_jet(&vj,1.0f,&vv);
   cos_one_jet(&vv,&cos_vv);
   mult_one_jet_float(&vv,2.0f,&vv2);
-  sin_one_jet(&vv2,&sin_vv2);
+  sin_one_jet(&vv2,&col->sin_vv2);
   cos_one_jet(&vv2,&cos_vv2);
   add_one_jet_float(&cos_vv2,-1.0f,&cos_vv2_m1);
   neg_one_jet(&cos_vv2_m1,&height);
@@ -823,27 +836,24 @@ static void figure_eight(const one_jet_vec *w, const one_jet_vec *h,
     neg_one_jet(&height,&height_neg);
     add_one_jet_float(&height_neg,4.0f,&height);
   }
-  mult_one_jet_float(&height,0.6f,&heights);
-  mult_one_jets(&heights,&heights,&heights_sq);
-  mult_one_jet_float(&heights_sq,1.0f/64.0f,&heights_sqs);
-  mult_one_jet_vec_one_jet(bend,&heights_sqs,&bend_heights_sqs);
-  add_one_jet_vecs(h,&bend_heights_sqs,&hh);
+  mult_one_jet_float(&height,0.6f,&col->heights);
+  mult_one_jets(&col->heights,&col->heights,&heights_sq);
+  mult_one_jet_float(&heights_sq,1.0f/64.0f,&col->heights_sqs);
   add_one_jet_float(&cos_vv,-1.0f,&cos_vv_m1);
-  mult_one_jet_float(&cos_vv_m1,-2.0f,&cos_vv_m1_xm2);
-  interpolate_one_jets_float(&cos_vv_m1_xm2,&heights,form,&interp);
-  mult_one_jet_vec_one_jet(w,&sin_vv2,&w_sin_vv2);
-  mult_one_jet_vec_one_jet(&hh,&interp,&hh_interp);
-  add_one_jet_vecs(&w_sin_vv2,&hh_interp,res);
+  mult_one_jet_float(&cos_vv_m1,-2.0f,&col->cos_vv_m1_xm2);
+
+  mult_one_jet_float(&vj,1.0f/num_strips,&vs);
+  sin_one_jet(&vs,&col->sin_vs);
+  cos_one_jet(&vs,&col->cos_vs);
 }
 
 
-static void add_figure_eight(two_jet_vec *p, two_jet *u, one_jet *v,
-                             two_jet *form, two_jet *scale, int num_strips,
-                             one_jet_vec *res)
+static void figure_eight_row_setup(two_jet_vec *p, two_jet *u,
+                                   two_jet *form, two_jet *scale,
+                                   figure_eight_row *row)
 {
-  one_jet_vec dp, dpa, du, dv, po, fe, h, w, bend;
-  one_jet_vec duxdv, duxdvn, hxdu, hxdun, dudsize, popfe;
-  one_jet     fo, dsize, duu, sizeo, sizeos, vs, duuinv;
+  one_jet_vec dp, dpa, du, dv, duxdv, duxdvn, hxdu, hxdun, dudsize;
+  one_jet     dsize, duu, sizeo, sizeos, duuinv;
   two_jet_vec pa;
   two_jet     f, f2, ff, size;
 
@@ -852,7 +862,7 @@ static void add_figure_eight(two_jet_vec *p, two_jet *u, one_jet *v,
   mult_two_jet_float(&f,2.0f,&f2);
   mult_two_jets(&f,&f,&ff);
   sub_two_jets(&f2,&ff,&f);
-  two_jet_to_one_jet(&f,&fo);
+  two_jet_to_one_jet(&f,&row->fo);
   two_jet_to_one_jet(&size,&sizeo);
   differentiate_two_jet_vec(p,1,&dp);
   annihilate_one_jet_vec(&dp,1,&dv);
@@ -861,21 +871,36 @@ static void add_figure_eight(two_jet_vec *p, two_jet *u, one_jet *v,
   normalize_one_jet_vec(&dpa,&du);
   cross_one_jet_vecs(&du,&dv,&duxdv);
   normalize_one_jet_vec(&duxdv,&duxdvn);
-  mult_one_jet_vec_one_jet(&duxdvn,&sizeo,&h);
-  cross_one_jet_vecs(&h,&du,&hxdu);
+  mult_one_jet_vec_one_jet(&duxdvn,&sizeo,&row->h);
+  cross_one_jet_vecs(&row->h,&du,&hxdu);
   normalize_one_jet_vec(&hxdu,&hxdun);
   mult_one_jet_float(&sizeo,1.1f,&sizeos);
-  mult_one_jet_vec_one_jet(&hxdun,&sizeos,&w);
+  mult_one_jet_vec_one_jet(&hxdun,&sizeos,&row->w);
   differentiate_two_jet(&size,0,&dsize);
   differentiate_two_jet(u,0,&duu);
   mult_one_jet_vec_one_jet(&du,&dsize,&dudsize);
   pow_one_jet(&duu,-1.0f,&duuinv);
-  mult_one_jet_vec_one_jet(&dudsize,&duuinv,&bend);
-  figure_eight(&w,&h,&bend,&fo,v,&fe);
-  two_jet_vec_to_one_jet_vec(&pa,&po);
-  mult_one_jet_float(v,1.0f/num_strips,&vs);
-  add_one_jet_vecs(&po,&fe,&popfe);
-  rotate_one_jet_vec_z_float(&popfe,&vs,res);
+  mult_one_jet_vec_one_jet(&dudsize,&duuinv,&row->bend);
+  two_jet_vec_to_one_jet_vec(&pa,&row->po);
+}
+
+
+static inline void add_figure_eight(const figure_eight_row *row,
+                                    const figure_eight_col *col,
+                                    one_jet_vec *res)
+{
+  one_jet_vec hh, w_sin_vv2, hh_interp, bend_heights_sqs, fe, popfe;
+  one_jet     interp;
+
+  mult_one_jet_vec_one_jet(&row->bend,&col->heights_sqs,&bend_heights_sqs);
+  add_one_jet_vecs(&row->h,&bend_heights_sqs,&hh);
+  interpolate_one_jets_float(&col->cos_vv_m1_xm2,&col->heights,&row->fo,
+                             &interp);
+  mult_one_jet_vec_one_jet(&row->w,&col->sin_vv2,&w_sin_vv2);
+  mult_one_jet_vec_one_jet(&hh,&interp,&hh_interp);
+  add_one_jet_vecs(&w_sin_vv2,&hh_interp,&fe);
+  add_one_jet_vecs(&row->po,&fe,&popfe);
+  rotate_one_jet_vec_z_sin_cos(&popfe,&col->sin_vs,&col->cos_vs,res);
 }
 
 
@@ -1119,85 +1144,70 @@ static inline void scene34(two_jet *u, float t, two_jet_vec *s34)
 }
 
 
-static inline void corrugate(float u, float v, float t, int num_strips,
-                             one_jet_vec *val)
+static void corrugate(float u, float t, figure_eight_row *row)
 {
   two_jet_vec s1;
   two_jet     uj, form, scale, ui;
-  one_jet     vj;
 
   set_two_jet(u,1.0f,0.0f,&uj);
-  set_one_jet(v,0.0f,1.0f,&vj);
   stage1(&uj,&s1);
   ff_interp(&uj,&ui);
   mult_two_jet_float(&ui,t,&form);
   fs_interp(&uj,&scale);
-  add_figure_eight(&s1,&uj,&vj,&form,&scale,num_strips,val);
+  figure_eight_row_setup(&s1,&uj,&form,&scale,row);
 }
 
 
-static inline void push_through(float u, float v, float t, int num_strips,
-                                one_jet_vec *val)
+static void push_through(float u, float t, figure_eight_row *row)
 {
   two_jet_vec s12;
   two_jet     uj, form, scale;
-  one_jet     vj;
 
   set_two_jet(u,1.0f,0.0f,&uj);
-  set_one_jet(v,0.0f,1.0f,&vj);
   scene12(&uj,t,&s12);
   ff_interp(&uj,&form);
   fs_interp(&uj,&scale);
-  add_figure_eight(&s12,&uj,&vj,&form,&scale,num_strips,val);
+  figure_eight_row_setup(&s12,&uj,&form,&scale,row);
 }
 
 
-static inline void twist(float u, float v, float t, int num_strips,
-                         one_jet_vec *val)
+static void twist(float u, float t, figure_eight_row *row)
 {
   two_jet_vec s23;
   two_jet     uj, form, scale;
-  one_jet     vj;
 
   set_two_jet(u,1.0f,0.0f,&uj);
-  set_one_jet(v,0.0f,1.0f,&vj);
   scene23(&uj,t,&s23);
   ff_interp(&uj,&form);
   fs_interp(&uj,&scale);
-  add_figure_eight(&s23,&uj,&vj,&form,&scale,num_strips,val);
+  figure_eight_row_setup(&s23,&uj,&form,&scale,row);
 }
 
 
-static inline void un_push(float u, float v, float t, int num_strips,
-                           one_jet_vec *val)
+static void un_push(float u, float t, figure_eight_row *row)
 {
   two_jet_vec s34;
   two_jet     uj, form, scale;
-  one_jet     vj;
 
   set_two_jet(u,1.0f,0.0f,&uj);
-  set_one_jet(v,0.0f,1.0f,&vj);
   scene34(&uj,t,&s34);
   ff_interp(&uj,&form);
   fs_interp(&uj,&scale);
-  add_figure_eight(&s34,&uj,&vj,&form,&scale,num_strips,val);
+  figure_eight_row_setup(&s34,&uj,&form,&scale,row);
 }
 
 
-static inline void un_corrugate(float u, float v, float t, int num_strips,
-                                one_jet_vec *val)
+static void un_corrugate(float u, float t, figure_eight_row *row)
 {
   two_jet_vec s4;
   two_jet     uj, form, scale, ui;
-  one_jet     vj;
 
   set_two_jet(u,1.0f,0.0f,&uj);
-  set_one_jet(v,0.0f,1.0f,&vj);
   stage4(&uj,&s4);
   ff_interp(&uj,&ui);
   mult_two_jet_float(&ui,1.0f-t,&form);
   fs_interp(&uj,&scale);
-  add_figure_eight(&s4,&uj,&vj,&form,&scale,num_strips,val);
+  figure_eight_row_setup(&s4,&uj,&form,&scale,row);
 }
 
 
@@ -1230,39 +1240,228 @@ static inline void gen_point_and_normal(one_jet_vec *p, float *point,
 }
 
 
+#if defined __GNUC__ || defined __clang__
+
+/* Use GCC/Clang's vector extensions to compute JET_LANES columns of a row
+   at once: each vfloat holds the same jet component of adjacent points.
+   The arithmetic is the same as in add_figure_eight and
+   gen_point_and_normal, in the same order, so the result is identical.
+   https://gcc.gnu.org/onlinedocs/gcc/Vector-Extensions.html
+ */
+# ifdef __AVX__
+#  define JET_LANES 8
+# else
+#  define JET_LANES 4
+# endif
+
+typedef float vfloat __attribute__((vector_size(JET_LANES*sizeof(float))));
+typedef int   vint   __attribute__((vector_size(JET_LANES*sizeof(int))));
+
+typedef struct {
+  vfloat f;
+  vfloat fu, fv;
+} one_jet_v;
+
+
+typedef struct {
+  one_jet_v sin_vv2, heights, heights_sqs, cos_vv_m1_xm2;
+  one_jet_v sin_vs, cos_vs;
+} figure_eight_cols_v;
+
+
+/* Scalar minus vector broadcasts the scalar; minus zero preserves -0. */
+static inline void broadcast_one_jet(const one_jet *x, one_jet_v *res)
+{
+  res->f = x->f - (vfloat) {0};
+  res->fu = x->fu - (vfloat) {0};
+  res->fv = x->fv - (vfloat) {0};
+}
+
+
+static inline void add_one_jets_v(const one_jet_v *x, const one_jet_v *y,
+                                  one_jet_v *res)
+{
+  res->f = x->f+y->f;
+  res->fu = x->fu+y->fu;
+  res->fv = x->fv+y->fv;
+}
+
+
+static inline void mult_one_jets_v(const one_jet_v *x, const one_jet_v *y,
+                                   one_jet_v *res)
+{
+  res->f = x->f*y->f;
+  res->fu = x->f*y->fu+x->fu*y->f;
+  res->fv = x->f*y->fv+x->fv*y->f;
+}
+
+
+/* Transpose JET_LANES consecutive columns into vectors. */
+static void figure_eight_cols_gather(const figure_eight_col *col,
+                                     figure_eight_cols_v *res)
+{
+  int i;
+# define GATHER(FIELD) \
+  res->FIELD.f[i] = col[i].FIELD.f; \
+  res->FIELD.fu[i] = col[i].FIELD.fu; \
+  res->FIELD.fv[i] = col[i].FIELD.fv
+
+  for (i=0; i<JET_LANES; i++)
+  {
+    GATHER(sin_vv2);
+    GATHER(heights);
+    GATHER(heights_sqs);
+    GATHER(cos_vv_m1_xm2);
+    GATHER(sin_vs);
+    GATHER(cos_vs);
+  }
+# undef GATHER
+}
+
+
+/* add_figure_eight followed by gen_point_and_normal, for JET_LANES points
+   of the same row.  'count' says how many of them to store. */
+static void add_figure_eight_v(const figure_eight_row *row,
+                               const figure_eight_cols_v *col, int count,
+                               float *points, float *normals)
+{
+  one_jet_v bend[3], h[3], w[3], po[3], hh[3], fe[3], popfe[3], res[3];
+  one_jet_v t1, t2, fo, omw, interp, vxc, vxs, vyc, vys;
+  vfloat    nx, ny, nz, s;
+  vint      nonzero;
+  int       i;
+
+  broadcast_one_jet(&row->bend.x,&bend[0]);
+  broadcast_one_jet(&row->bend.y,&bend[1]);
+  broadcast_one_jet(&row->bend.z,&bend[2]);
+  broadcast_one_jet(&row->h.x,&h[0]);
+  broadcast_one_jet(&row->h.y,&h[1]);
+  broadcast_one_jet(&row->h.z,&h[2]);
+  broadcast_one_jet(&row->w.x,&w[0]);
+  broadcast_one_jet(&row->w.y,&w[1]);
+  broadcast_one_jet(&row->w.z,&w[2]);
+  broadcast_one_jet(&row->po.x,&po[0]);
+  broadcast_one_jet(&row->po.y,&po[1]);
+  broadcast_one_jet(&row->po.z,&po[2]);
+  broadcast_one_jet(&row->fo,&fo);
+
+  /* interpolate_one_jets_float(cos_vv_m1_xm2,heights,fo) */
+  omw.f = -fo.f+1.0f;
+  omw.fu = -fo.fu;
+  omw.fv = -fo.fv;
+  mult_one_jets_v(&col->cos_vv_m1_xm2,&omw,&t1);
+  mult_one_jets_v(&col->heights,&fo,&t2);
+  add_one_jets_v(&t1,&t2,&interp);
+
+  for (i=0; i<3; i++)
+  {
+    mult_one_jets_v(&bend[i],&col->heights_sqs,&t1);
+    add_one_jets_v(&h[i],&t1,&hh[i]);
+    mult_one_jets_v(&w[i],&col->sin_vv2,&t1);
+    mult_one_jets_v(&hh[i],&interp,&t2);
+    add_one_jets_v(&t1,&t2,&fe[i]);
+    add_one_jets_v(&po[i],&fe[i],&popfe[i]);
+  }
+
+  /* rotate_one_jet_vec_z_sin_cos */
+  mult_one_jets_v(&popfe[0],&col->cos_vs,&vxc);
+  mult_one_jets_v(&popfe[1],&col->sin_vs,&vys);
+  add_one_jets_v(&vxc,&vys,&res[0]);
+  mult_one_jets_v(&popfe[0],&col->sin_vs,&vxs);
+  mult_one_jets_v(&popfe[1],&col->cos_vs,&vyc);
+  res[1].f = vyc.f-vxs.f;
+  res[1].fu = vyc.fu-vxs.fu;
+  res[1].fv = vyc.fv-vxs.fv;
+  res[2] = popfe[2];
+
+  /* gen_point_and_normal */
+  nx = res[1].fu*res[2].fv-res[2].fu*res[1].fv;
+  ny = res[2].fu*res[0].fv-res[0].fu*res[2].fv;
+  nz = res[0].fu*res[1].fv-res[1].fu*res[0].fv;
+  s = nx*nx+ny*ny+nz*nz;
+  nonzero = (s > 0.0f);
+  s = 1.0f/s;
+  for (i=0; i<JET_LANES; i++)
+    s[i] = nonzero[i] ? sqrtf(s[i]) : 0.0f;
+  nx = -nx*s;
+  ny = -ny*s;
+  nz = -nz*s;
+
+  for (i=0; i<count; i++)
+  {
+    points[3*i+0] = res[0].f[i];
+    points[3*i+1] = res[1].f[i];
+    points[3*i+2] = res[2].f[i];
+    normals[3*i+0] = nx[i];
+    normals[3*i+1] = ny[i];
+    normals[3*i+2] = nz[i];
+  }
+}
+
+#endif /* __GNUC__ || __clang__ */
+
+
 static inline void gen_surface(surface_time_function *func, float umin,
                                float umax, int ucount, float vmin,
                                float vmax, int vcount, float t,
                                float *points, float *normals, int num_strips)
 {
-  one_jet_vec val;
-  int         j, k, l;
-  float       u, v, delta_u, delta_v;
-  float       speedv;
-
-  if (ucount <= 0 || vcount <= 0)
+  figure_eight_row row;
+  one_jet_vec      val;
+  int              j, k, l;
+  float            u, delta_u, delta_v;
+  float            speedv;
+#ifdef JET_LANES
+  figure_eight_col cols[NUM_V+JET_LANES];
+  figure_eight_cols_v colv[(NUM_V+JET_LANES)/JET_LANES];
+#else
+  figure_eight_col cols[NUM_V+1];
+#endif
+
+  if (ucount <= 0 || vcount <= 0 || vcount > NUM_V)
     return;
 
   delta_u = (umax-umin)/ucount;
   delta_v = (vmax-vmin)/vcount;
 
+  for (k=0; k<=vcount; k++)
+    figure_eight_col_setup(vmin+k*delta_v,num_strips,&cols[k]);
+#ifdef JET_LANES
+  /* Pad the last group with copies; those points are not stored. */
+  for (; k % JET_LANES; k++)
+    cols[k] = cols[vcount];
+  for (k=0; k<=vcount; k+=JET_LANES)
+    figure_eight_cols_gather(&cols[k],&colv[k/JET_LANES]);
+#endif
+
   for (j=0; j<=ucount; j++)
   {
     u = umin+j*delta_u;
-    (*func)(u,0.0f,t,num_strips,&val);
+    (*func)(u,t,&row);
+    add_figure_eight(&row,&cols[0],&val);
     speedv = sqrtf(val.x.fv*val.x.fv+val.y.fv*val.y.fv+val.z.fv*val.z.fv);
     if (speedv == 0.0f)
     {
       /* Perturb a bit, hoping to avoid degeneracy */
       u += u < 1.0f ? FLT_EPSILON : -FLT_EPSILON;
+      (*func)(u,t,&row);
+    }
+#ifdef JET_LANES
+    for (k=0; k<=vcount; k+=JET_LANES)
+    {
+      l = 3*(j*(vcount+1)+k);
+      add_figure_eight_v(&row,&colv[k/JET_LANES],
+                         (vcount+1-k < JET_LANES ? vcount+1-k : JET_LANES),
+                         &points[l],&normals[l]);
     }
+#else  /* !JET_LANES */
     for (k=0; k<=vcount; k++)
     {
       l = 3*(j*(vcount+1)+k);
-      v = vmin+k*delta_v;
-      (*func)(u,v,t,num_strips,&val);
+      add_figure_eight(&row,&cols[k],&val);
       gen_point_and_normal(&val,&points[l],&normals[l]);
     }
+#endif /* !JET_LANES */
   }
 }
 
@@ -94,6 +94,12 @@ quite a bit worse when gridsize = 1.
 /* #define USE_FAST_SQRT_HACKISH */ /* 17.8 FPS/2873/4921/5395/O(lg(radius)) */
 #define USE_FAST_SQRT_BIGTABLE2 /* 26.1 FPS/156/2242/5386/O(radius^2) */
 
+/* Several pixels at a time, with GCC vector extensions: see
+   DEFINE_ROW_KERNEL. */
+#if defined USE_FAST_SQRT_BIGTABLE2 && (defined __GNUC__ || defined __clang__)
+# define USE_SIMD_ROW
+#endif
+
 #ifdef HAVE_DOUBLE_BUFFER_EXTENSION
 # include "xdbe.h"
 #endif /* HAVE_DOUBLE_BUFFER_EXTENSION */
@@ -206,6 +212,10 @@ struct inter_context {
 #endif
   int radius; /* Not always the same as the X resource. */
   double last_frame;
+#ifdef USE_SIMD_ROW
+  void (*add_source_row) (unsigned *, const unsigned *, int,
+                          int, int, int, int);
+#endif
 
   struct threadpool threadpool;
 
@@ -335,6 +345,68 @@ static double fast_inv_table(unsigned x)
 
 #endif
 
+/* With GCC vector extensions, each source's contribution to a row is
+   computed several pixels at a time.  The squared distance along a row is
+   a quadratic in i, so each lane carries its own running distance and its
+   own increment, and gets exactly the integer that the scalar loop would
+   have at that pixel.  FAST_TABLE becomes a compare and a select, and
+   distances beyond the radius are clamped to wave_height[radius], which is
+   0, so there is no branch.  The table lookups themselves are still one
+   per lane: a gather instruction isn't any faster at that.
+
+   On x86, the 8-lane AVX2 version is picked at run time if the CPU has it,
+   since distributions build for plain SSE2.  Rows are padded to a multiple
+   of MAX_ROW_LANES so that neither version needs a scalar tail.
+ */
+#ifdef USE_SIMD_ROW
+# define MAX_ROW_LANES 8
+
+# if (defined __x86_64__ || defined __i386__) && \
+     (defined __clang__ || __GNUC__ >= 5)
+#  define USE_AVX2_ROW
+# endif
+
+typedef int v4si __attribute__((vector_size(4*sizeof(int))));
+typedef int v8si __attribute__((vector_size(8*sizeof(int))));
+
+# define FAST_TABLE_OFFSET \
+  ((FAST_SQRT_CUTOFF << (FAST_SQRT_DISCARD_BITS2 - \
+    FAST_SQRT_DISCARD_BITS1)) - FAST_SQRT_CUTOFF)
+
+# define DEFINE_ROW_KERNEL(NAME, VTYPE, LANES, ATTR)			\
+static ATTR void							\
+NAME (unsigned *result_row, const unsigned *wave_height, int radius,	\
+      int n, int dist0, int ddist, int g)				\
+{									\
+  VTYPE d, step, t, m;							\
+  int i, l;								\
+  /* dist(i) = dist0 + i*ddist + g*g*i*(i+1) */			\
+  for (l = 0; l < LANES; l++) {						\
+    d[l] = dist0 + l*ddist + g*g*l*(l+1);				\
+    step[l] = LANES*ddist + g*g*(2*LANES*l + LANES*LANES + LANES);	\
+  }									\
+  for (i = 0; i < n; i += LANES) {					\
+    m = d < FAST_SQRT_CUTOFF;						\
+    t = ((m & (d >> FAST_SQRT_DISCARD_BITS1)) |			\
+         (~m & ((d + FAST_TABLE_OFFSET) >> FAST_SQRT_DISCARD_BITS2)));	\
+    m = t < radius;							\
+    t = (m & t) | (~m & radius);					\
+    for (l = 0; l < LANES; l++)						\
+      result_row[i+l] += wave_height[t[l]];				\
+    d += step;								\
+    step += 2*LANES*LANES*g*g;						\
+  }									\
+}
+
+DEFINE_ROW_KERNEL (add_source_row_4, v4si, 4, )
+# ifdef USE_AVX2_ROW
+DEFINE_ROW_KERNEL (add_source_row_8, v8si, 8, __attribute__((target("avx2"))))
+# endif
+
+#else  /* !USE_SIMD_ROW */
+# define MAX_ROW_LANES 1
+#endif /* !USE_SIMD_ROW */
+
 static void destroy_image(Display* dpy, struct inter_context* c)
 {
 #ifdef USE_XIMAGE
@@ -407,7 +479,9 @@ static int inter_thread_create(
   self->context = c;
   self->thread_id = id;
 
-  self->result_row = malloc(c->w_div_g * sizeof(unsigned));
+  self->result_row = malloc(((c->w_div_g + MAX_ROW_LANES - 1) /
+                             MAX_ROW_LANES) * MAX_ROW_LANES *
+                            sizeof(unsigned));
   if(!self->result_row)
     return ENOMEM;
 
@@ -446,11 +520,13 @@ static void inter_thread_run(void* self_raw)
 
   int i, j, k;
   unsigned result;
-  int dist1;
   int g = c->grid_size;
 
-  int dx, dy, g2 = 2 * g * g;
-  int px, py, px2g;
+  int dx, dy;
+  int px, py;
+#ifndef USE_SIMD_ROW
+  int dist1, g2 = 2 * g * g, px2g;
+#endif
 
   int dist0, ddist;
 
@@ -463,7 +539,9 @@ static void inter_thread_run(void* self_raw)
     px = g/2;
     py = j*g + px;
 
-    memset(self->result_row, 0, c->w_div_g * sizeof(unsigned));
+    memset(self->result_row, 0,
+           ((c->w_div_g + MAX_ROW_LANES - 1) / MAX_ROW_LANES) *
+           MAX_ROW_LANES * sizeof(unsigned));
 
     for(k = 0; k < c->count; k++) {
 
@@ -473,6 +551,10 @@ static void inter_thread_run(void* self_raw)
       dist0 = dx*dx + dy*dy;
       ddist = -2 * g * c->source[k].x;
 
+#ifdef USE_SIMD_ROW
+      c->add_source_row(self->result_row, c->wave_height, c->radius,
+                        c->w_div_g, dist0, ddist, g);
+#else  /* !USE_SIMD_ROW */
       /* px2g = g*(px*2 + g); */
       px2g = g2;
 
@@ -505,6 +587,7 @@ static void inter_thread_run(void* self_raw)
         dist0 += px2g + ddist;
         px2g += g2;
       }
+#endif /* !USE_SIMD_ROW */
     }
 
     for(i = 0; i < c->w_div_g; i++) {
@@ -828,7 +911,8 @@ static void inter_init(Display* dpy, Window win, struct inter_context* c)
 #endif
 
   if (c->radius < 1) c->radius = 1;
-  c->wave_height = calloc(c->radius, sizeof(unsigned));
+  /* One more than needed: wave_height[radius] stays 0. */
+  c->wave_height = calloc(c->radius + 1, sizeof(unsigned));
   check_no_mem(dpy, c, c->wave_height);
 
   for(i = 0; i < c->radius; i++) {
@@ -849,6 +933,15 @@ static void inter_init(Display* dpy, Window win, struct inter_context* c)
       ((max + max*cos(fi/(50.0 * scale))) / 2.0);
   }
 
+#ifdef USE_SIMD_ROW
+  c->add_source_row = add_source_row_4;
+# ifdef USE_AVX2_ROW
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    c->add_source_row = add_source_row_8;
+# endif
+#endif /* USE_SIMD_ROW */
+
   c->source = calloc(c->count, sizeof(struct inter_source));
   check_no_mem(dpy, c, c->source);
 
@@ -865,12 +958,6 @@ static void inter_init(Display* dpy, Window win, struct inter_context* c)
 #define source_y(c, i) \
   (c->h/2 + ((int)(cos(c->source[i].y_theta)*((float)c->h/2.0))))
 
-/*
- * This is somewhat suboptimal. Calculating the distance per-pixel is going to
- * be a lot slower than using now-ubiquitous SIMD CPU instructions to do four
- * or eight pixels at a time.
- */
-
 static unsigned long do_inter(struct inter_context* c)
 {
   int i;
@@ -0,0 +1,468 @@
+#!/usr/bin/perl -w
+# Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+#
+# Permission to use, copy, modify, distribute, and sell this software and its
+# documentation for any purpose is hereby granted without fee, provided that
+# the above copyright notice appear in all copies and that both that
+# copyright notice and this permission notice appear in supporting
+# documentation.  No representations are made about the suitability of this
+# software for any purpose.  It is provided "as is" without express or
+# implied warranty.
+#
+# Runs each hack on a private Xvfb with "-replay-seed 1 -virtual-clock
+# -frame-count N -profile FILE", which makes screenhack.c sample its stack
+# with SIGPROF, and turns those samples into flame graphs.  This is how you
+# find out where the time goes, in one hack or across all of them.
+#
+# For each hack this writes, into the output directory:
+#
+#   NAME.folded	one line per distinct stack, "main;draw;XPutPixel 123"
+#   NAME.svg	the same, drawn by flamegraph.pl, if that is on $PATH
+#
+# and for all of them together:
+#
+#   all.folded	every stack, with the hack's name as the outermost frame
+#   summary.txt	every function, by how much of the fleet's time it takes
+#
+# In the summary, each hack's samples count for the same amount in total,
+# so that a few slow hacks don't drown out everything else: "self" is the
+# average, over all of the hacks profiled, of the percentage of that hack's
+# time spent in the function itself, and "total" includes its callees.
+# Functions in utils/ that show up under many hacks are the ones to tune.
+#
+# The stacks are unwound with backtrace(), and the binaries must not be
+# stripped.  "make profile-hacks" rebuilds them with -g, so that the summary
+# also says which source file each function is in, and with
+# -fno-omit-frame-pointer, so that stacks through code without unwind
+# tables aren't cut short, before running this.
+#
+# Created: 19-Oct-2026.
+
+require 5;
+use strict;
+
+use File::Temp qw(tempdir);
+
+my $progname = $0; $progname =~ s@.*/@@g;
+my ($version) = ('$Revision: 1.1 $' =~ m/\s(\d[.\d]+)\s/s);
+
+my $verbose = 0;
+
+my $frame_count = 200;
+my $geometry    = '640x480';
+my $seed        = 1;
+my $timeout     = 60;	# seconds per hack
+my $top         = 30;	# lines of summary to print
+
+
+sub error($) {
+  my ($err) = @_;
+  print STDERR "$progname: $err\n";
+  exit 1;
+}
+
+
+# Start a private X server and return its display and pid.
+#
+sub start_xvfb() {
+  local $^F = 255;	# Don't close the pipe on exec.
+  pipe (my $r, my $w) || error ("pipe: $!");
+  my $pid = fork();
+  error ("fork: $!") unless defined ($pid);
+  if (! $pid) {
+    close ($r);
+    open (STDOUT, '>/dev/null');
+    open (STDERR, '>/dev/null') unless ($verbose > 1);
+    exec ('Xvfb', '-displayfd', fileno($w), '-screen', '0', '1024x768x24',
+          '-nolisten', 'tcp');
+    exit 1;
+  }
+  close ($w);
+  my $n = <$r>;
+  close ($r);
+  error ("unable to start Xvfb") unless (defined($n) && $n =~ m/^(\d+)/s);
+  my $dpy = ":$1";
+  print STDERR "$progname: started Xvfb on $dpy\n" if ($verbose);
+  return ($dpy, $pid);
+}
+
+
+sub find_exe($) {
+  my ($name) = @_;
+  foreach my $f ("./$name", "./glx/$name") {
+    return $f if (-x $f);
+  }
+  return undef;
+}
+
+
+# Runs the hack, and returns the name of the file its samples went to,
+# or undef.
+#
+sub run_hack($$$) {
+  my ($dpy, $exe, $file) = @_;
+  my @cmd = ($exe, '-window', '-geometry', $geometry,
+             '-replay-seed', $seed, '-virtual-clock',
+             '-frame-count', $frame_count, '-profile', $file);
+  print STDERR "$progname: " . join(' ', @cmd) . "\n" if ($verbose);
+
+  local $ENV{DISPLAY} = $dpy;
+  my $pid = fork();
+  error ("fork: $!") unless defined ($pid);
+  if (! $pid) {
+    open (STDOUT, '>/dev/null');
+    exec (@cmd);
+    exit 1;
+  }
+  eval {
+    local $SIG{ALRM} = sub { die "timeout\n" };
+    alarm ($timeout);
+    waitpid ($pid, 0);
+    alarm (0);
+  };
+  if ($@) {
+    # The samples are written by atexit(), so a killed hack leaves none.
+    kill ('TERM', $pid);
+    waitpid ($pid, 0);
+    print STDERR "$progname: $exe: timed out after $timeout seconds;" .
+      " try fewer --frames\n";
+    return undef;
+  }
+  return (-s $file ? $file : undef);
+}
+
+
+# Reads the output of "-profile": the process's memory map, and the stacks.
+#
+sub read_profile($) {
+  my ($file) = @_;
+  my @maps;
+  my @stacks;
+  my $total = 0;
+  open (my $in, '<', $file) || error ("$file: $!");
+  while (<$in>) {
+    if (m/^#/s) {
+    } elsif (m/^map ([\da-f]+)-([\da-f]+) \S+ ([\da-f]+) \S+ \d+ +(\/.*?)\s*$/s) {
+      push @maps, [ hex($1), hex($2), hex($3), $4 ];
+    } elsif (m/^map /s) {
+      # anonymous memory, [stack], [vdso] and so on
+    } elsif (m/^(\d+)((?: [\da-f]+)+)\s*$/s) {
+      my $count = $1;
+      my @addrs = map { hex($_) } split (' ', $2);
+      push @stacks, [ $count, @addrs ];
+      $total += $count;
+    } elsif (m/\S/s) {
+      error ("$file: unparsable: $_");
+    }
+  }
+  close $in;
+  return (\@maps, \@stacks, $total);
+}
+
+
+# Returns the PT_LOAD segments of an ELF file, as [ offset, vaddr, size ].
+#
+my %segments_cache;
+sub elf_segments($) {
+  my ($file) = @_;
+  return $segments_cache{$file} if defined ($segments_cache{$file});
+  my @segs;
+  if (open (my $in, '<:raw', $file)) {
+    my $hdr;
+    read ($in, $hdr, 64);
+    if (length($hdr) == 64 && substr($hdr, 0, 4) eq "\177ELF") {
+      my ($class, $data) = unpack ('x4 C C', $hdr);
+      my $e = ($data == 2 ? '>' : '<');
+      my ($phoff, $phentsize, $phnum);
+      if ($class == 2) {
+        ($phoff)             = unpack ("x32 Q$e", $hdr);
+        ($phentsize, $phnum) = unpack ("x54 S$e S$e", $hdr);
+      } else {
+        ($phoff)             = unpack ("x28 L$e", $hdr);
+        ($phentsize, $phnum) = unpack ("x42 S$e S$e", $hdr);
+      }
+      for (my $i = 0; $i < $phnum; $i++) {
+        my $ph;
+        seek ($in, $phoff + $i * $phentsize, 0);
+        last unless (read ($in, $ph, $phentsize) == $phentsize);
+        my ($type, $off, $vaddr, $size);
+        if ($class == 2) {
+          ($type, $off, $vaddr, $size) = unpack ("L$e x4 Q$e Q$e x8 x8 Q$e",
+                                                 $ph);
+        } else {
+          ($type, $off, $vaddr, $size) = unpack ("L$e L$e L$e x4 x4 L$e",
+                                                 $ph);
+        }
+        push @segs, [ $off, $vaddr, $size ] if ($type == 1);  # PT_LOAD
+      }
+    }
+    close $in;
+  }
+  $segments_cache{$file} = \@segs;
+  return \@segs;
+}
+
+
+# Turns a run-time address into a file and the address that file was
+# linked at, which is what addr2line wants.
+#
+sub file_addr($$) {
+  my ($maps, $addr) = @_;
+  foreach my $m (@$maps) {
+    my ($start, $end, $moff, $file) = @$m;
+    next unless ($addr >= $start && $addr < $end);
+    my $off = $addr - $start + $moff;
+    foreach my $s (@{elf_segments ($file)}) {
+      my ($soff, $vaddr, $size) = @$s;
+      return ($file, $off - $soff + $vaddr)
+        if ($off >= $soff && $off < $soff + $size);
+    }
+    return ($file, $off);
+  }
+  return (undef, $addr);
+}
+
+
+# Returns a map of every address in the stacks to "function" or
+# "function (file.c)".
+#
+sub symbolize($$) {
+  my ($maps, $stacks) = @_;
+
+  # Each address but the innermost is a return address, which may be the
+  # first instruction of the next line, or of the next function.
+  my %by_file;
+  my %where;
+  foreach my $s (@$stacks) {
+    my (undef, @addrs) = @$s;
+    for (my $i = 0; $i <= $#addrs; $i++) {
+      my $a = $addrs[$i] - ($i ? 1 : 0);
+      next if defined ($where{$a});
+      my ($file, $faddr) = file_addr ($maps, $a);
+      $where{$a} = [ $file, $faddr ];
+      $by_file{$file}->{$faddr} = 1 if defined ($file);
+    }
+  }
+
+  my %names;
+  foreach my $file (keys %by_file) {
+    my @addrs = sort { $a <=> $b } keys %{$by_file{$file}};
+    my $tmp = tempdir ("$progname.XXXXXX", TMPDIR => 1, CLEANUP => 1);
+    open (my $out, '>', "$tmp/addrs") || error ("$tmp/addrs: $!");
+    printf $out "%x\n", $_ foreach (@addrs);
+    close $out;
+
+    my @lines;
+    if (open (my $in, '-|', "addr2line -f -C -e '$file' < '$tmp/addrs'")) {
+      @lines = <$in>;
+      close $in;
+    }
+    my $lib = $file;
+    $lib =~ s@^.*/@@s;
+    for (my $i = 0; $i <= $#addrs; $i++) {
+      my $fn  = $lines[$i*2]   || '??';
+      my $src = $lines[$i*2+1] || '??';
+      chomp ($fn, $src);
+      $src =~ s@:.*$@@s;
+      $src =~ s@^.*/@@s;
+      my $name;
+      if ($fn eq '??') {
+        $name = sprintf ("%s+0x%x", $lib, $addrs[$i]);
+      } elsif ($src ne '??') {
+        $name = "$fn ($src)";
+      } else {
+        $name = "$fn ($lib)";
+      }
+      $names{$file}->{$addrs[$i]} = $name;
+    }
+  }
+
+  my %sym;
+  foreach my $s (@$stacks) {
+    my (undef, @addrs) = @$s;
+    for (my $i = 0; $i <= $#addrs; $i++) {
+      my $a = $addrs[$i] - ($i ? 1 : 0);
+      my ($file, $faddr) = @{$where{$a}};
+      $sym{$addrs[$i]} = ($file
+                          ? $names{$file}->{$faddr}
+                          : sprintf ("0x%x", $addrs[$i]));
+    }
+  }
+  return \%sym;
+}
+
+
+# Returns a map of "outermost;...;innermost" to sample count.
+#
+sub fold($$) {
+  my ($stacks, $sym) = @_;
+  my %folded;
+  foreach my $s (@$stacks) {
+    my ($count, @addrs) = @$s;
+    my @names = map { my $n = $sym->{$_}; $n =~ s/;/:/gs; $n }
+                reverse @addrs;
+    # Everything outside of main() is libc startup.
+    for (my $i = 0; $i <= $#names; $i++) {
+      next unless ($names[$i] =~ m/^main /s);
+      splice (@names, 0, $i);
+      last;
+    }
+    $folded{join (';', @names)} += $count;
+  }
+  return \%folded;
+}
+
+
+sub write_folded($$) {
+  my ($file, $folded) = @_;
+  open (my $out, '>', $file) || error ("$file: $!");
+  foreach my $k (sort keys %$folded) {
+    print $out "$k $folded->{$k}\n";
+  }
+  close $out || error ("$file: $!");
+}
+
+
+sub flamegraph($$$) {
+  my ($name, $folded, $svg) = @_;
+  foreach my $dir (split (/:/, $ENV{PATH} || '')) {
+    next unless (-x "$dir/flamegraph.pl");
+    system ("'$dir/flamegraph.pl' --title '$name' '$folded' > '$svg'");
+    return;
+  }
+}
+
+
+# Adds this hack's share of time, per function, to the fleet totals.
+#
+sub tally($$$$) {
+  my ($name, $folded, $total, $fleet) = @_;
+  my (%self, %incl);
+  foreach my $k (keys %$folded) {
+    my @names = split (/;/, $k);
+    my $count = $folded->{$k};
+    $self{$names[$#names]} += $count;
+    my %seen;
+    foreach my $n (@names) {
+      $incl{$n} += $count unless ($seen{$n}++);
+    }
+  }
+  foreach my $n (keys %incl) {
+    my $f = ($fleet->{$n} ||= { self => 0, incl => 0, hacks => [] });
+    $f->{self} += 100 * ($self{$n} || 0) / $total;
+    $f->{incl} += 100 * $incl{$n} / $total;
+    push @{$f->{hacks}}, $name;
+  }
+}
+
+
+sub write_summary($$$) {
+  my ($file, $fleet, $nhacks) = @_;
+  my @fns = sort { $fleet->{$b}->{self} <=> $fleet->{$a}->{self} ||
+                   $fleet->{$b}->{incl} <=> $fleet->{$a}->{incl} ||
+                   $a cmp $b }
+            keys %$fleet;
+  my @lines = (sprintf ("%d hacks\n\n%6s %6s %5s  %s\n",
+                        $nhacks, 'self%', 'total%', 'hacks', 'function'));
+  foreach my $n (@fns) {
+    my $f = $fleet->{$n};
+    push @lines, sprintf ("%6.2f %6.2f %5d  %s\n",
+                          $f->{self} / $nhacks, $f->{incl} / $nhacks,
+                          scalar (@{$f->{hacks}}), $n);
+  }
+  open (my $out, '>', $file) || error ("$file: $!");
+  print $out @lines;
+  close $out || error ("$file: $!");
+  print STDOUT @lines[0 .. ($#lines < $top ? $#lines : $top)];
+}
+
+
+sub profile_hack($$$$$) {
+  my ($dpy, $name, $tmp, $outdir, $fleet) = @_;
+
+  my $exe = find_exe ($name);
+  if (! $exe) {
+    print STDERR "$progname: $name: not built, skipped\n";
+    return undef;
+  }
+
+  my $prof = run_hack ($dpy, $exe, "$tmp/$name.prof");
+  if (! $prof) {
+    print STDERR "$progname: $name: no samples\n";
+    return undef;
+  }
+
+  my ($maps, $stacks, $total) = read_profile ($prof);
+  if (! $total) {
+    print STDERR "$progname: $name: no samples\n";
+    return undef;
+  }
+  my $folded = fold ($stacks, symbolize ($maps, $stacks));
+  write_folded ("$outdir/$name.folded", $folded);
+  flamegraph ($name, "$outdir/$name.folded", "$outdir/$name.svg");
+  tally ($name, $folded, $total, $fleet);
+  print STDERR "$progname: $name: $total samples\n";
+  return $folded;
+}
+
+
+sub usage() {
+  print STDERR "usage: $progname [--verbose] [--srcdir dir] [--output dir]" .
+    " [--frames N] [--top N] [hacks ...]\n";
+  exit 1;
+}
+
+sub main() {
+  my $srcdir = '.';
+  my $outdir = 'profile';
+  my @hacks = ();
+  while ($#ARGV >= 0) {
+    $_ = shift @ARGV;
+    if (m/^--?verbose$/) { $verbose++; }
+    elsif (m/^-v+$/) { $verbose += length($_)-1; }
+    elsif (m/^--?srcdir$/) { $srcdir = shift @ARGV || usage; }
+    elsif (m/^--?output$/) { $outdir = shift @ARGV || usage; }
+    elsif (m/^--?frames$/) { $frame_count = shift @ARGV || usage; }
+    elsif (m/^--?top$/) { $top = shift @ARGV || usage; }
+    elsif (m/^-./) { usage; }
+    else { push @hacks, $_; }
+  }
+
+  if (! @hacks) {
+    foreach my $f (sort glob ("$srcdir/config/*.xml")) {
+      $f =~ s@^.*/([^/]+)\.xml$@$1@s;
+      push @hacks, $f if (find_exe ($f));
+    }
+  }
+  error ("no hacks built") unless (@hacks);
+
+  mkdir ($outdir) unless (-d $outdir);
+  error ("$outdir: $!") unless (-d $outdir);
+  my $tmp = tempdir ("$progname.XXXXXX", TMPDIR => 1, CLEANUP => 1);
+
+  my ($dpy, $xvfb) = start_xvfb();
+  my %fleet;
+  my %all;
+  foreach my $name (@hacks) {
+    my $folded = profile_hack ($dpy, $name, $tmp, $outdir, \%fleet);
+    $all{$name} = $folded if ($folded);
+  }
+  kill ('TERM', $xvfb);
+  waitpid ($xvfb, 0);
+
+  error ("no samples from any hack") unless (%all);
+
+  open (my $out, '>', "$outdir/all.folded") ||
+    error ("$outdir/all.folded: $!");
+  foreach my $name (sort keys %all) {
+    my $f = $all{$name};
+    print $out "$name;$_ $f->{$_}\n" foreach (sort keys %$f);
+  }
+  close $out || error ("$outdir/all.folded: $!");
+  flamegraph ('all hacks', "$outdir/all.folded", "$outdir/all.svg");
+
+  write_summary ("$outdir/summary.txt", \%fleet, scalar (keys %all));
+  print STDERR "$progname: wrote $outdir/\n";
+}
+
+main();
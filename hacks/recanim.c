@@ -67,11 +67,6 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
-#undef gettimeofday  /* wrapped by recanim.h */
-#undef time
-#undef double_time
-extern double double_time(void);
-
 struct record_anim_state {
   Screen *screen;
   Window window;
@@ -83,6 +78,7 @@ struct record_anim_state {
   int secs_elapsed;
   int fade_frames;
   double start_time;
+  double virt_start_time;
   XImage *img;
 # ifdef USE_GL
   char *data2;
@@ -96,59 +92,6 @@ struct record_anim_state {
 };
 
 
-/* Some of the hacks set their timing based on the real-world wall clock,
-   so to make the animations record at a sensible speed, we need to slow
-   down that clock by discounting the time taken up by snapshotting and
-   saving the frame.
- */
-static double recanim_current_time = 0;
-
-void
-screenhack_record_anim_gettimeofday (struct timeval *tv
-# ifdef GETTIMEOFDAY_TWO_ARGS
-                                     , struct timezone *tz
-# endif
-                                     )
-{
-  /* recanim_current_time == 0 if we are not recording. */
-  double now = (recanim_current_time ? recanim_current_time : double_time());
-  tv->tv_sec  = (time_t) now;
-  tv->tv_usec = 1000000 * (now - tv->tv_sec);
-}
-
-time_t
-screenhack_record_anim_time (time_t *o)
-{
-  struct timeval tv;
-# ifdef GETTIMEOFDAY_TWO_ARGS
-  struct timezone tz;
-# endif
-  screenhack_record_anim_gettimeofday (&tv
-# ifdef GETTIMEOFDAY_TWO_ARGS
-                                       , &tz
-# endif
-                                       );
-  if (o) *o = tv.tv_sec;
-  return tv.tv_sec;
-}
-
-
-double
-screenhack_record_anim_double_time (void)
-{
-  struct timeval tv;
-# ifdef GETTIMEOFDAY_TWO_ARGS
-  struct timezone tz;
-# endif
-  screenhack_record_anim_gettimeofday (&tv
-# ifdef GETTIMEOFDAY_TWO_ARGS
-                                       , &tz
-# endif
-                                       );
-  return (tv.tv_sec + ((double) tv.tv_usec * 0.000001));
-}
-
-
 record_anim_state *
 screenhack_record_anim_init (Screen *screen, Window window, int target_frames)
 {
@@ -167,11 +110,18 @@ screenhack_record_anim_init (Screen *screen, Window window, int target_frames)
   st->screen = screen;
   st->window = window;
   st->target_frames = target_frames;
-  st->start_time = double_time();
+  st->start_time = real_double_time();
   st->frame_count = 0;
   st->fade_frames = st->fps * 1.5;
 
-  recanim_current_time = st->start_time;
+  /* Some of the hacks set their timing based on the real-world wall clock,
+     so to make the animations record at a sensible speed, we need to slow
+     down that clock by discounting the time taken up by snapshotting and
+     saving the frame.  If -virtual-clock already started it, keep it.
+   */
+  if (! virtual_clock_p())
+    virtual_clock_start (st->start_time);
+  st->virt_start_time = double_time();
 
   if (st->fade_frames >= (st->target_frames / 2) - st->fps)
     st->fade_frames = 0;
@@ -335,7 +285,7 @@ screenhack_record_anim (record_anim_state *st)
 
 # ifndef HAVE_JWXYZ		/* Put percent done in window title */
   {
-    double now     = double_time();
+    double now     = real_double_time();
     double dur     = st->target_frames / (double) st->fps;
     double ratio   = (st->frame_count + 1) / (double) st->target_frames;
     double encoded = dur * ratio;
@@ -386,7 +336,7 @@ screenhack_record_anim (record_anim_state *st)
     screenhack_record_anim_free (st);
 
   /* Report to screenhack that each frame took exactly 1/30th second. */
-  recanim_current_time += 1.0 / st->fps;
+  virtual_clock_advance (1.0 / st->fps);
 }
 
 
@@ -397,10 +347,10 @@ screenhack_record_anim_free (record_anim_state *st)
   Display *dpy = DisplayOfScreen (st->screen);
 # endif /* !USE_GL */
   struct stat s;
-  double real_end     = double_time();
-  double virt_end     = screenhack_record_anim_double_time();
+  double real_end     = real_double_time();
+  double virt_end     = double_time();
   double real_elapsed = real_end - st->start_time;
-  double virt_elapsed = virt_end - st->start_time;
+  double virt_elapsed = virt_end - st->virt_start_time;
   double video_dur    = st->frame_count / (double) st->fps;
 
 # ifdef USE_GL
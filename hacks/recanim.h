@@ -20,14 +20,4 @@ extern record_anim_state *screenhack_record_anim_init (Screen *, Window,
 extern void screenhack_record_anim (record_anim_state *);
 extern void screenhack_record_anim_free (record_anim_state *);
 
-extern time_t screenhack_record_anim_time (time_t *);
-extern void screenhack_record_anim_gettimeofday (struct timeval *
-# ifdef GETTIMEOFDAY_TWO_ARGS
-                                                 , struct timezone *
-# endif
-                                                 );
-#define time screenhack_record_anim_time
-#define gettimeofday screenhack_record_anim_gettimeofday
-#define double_time screenhack_record_anim_double_time
-
 #endif /* __XSCREENSAVER_RECORD_ANIM_H__ */
@@ -136,11 +136,19 @@
 #include "version.h"
 #include "vroot.h"
 #include "fps.h"
+#include "xbatch.h"
 
 #ifdef HAVE_RECORD_ANIM
 # include "recanim.h"
 #endif
 
+#if defined(HAVE_EXECINFO_H) && defined(HAVE_BACKTRACE)
+# define HAVE_PROFILER
+# include <execinfo.h>
+# include <signal.h>
+# include <sys/time.h>
+#endif
+
 #ifndef _XSCREENSAVER_VROOT_H_
 # error Error!  You have an old version of vroot.h!  Check -I args.
 #endif /* _XSCREENSAVER_VROOT_H_ */
@@ -162,10 +170,20 @@ const char *progname;   /* used by hacks in error messages */
 const char *progclass;  /* used by ../utils/resources.c */
 Bool mono_p;		/* used by hacks */
 
+/* Under -virtual-clock, time starts at the same moment in every run, and
+   each frame is assumed to take 1/30th second, as with -record-animation.
+ */
+#define VIRTUAL_CLOCK_EPOCH 1000000000.0  /* 2001-09-09 01:46:40 UTC */
+#define VIRTUAL_CLOCK_FPS   30
+
 #ifdef EXIT_AFTER
 static time_t exit_after;	/* Exit gracefully after N seconds */
 #endif
 
+static int frame_hash_count;	/* -frame-hash: frames to hash, then exit */
+static char *frame_dir;		/* -frame-dir: where to save them */
+static int frame_count;		/* -frame-count: frames to draw, then exit */
+
 static XrmOptionDescRec default_options [] = {
   { "-root",	".root",		XrmoptionNoArg, "True" },
   { "-window",	".root",		XrmoptionNoArg, "False" },
@@ -176,6 +194,12 @@ static XrmOptionDescRec default_options [] = {
   { "-window-id", ".windowID",		XrmoptionSepArg, 0 },
   { "-fps",	".doFPS",		XrmoptionNoArg, "True" },
   { "-no-fps",  ".doFPS",		XrmoptionNoArg, "False" },
+  { "-replay-seed", ".replaySeed",	XrmoptionSepArg, 0 },
+  { "-virtual-clock", ".virtualClock",	XrmoptionNoArg, "True" },
+  { "-frame-hash", ".frameHash",	XrmoptionSepArg, 0 },
+  { "-frame-dir", ".frameDir",		XrmoptionSepArg, 0 },
+  { "-frame-count", ".frameCount",	XrmoptionSepArg, 0 },
+  { "-profile",	".profile",		XrmoptionSepArg, 0 },
 
 # ifdef DEBUG_PAIR
   { "-pair",	".pair",		XrmoptionNoArg, "True" },
@@ -196,6 +220,12 @@ static char *default_defaults[] = {
   "*mono:		false",
   "*installColormap:	false",
   "*doFPS:		false",
+  "*replaySeed:		0",
+  "*virtualClock:	false",
+  "*frameHash:		0",
+  "*frameDir:		",
+  "*frameCount:		0",
+  "*profile:		",
   "*multiSample:	false",
   "*visualID:		default",
   "*windowID:		",
@@ -467,6 +497,68 @@ fix_fds (void)
 }
 
 
+/* Flow control.  This used to XSync after every frame, which waits for a
+   round trip to the X server: on a remote display, the hack spent most of
+   its time waiting on the network instead of computing the next frame.
+
+   Instead, at the end of each frame, append nothing to a property on a
+   window of our own.  The server sends a PropertyNotify when it gets that
+   far, and we only wait for the one from the frame before.  So the hack
+   computes frame N+1 while the server is still drawing frame N, but it
+   never gets more than one frame ahead of it.
+ */
+#define FRAMES_IN_FLIGHT 1
+
+static Window fence_window = 0;
+static Atom XA_SCREENHACK_FENCE;
+static unsigned long fences[FRAMES_IN_FLIGHT + 1];  /* request serials */
+static unsigned long fence_count = 0;
+
+static void
+fence_init (Display *dpy)
+{
+  XSetWindowAttributes attrs;
+  attrs.event_mask = PropertyChangeMask;
+  fence_window = XCreateWindow (dpy, DefaultRootWindow (dpy),
+                                -1, -1, 1, 1, 0, 0, InputOnly,
+                                CopyFromParent, CWEventMask, &attrs);
+  XA_SCREENHACK_FENCE = XInternAtom (dpy, "_SCREENHACK_FENCE", False);
+}
+
+
+static Bool
+fence_event_p (Display *dpy, XEvent *event, XPointer arg)
+{
+  unsigned long serial = *(unsigned long *) arg;
+  return (event->xany.type == PropertyNotify &&
+          event->xany.window == fence_window &&
+          (long) (event->xany.serial - serial) >= 0);
+}
+
+
+static void
+fence_frame (Display *dpy)
+{
+  unsigned long serial;
+  XEvent event;
+
+  fences[fence_count++ % countof(fences)] = NextRequest (dpy);
+  XChangeProperty (dpy, fence_window, XA_SCREENHACK_FENCE, XA_STRING, 8,
+                   PropModeAppend, (unsigned char *) "", 0);
+  XFlush (dpy);
+
+  if (fence_count <= FRAMES_IN_FLIGHT)
+    return;
+
+  /* If the hack made a round trip of its own since then, or discarded
+     events with XSync, there's nothing to wait for.  Otherwise block until
+     that frame's event arrives, leaving any others in the queue. */
+  serial = fences[fence_count % countof(fences)];
+  if ((long) (LastKnownRequestProcessed (dpy) - serial) < 0)
+    XIfEvent (dpy, &event, fence_event_p, (XPointer) &serial);
+}
+
+
 static Boolean
 screenhack_table_handle_events (Display *dpy,
                                 const struct xscreensaver_function_table *ft,
@@ -489,7 +581,9 @@ screenhack_table_handle_events (Display *dpy,
       XEvent event;
       XNextEvent (dpy, &event);
 
-      if (event.xany.type == ConfigureNotify)
+      if (event.xany.window == fence_window)
+        continue;
+      else if (event.xany.type == ConfigureNotify)
         {
           if (event.xany.window == window)
             ft->reshape_cb (dpy, window, closure,
@@ -540,13 +634,15 @@ usleep_and_process_events (Display *dpy,
 # endif
                            )
 {
+  fence_frame (dpy);
+
   do {
     unsigned long quantum = 33333;  /* 30 fps */
     if (quantum > delay) 
       quantum = delay;
     delay -= quantum;
 
-    XSync (dpy, False);
+    XFlush (dpy);
 
 #ifdef HAVE_RECORD_ANIM
     if (anim_state) screenhack_record_anim (anim_state);
@@ -581,6 +677,224 @@ screenhack_do_fps (Display *dpy, Window w, fps_state *fpst, void *closure)
 }
 
 
+/* For check-frames.pl: print a hash of the window's pixels, and with
+   -frame-dir, also save them as a PPM file.  The hash is FNV-1a over the
+   8-bit R, G and B of each pixel, so it does not depend on the byte order
+   or padding of the XImage.
+ */
+static void
+hash_frame (Display *dpy, Window window, int frame)
+{
+  XWindowAttributes xgwa;
+  XImage *image;
+  unsigned long masks[3];
+  int shifts[3], widths[3];
+  unsigned int hash = 2166136261U;
+  unsigned char *row;
+  FILE *out = 0;
+  int x, y, i;
+
+  XSync (dpy, False);
+  XGetWindowAttributes (dpy, window, &xgwa);
+  image = XGetImage (dpy, window, 0, 0, xgwa.width, xgwa.height,
+                     ~0L, ZPixmap);
+  if (!image)
+    {
+      fprintf (stderr, "%s: unable to read frame %d\n", progname, frame);
+      exit (1);
+    }
+
+  masks[0] = xgwa.visual->red_mask;
+  masks[1] = xgwa.visual->green_mask;
+  masks[2] = xgwa.visual->blue_mask;
+  for (i = 0; i < 3; i++)
+    {
+      unsigned long m = masks[i];
+      shifts[i] = widths[i] = 0;
+      if (!m) continue;
+      while (!(m & 1)) { m >>= 1; shifts[i]++; }
+      while (m & 1)    { m >>= 1; widths[i]++; }
+    }
+
+  if (frame_dir && *frame_dir)
+    {
+      char *file = (char *) malloc (strlen (frame_dir) + 20);
+      sprintf (file, "%s/%04d.ppm", frame_dir, frame);
+      out = fopen (file, "wb");
+      if (!out)
+        {
+          perror (file);
+          exit (1);
+        }
+      fprintf (out, "P6\n%d %d\n255\n", image->width, image->height);
+      free (file);
+    }
+
+  row = (unsigned char *) malloc (image->width * 3);
+  for (y = 0; y < image->height; y++)
+    {
+      unsigned char *o = row;
+      for (x = 0; x < image->width; x++)
+        {
+          unsigned long p = XGetPixel (image, x, y);
+          for (i = 0; i < 3; i++)
+            {
+              unsigned long c;
+              if (widths[i])		/* TrueColor */
+                {
+                  c = (p & masks[i]) >> shifts[i];
+                  c = (c * 255) / ((1UL << widths[i]) - 1);
+                }
+              else			/* Raw pixel value */
+                c = (p >> (i * 8)) & 0xFF;
+              *o++ = c;
+              hash = (hash ^ c) * 16777619U;
+            }
+        }
+      if (out) fwrite (row, 3, image->width, out);
+    }
+  free (row);
+  XDestroyImage (image);
+
+  if (out) fclose (out);
+  fprintf (stdout, "%04d %08x\n", frame, hash);
+  fflush (stdout);
+}
+
+
+#ifdef HAVE_PROFILER
+
+/* For profile-hacks.pl: with -profile FILE, sample the stack of whichever
+   thread is on the CPU a thousand times per CPU-second, and on exit write
+   each distinct stack and its count to FILE.  The stacks are raw addresses,
+   so the file also gets a copy of /proc/self/maps, for the script to find
+   which library each one is in and hand it to addr2line.
+ */
+# define PROFILE_HZ      1000
+# define PROFILE_DEPTH   63
+# define PROFILE_SAMPLES 20000		/* 20 CPU-seconds */
+
+static char *profile_file;
+static void **profile_buf;	/* depth and frames, for each sample */
+static int profile_count;
+
+static void
+profile_sample (int sig)
+{
+  int i;
+# if defined __GNUC__ || defined __clang__
+  i = __sync_fetch_and_add (&profile_count, 1);
+# else
+  i = profile_count++;
+# endif
+  if (i < PROFILE_SAMPLES)
+    {
+      void **s = profile_buf + i * (PROFILE_DEPTH + 1);
+      s[0] = (void *) (size_t) backtrace (s + 1, PROFILE_DEPTH);
+    }
+}
+
+
+static int
+profile_cmp (const void *a, const void *b)
+{
+  void **sa = *(void ***) a;
+  void **sb = *(void ***) b;
+  size_t na = (size_t) sa[0];
+  size_t nb = (size_t) sb[0];
+  if (na != nb) return (na < nb ? -1 : 1);
+  return memcmp (sa + 1, sb + 1, na * sizeof(*sa));
+}
+
+
+static void
+profile_write (void)
+{
+  struct itimerval t;
+  FILE *out, *maps;
+  void ***order;
+  char buf[1024];
+  int i, j, k, n;
+
+  memset (&t, 0, sizeof(t));
+  setitimer (ITIMER_PROF, &t, 0);
+  n = (profile_count < PROFILE_SAMPLES ? profile_count : PROFILE_SAMPLES);
+
+  out = fopen (profile_file, "w");
+  if (!out)
+    {
+      perror (profile_file);
+      return;
+    }
+  fprintf (out, "# %s: %d samples at %d Hz\n", progname, n, PROFILE_HZ);
+
+  maps = fopen ("/proc/self/maps", "r");
+  if (maps)
+    {
+      while (fgets (buf, sizeof(buf), maps))
+        fprintf (out, "map %s", buf);
+      fclose (maps);
+    }
+
+  order = (void ***) malloc (n * sizeof(*order));
+  if (n && !order) abort();
+  for (i = 0; i < n; i++)
+    order[i] = profile_buf + i * (PROFILE_DEPTH + 1);
+  qsort (order, n, sizeof(*order), profile_cmp);
+
+  /* "count addr addr ...", innermost first.  Frames 0 and 1 are
+     profile_sample and the signal trampoline. */
+  for (i = 0; i < n; i = j)
+    {
+      void **s = order[i];
+      int depth = (int) (size_t) s[0];
+      for (j = i + 1; j < n && !profile_cmp (&order[i], &order[j]); j++)
+        ;
+      if (depth <= 2) continue;
+      fprintf (out, "%d", j - i);
+      for (k = 2; k < depth; k++)
+        fprintf (out, " %lx", (unsigned long) s[k+1]);
+      fprintf (out, "\n");
+    }
+
+  free (order);
+  if (fclose (out))
+    perror (profile_file);
+}
+
+
+static void
+profile_start (void)
+{
+  struct sigaction sa;
+  struct itimerval t;
+  void *frames[2];
+
+  profile_buf = (void **) calloc (PROFILE_SAMPLES * (PROFILE_DEPTH + 1),
+                                  sizeof(*profile_buf));
+  if (!profile_buf) abort();
+
+  /* The first call may load libgcc, which must not happen in the handler. */
+  backtrace (frames, countof(frames));
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sa_handler = profile_sample;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGPROF, &sa, 0);
+
+  /* Hacks that call exit() get profiled too. */
+  atexit (profile_write);
+
+  t.it_interval.tv_sec = 0;
+  t.it_interval.tv_usec = 1000000 / PROFILE_HZ;
+  t.it_value = t.it_interval;
+  setitimer (ITIMER_PROF, &t, 0);
+}
+
+#endif /* HAVE_PROFILER */
+
+
 static void
 run_screenhack_table (Display *dpy, 
                       Window window,
@@ -605,6 +919,7 @@ run_screenhack_table (Display *dpy,
   void *closure = init_cb (dpy, window, ft->setup_arg);
   fps_state *fpst = fps_init (dpy, window);
   unsigned long delay = 0;
+  int frame = 0;
 
 #ifdef DEBUG_PAIR
   void *closure2 = 0;
@@ -638,10 +953,28 @@ run_screenhack_table (Display *dpy,
       if (window2) delay2 = ft->draw_cb (dpy, window2, closure2);
 #endif
 
+      /* Whatever the hack drew into an xbatch goes out before the FPS. */
+      xbatch_flush_all ();
+
       if (fpst) fps_cb (dpy, window, fpst, closure);
 #ifdef DEBUG_PAIR
       if (fpst2) fps_cb (dpy, window2, fpst2, closure2);
 #endif
+
+      frame++;
+      if (frame_hash_count > 0)
+        {
+          hash_frame (dpy, window, frame);
+          if (frame >= frame_hash_count)
+            break;
+        }
+      if (frame_count > 0 && frame >= frame_count)
+        break;
+
+#ifdef HAVE_RECORD_ANIM
+      if (! anim_state)  /* recanim advances it itself */
+#endif
+        virtual_clock_advance (1.0 / VIRTUAL_CLOCK_FPS);
     }
 
 #ifdef HAVE_RECORD_ANIM
@@ -821,6 +1154,7 @@ main (int argc, char **argv)
   XA_WM_DELETE_WINDOW = XInternAtom (dpy, "WM_DELETE_WINDOW", False);
   XA_NET_WM_PID = XInternAtom (dpy, "_NET_WM_PID", False);
   XA_NET_WM_PING = XInternAtom (dpy, "_NET_WM_PING", False);
+  fence_init (dpy);
 
   {
     char *v = (char *) strdup(strchr(screensaver_id, ' '));
@@ -927,6 +1261,13 @@ main (int argc, char **argv)
 
   root_p = get_boolean_resource (dpy, "root", "Boolean");
 
+  if (get_boolean_resource (dpy, "virtualClock", "Boolean"))
+    virtual_clock_start (VIRTUAL_CLOCK_EPOCH);
+
+  frame_hash_count = get_integer_resource (dpy, "frameHash", "Integer");
+  frame_dir = get_string_resource (dpy, "frameDir", "Directory");
+  frame_count = get_integer_resource (dpy, "frameCount", "Integer");
+
 # ifdef EXIT_AFTER
   {
     int secs = get_integer_resource (dpy, "exitAfter", "Integer");
@@ -1023,9 +1364,13 @@ main (int argc, char **argv)
 
   /* This is the one and only place that the random-number generator is
      seeded in any screenhack.  You do not need to seed the RNG again,
-     it is done for you before your code is invoked. */
+     it is done for you before your code is invoked.
+
+     With "-replay-seed N -virtual-clock", two runs of the same hack do
+     exactly the same work, frame for frame, for benchmarking.
+   */
 # undef ya_rand_init
-  ya_rand_init (0);
+  ya_rand_init (get_integer_resource (dpy, "replaySeed", "ReplaySeed"));
 
 
 #ifdef HAVE_RECORD_ANIM
@@ -1079,6 +1424,22 @@ main (int argc, char **argv)
   }
 #endif
 
+  {
+    char *s = get_string_resource (dpy, "profile", "Profile");
+    if (s && *s)
+      {
+# ifdef HAVE_PROFILER
+        profile_file = s;
+        s = 0;
+        profile_start ();
+# else
+        fprintf (stderr, "%s: -profile is not supported on this system\n",
+                 progname);
+# endif
+      }
+    if (s) free (s);
+  }
+
   run_screenhack_table (dpy, window, 
 # ifdef DEBUG_PAIR
                         window2,
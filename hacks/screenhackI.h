@@ -177,11 +177,21 @@
 #include "fps.h"
 #include "xft.h"
 #include "font-retry.h"
+#include "doubletime.h"
 
 #ifdef HAVE_RECORD_ANIM
 # include "recanim.h"
 #endif
 
+#ifndef HAVE_JWXYZ
+  /* With -virtual-clock or -record-animation, the clock only advances
+     once per frame, so that runs are repeatable.  See doubletime.h. */
+# undef time
+# define time(T) virtual_clock_time(T)
+# undef gettimeofday
+# define gettimeofday virtual_clock_gettimeofday
+#endif /* !HAVE_JWXYZ */
+
 #undef countof
 #define countof(x) (sizeof((x))/sizeof((*x)))
 
@@ -12,6 +12,7 @@
 #include "screenhack.h"
 #include "colors.h"
 #include "erase.h"
+#include "xbatch.h"
 #include "yarandom.h"
 
 #define R(x)  (random()%x)
@@ -41,6 +42,7 @@ struct state {
    int ncolors;
    GC draw_gc, erase_gc;
    XColor colors[NCOLORSMAX];
+   xbatch *batch;
 
    int delay;
 
@@ -56,8 +58,11 @@ struct state {
 };
 
 #define CLEAR1(x,y) (!st->fill[((y)%st->height)*st->width+(x)%st->width])
+/* No two worms ever fill the same cell in one frame, so the order in which
+   the cells are drawn doesn't matter, and they can all go out at once. */
 #define MOVE1(x,y) (st->fill[((y)%st->height)*st->width+(x)%st->width]=1, \
-                    XFillRectangle (st->dpy, st->window, st->draw_gc,   \
+                    xbatch_fill_rectangle (st->batch, st->draw_gc,      \
+                                    st->colors[w->c].pixel,             \
                                     ((x) % st->width)  * st->scale,     \
                                     ((y) % st->height) * st->scale,     \
                                     st->scale, st->scale),              \
@@ -67,8 +72,7 @@ struct state {
 #define MOVEDXY(x,y,dx,dy)  MOVE1 (x+dx, y+dy), MOVE1 (x+dx+dx, y+dy+dy)
 
 #define CLEAR(d) CLEARDXY(w->h,w->v, st->dirh[d],st->dirv[d])
-#define MOVE(d) (XSetForeground(st->dpy, st->draw_gc, st->colors[w->c].pixel), \
-                  MOVEDXY(w->h,w->v, st->dirh[d],st->dirv[d]), \
+#define MOVE(d) (MOVEDXY(w->h,w->v, st->dirh[d],st->dirv[d]), \
 		  w->h=w->h+st->dirh[d]*2, \
 		  w->v=w->v+st->dirv[d]*2, dir=d)
 
@@ -170,6 +174,7 @@ squiral_init (Display *dpy, Window window)
     st->draw_gc = XCreateGC(st->dpy, st->window, GCForeground, &gcv);
     gcv.foreground = get_pixel_resource (st->dpy, cmap, "background", "Background");
     st->erase_gc = XCreateGC (st->dpy, st->window, GCForeground, &gcv);
+    st->batch = xbatch_init (st->dpy, st->window);
     cmap = xgwa.colormap;
     if( st->ncolors ) {
         free_colors(xgwa.screen, cmap, st->colors, st->ncolors);
@@ -295,6 +300,7 @@ squiral_free (Display *dpy, Window window, void *closure)
     free_colors (st->xgwa.screen, st->xgwa.cmap, st->colors, st->ncolors); */
   XFreeGC (dpy, st->draw_gc);
   XFreeGC (dpy, st->erase_gc);
+  xbatch_free (st->batch);
   free (st);
 }
 
@@ -16,6 +16,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>   /* for sysconf() */
+#endif
+
+/* The jwxyz loaders call into Cocoa or Java, which we only do from the
+   main thread; everywhere else, decode batches of images in parallel.
+   That uses pthreads directly rather than thread_util.c, because most of
+   the hacks that link this file don't link thread_util.o, and would all
+   have had to start doing so just for this. */
+#if HAVE_PTHREAD && !defined(HAVE_JWXYZ)
+# define DECODE_THREADS
+# include <pthread.h>
+#endif
 
 #if defined(HAVE_GDK_PIXBUF) || defined(HAVE_COCOA) || defined(HAVE_ANDROID)
 # undef HAVE_LIBPNG
@@ -472,6 +487,156 @@ make_ximage (Display *dpy, Visual *visual,
 #endif /* no loaders */
 
 
+/* Textures are upside down, so invert XImages before returning them.
+ */
+static void
+flip_ximage (XImage *ximage)
+{
+  char *data2, *in, *out;
+  int y;
+
+  if (!ximage) return;
+  data2 = malloc (ximage->bytes_per_line * ximage->height);
+  if (!data2) abort();
+  in = ximage->data;
+  out = data2 + ximage->bytes_per_line * (ximage->height - 1);
+  for (y = 0; y < ximage->height; y++)
+    {
+      memcpy (out, in, ximage->bytes_per_line);
+      in  += ximage->bytes_per_line;
+      out -= ximage->bytes_per_line;
+    }
+  free (ximage->data);
+  ximage->data = data2;
+}
+
+
+/* Images that utils/png2c has already decoded begin with this instead of
+   a PNG signature.  See that script for the format.
+ */
+static const unsigned char packed_signature[8] = {
+  0211, 'X', 'S', 'I', '\r', '\n', 032, '\n' };
+
+static Bool
+packed_image_p (const unsigned char *data, unsigned long size)
+{
+  return (data && size >= 16 &&
+          !memcmp (data, packed_signature, sizeof(packed_signature)));
+}
+
+
+/* Unpacks it to an XImage just like the one make_ximage would have made
+   from the original PNG, upside down if flip_p.
+ */
+static XImage *
+make_packed_ximage (Display *dpy, Visual *visual,
+                    const unsigned char *data, unsigned long size,
+                    Bool flip_p)
+{
+  const unsigned char *in = data + 8, *end = data + size;
+  unsigned long w = (((unsigned long) in[0] << 24) | (in[1] << 16) |
+                     (in[2] << 8) | in[3]);
+  unsigned long h = (((unsigned long) in[4] << 24) | (in[5] << 16) |
+                     (in[6] << 8) | in[7]);
+  Bool swap_p = bigendian();
+  XImage *image;
+  long stride;
+  unsigned long y;
+  char *row;
+
+  if (w == 0 || h == 0 || w > 0x8000 || h > 0x8000)
+    goto FAIL;
+  in += 8;
+
+  image = XCreateImage (dpy, visual, 32, ZPixmap, 0, 0, w, h, 32, 0);
+  image->bitmap_bit_order =
+    image->byte_order =
+      (swap_p ? MSBFirst : LSBFirst);
+  image->data = (char *) malloc (h * image->bytes_per_line);
+  if (!image->data)
+    {
+      fprintf (stderr, "%s: out of memory (%lu x %lu)\n", progname, w, h);
+      XDestroyImage (image);
+      return 0;
+    }
+
+  stride = (flip_p ? -image->bytes_per_line : image->bytes_per_line);
+  row = image->data + (flip_p ? (h-1) * image->bytes_per_line : 0);
+
+  for (y = 0; y < h; y++, row += stride)
+    {
+      uint32_t *out = (uint32_t *) row;
+      uint32_t *above = (uint32_t *) (row - stride);
+      unsigned long x = 0;
+      while (x < w)
+        {
+          unsigned long i, n;
+          unsigned char c;
+          if (in >= end) goto FAIL2;
+          c = *in++;
+          if (c < 64)			/* literal pixels */
+            {
+              n = c + 1;
+              if (n > w - x || n * 4 > (unsigned long) (end - in)) goto FAIL2;
+              if (swap_p)
+                for (i = 0; i < n; i++, in += 4)
+                  out[x+i] = (((uint32_t) in[3] << 24) | (in[2] << 16) |
+                              (in[1] << 8) | in[0]);
+              else
+                {
+                  /* Already A<<24|B<<16|G<<8|R, like make_ximage makes. */
+                  memcpy (out + x, in, n * 4);
+                  in += n * 4;
+                }
+            }
+          else if (c < 128)		/* one pixel, repeated */
+            {
+              uint32_t p;
+              n = c - 63;
+              if (n > w - x || end - in < 4) goto FAIL2;
+              p = (((uint32_t) in[3] << 24) | (in[2] << 16) |
+                   (in[1] << 8) | in[0]);
+              in += 4;
+              for (i = 0; i < n; i++)
+                out[x+i] = p;
+            }
+          else				/* same as the row above */
+            {
+              n = c - 127;
+              if (n > w - x || y == 0) goto FAIL2;
+              memcpy (out + x, above + x, n * 4);
+            }
+          x += n;
+        }
+    }
+
+  return image;
+
+ FAIL2:
+  XDestroyImage (image);
+ FAIL:
+  fprintf (stderr, "%s: corrupted packed image\n", progname);
+  return 0;
+}
+
+
+/* Either a file, or image data that might be packed.
+ */
+static XImage *
+load_ximage (Display *dpy, Visual *visual, const char *filename,
+             const unsigned char *image_data, unsigned long data_size,
+             Bool flip_p)
+{
+  XImage *image;
+  if (!filename && packed_image_p (image_data, data_size))
+    return make_packed_ximage (dpy, visual, image_data, data_size, flip_p);
+  image = make_ximage (dpy, visual, filename, image_data, data_size);
+  if (flip_p)
+    flip_ximage (image);
+  return image;
+}
+
+
 /* Given a bitmask, returns the position and width of the field.
  */
 static void
@@ -522,7 +687,8 @@ make_pixmap (Display *dpy, Window window,
 
   XGetWindowAttributes (dpy, window, &xgwa);
 
-  in = make_ximage (dpy, xgwa.visual, filename, image_data, data_size);
+  in = load_ximage (dpy, xgwa.visual, filename, image_data, data_size,
+                    False);
   if (!in) return 0;
 
   /* Create a new image in the depth and bit-order of the server. */
@@ -610,30 +776,6 @@ make_pixmap (Display *dpy, Window window,
 }
 
 
-/* Textures are upside down, so invert XImages before returning them.
- */
-static void
-flip_ximage (XImage *ximage)
-{
-  char *data2, *in, *out;
-  int y;
-
-  if (!ximage) return;
-  data2 = malloc (ximage->bytes_per_line * ximage->height);
-  if (!data2) abort();
-  in = ximage->data;
-  out = data2 + ximage->bytes_per_line * (ximage->height - 1);
-  for (y = 0; y < ximage->height; y++)
-    {
-      memcpy (out, in, ximage->bytes_per_line);
-      in  += ximage->bytes_per_line;
-      out -= ximage->bytes_per_line;
-    }
-  free (ximage->data);
-  ximage->data = data2;
-}
-
-
 Pixmap
 image_data_to_pixmap (Display *dpy, Window window, 
                       const unsigned char *image_data, unsigned long data_size,
@@ -664,15 +806,186 @@ image_data_to_ximage (Display *dpy, Visual *visual,
                       const unsigned char *image_data,
                       unsigned long data_size)
 {
-  XImage *ximage = make_ximage (dpy, visual, 0, image_data, data_size);
-  flip_ximage (ximage);
-  return ximage;
+  ximage_request req;
+  memset (&req, 0, sizeof(req));
+  req.image_data = image_data;
+  req.data_size  = data_size;
+  ximages_load (dpy, visual, &req, 1);
+  return req.image;
 }
 
 XImage *
 file_to_ximage (Display *dpy, Visual *visual, const char *filename)
 {
-  XImage *ximage = make_ximage (dpy, visual, filename, 0, 0);
-  flip_ximage (ximage);
-  return ximage;
+  ximage_request req;
+  memset (&req, 0, sizeof(req));
+  req.filename = filename;
+  ximages_load (dpy, visual, &req, 1);
+  return req.image;
+}
+
+
+/* Decoding many images at once.
+ */
+
+#define MAX_DECODE_THREADS 32
+
+struct ximage_loader {
+  Display *dpy;
+  Visual *visual;
+  ximage_request *reqs;
+  int count;
+  int next;		/* index of the next request nobody has started */
+  char *done;		/* which requests are finished */
+# ifdef DECODE_THREADS
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_t threads[MAX_DECODE_THREADS];
+  int nthreads;
+# endif
+};
+
+
+static void
+decode_request (ximage_loader *L, ximage_request *req)
+{
+  req->image = load_ximage (L->dpy, L->visual, req->filename,
+                            req->image_data, req->data_size, True);
+}
+
+
+#ifdef DECODE_THREADS
+
+/* Each thread takes the next undecoded request until there are none left.
+   Files vary a lot in size, so this balances better than handing each
+   thread a fixed share.
+ */
+static void *
+decode_thread (void *closure)
+{
+  ximage_loader *L = (ximage_loader *) closure;
+  while (1)
+    {
+      int i;
+      pthread_mutex_lock (&L->mutex);
+      i = L->next++;
+      pthread_mutex_unlock (&L->mutex);
+      if (i >= L->count) break;
+
+      decode_request (L, &L->reqs[i]);
+
+      pthread_mutex_lock (&L->mutex);
+      L->done[i] = 1;
+      pthread_cond_broadcast (&L->cond);
+      pthread_mutex_unlock (&L->mutex);
+    }
+  return 0;
+}
+
+
+static int
+decode_thread_count (int count)
+{
+  long ncpus = 1;
+# ifdef _SC_NPROCESSORS_ONLN
+  ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+# endif
+  if (ncpus > count) ncpus = count;
+  if (ncpus > MAX_DECODE_THREADS) ncpus = MAX_DECODE_THREADS;
+  if (ncpus < 1) ncpus = 1;
+  return ncpus;
+}
+
+#endif /* DECODE_THREADS */
+
+
+ximage_loader *
+ximages_load_start (Display *dpy, Visual *visual,
+                    ximage_request *reqs, int count)
+{
+  ximage_loader *L = (ximage_loader *) calloc (1, sizeof(*L));
+  if (!L) abort();
+  L->dpy    = dpy;
+  L->visual = visual;
+  L->reqs   = reqs;
+  L->count  = count;
+  L->done   = (char *) calloc (count + 1, 1);
+  if (!L->done) abort();
+  if (count <= 0) return L;
+
+  /* Do the first one on this thread, so that the loader's one-time setup
+     (e.g., gdk_pixbuf_xlib_init) has happened before any other thread can
+     get there. */
+  decode_request (L, &reqs[0]);
+  L->done[0] = 1;
+  L->next = 1;
+
+# ifdef DECODE_THREADS
+  if (count > 1)
+    {
+      int i, n = decode_thread_count (count - 1);
+      pthread_mutex_init (&L->mutex, 0);
+      pthread_cond_init (&L->cond, 0);
+      for (i = 0; i < n; i++)
+        {
+          if (pthread_create (&L->threads[i], 0, decode_thread, L))
+            break;
+          L->nthreads++;
+        }
+      if (L->nthreads)
+        return L;
+      pthread_cond_destroy (&L->cond);
+      pthread_mutex_destroy (&L->mutex);
+    }
+# endif /* DECODE_THREADS */
+
+  /* No threads: just do them all now. */
+  for (; L->next < count; L->next++)
+    {
+      decode_request (L, &reqs[L->next]);
+      L->done[L->next] = 1;
+    }
+  return L;
+}
+
+
+XImage *
+ximages_load_wait (ximage_loader *L, int i)
+{
+  if (i < 0 || i >= L->count) abort();
+# ifdef DECODE_THREADS
+  if (L->nthreads)
+    {
+      pthread_mutex_lock (&L->mutex);
+      while (! L->done[i])
+        pthread_cond_wait (&L->cond, &L->mutex);
+      pthread_mutex_unlock (&L->mutex);
+    }
+# endif
+  return L->reqs[i].image;
+}
+
+
+void
+ximages_load_finish (ximage_loader *L)
+{
+# ifdef DECODE_THREADS
+  if (L->nthreads)
+    {
+      int i;
+      for (i = 0; i < L->nthreads; i++)
+        pthread_join (L->threads[i], 0);
+      pthread_cond_destroy (&L->cond);
+      pthread_mutex_destroy (&L->mutex);
+    }
+# endif
+  free (L->done);
+  free (L);
+}
+
+
+void
+ximages_load (Display *dpy, Visual *visual, ximage_request *reqs, int count)
+{
+  ximages_load_finish (ximages_load_start (dpy, visual, reqs, count));
 }
@@ -27,6 +27,9 @@ extern Pixmap image_data_to_pixmap (Display *, Window,
    Also it is upside down: the origin is at the bottom left of the image.
    X11 typically expects 0RGB as it has no notion of alpha, only 1-bit masks.
    With X11 code, you should probably use the _pixmap routines instead.
+
+   The image_data may be a PNG, or a PNG already unpacked by utils/png2c,
+   which is how the headers in images/gen/ are made.
  */
 extern XImage *image_data_to_ximage (Display *, Visual *,
                                      const unsigned char *image_data,
@@ -34,4 +37,30 @@ extern XImage *image_data_to_ximage (Display *, Visual *,
 
 extern XImage *file_to_ximage (Display *, Visual *, const char *filename);
 
+/* To decode many images at once, on as many threads as there are CPUs:
+   fill in either 'filename', or 'image_data' and 'data_size', of each
+   request, and call ximages_load.  Afterward, each 'image' is what
+   file_to_ximage or image_data_to_ximage would have returned for it.
+
+   Or call ximages_load_start, which returns once the decoding is under
+   way; ximages_load_wait, which returns request N's image as soon as that
+   one is done; and ximages_load_finish, after which all of them are done
+   and the loader is freed.  Don't touch the requests until then.
+ */
+typedef struct {
+  const char *filename;
+  const unsigned char *image_data;
+  unsigned long data_size;
+  XImage *image;
+} ximage_request;
+
+typedef struct ximage_loader ximage_loader;
+
+extern void ximages_load (Display *, Visual *, ximage_request *, int count);
+
+extern ximage_loader *ximages_load_start (Display *, Visual *,
+                                          ximage_request *, int count);
+extern XImage *ximages_load_wait (ximage_loader *, int n);
+extern void ximages_load_finish (ximage_loader *);
+
 #endif /* _XIMAGE_LOADER_H_ */
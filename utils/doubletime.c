@@ -12,9 +12,14 @@
 #include "utils.h"
 #include "doubletime.h"
 #include <sys/time.h>
+#include <time.h>
+
+/* Seconds since the epoch, or 0 if the virtual clock is not running. */
+static double virtual_now = 0;
+
 
 double
-double_time (void)
+real_double_time (void)
 {
   struct timeval now;
 # ifdef GETTIMEOFDAY_TWO_ARGS
@@ -26,3 +31,62 @@ double_time (void)
 
   return (now.tv_sec + ((double) now.tv_usec * 0.000001));
 }
+
+
+double
+double_time (void)
+{
+  return (virtual_now ? virtual_now : real_double_time());
+}
+
+
+void
+virtual_clock_start (double when)
+{
+  virtual_now = when;
+}
+
+
+void
+virtual_clock_advance (double secs)
+{
+  if (virtual_now)
+    virtual_now += secs;
+}
+
+
+int
+virtual_clock_p (void)
+{
+  return (virtual_now != 0);
+}
+
+
+int
+virtual_clock_gettimeofday (struct timeval *tv
+# ifdef GETTIMEOFDAY_TWO_ARGS
+                            , struct timezone *tz
+# endif
+                            )
+{
+  double now;
+  if (! virtual_now)
+    return gettimeofday (tv
+# ifdef GETTIMEOFDAY_TWO_ARGS
+                         , tz
+# endif
+                         );
+  now = virtual_now;
+  tv->tv_sec  = (time_t) now;
+  tv->tv_usec = 1000000 * (now - tv->tv_sec);
+  return 0;
+}
+
+
+time_t
+virtual_clock_time (time_t *o)
+{
+  time_t now = (virtual_now ? (time_t) virtual_now : time ((time_t *) 0));
+  if (o) *o = now;
+  return now;
+}
@@ -12,7 +12,30 @@
 #ifndef __DOUBLETIME_H__
 #define __DOUBLETIME_H__
 
-/* Current time as a double, with (probably) microsecond accuracy. */
+#include <sys/time.h>
+
+/* Current time as a double, with (probably) microsecond accuracy.
+   If the virtual clock is running, this is the virtual clock instead. */
 extern double double_time (void);
 
+/* The wall clock, even if the virtual clock is running. */
+extern double real_double_time (void);
+
+/* The virtual clock does not advance on its own: it only moves when
+   virtual_clock_advance() is called, e.g. once per frame.  screenhackI.h
+   redirects time() and gettimeofday() to the functions below, so while it
+   is running, every clock a screenhack can look at reports the same thing.
+   Starting it at 0 stops it.
+ */
+extern void virtual_clock_start (double when);
+extern void virtual_clock_advance (double secs);
+extern int virtual_clock_p (void);
+
+extern time_t virtual_clock_time (time_t *);
+extern int virtual_clock_gettimeofday (struct timeval *
+# ifdef GETTIMEOFDAY_TWO_ARGS
+                                       , struct timezone *
+# endif
+                                       );
+
 #endif /* __DOUBLETIME_H__ */
@@ -56,6 +56,20 @@
 
    The reason there are two defines is that if HAVE_XFT is not defined,
    the Xft API is still available through emulation provided by "xft.h".
+
+
+   Finding a font is expensive: XftFontMatch has fontconfig sort the whole
+   system font set against the pattern, and on a machine with thousands of
+   fonts installed, that takes tens of milliseconds.  Xft caches the fonts
+   themselves, but not the matching.  So with real Xft, we also keep:
+
+   - A pool of the most recently used fonts, keyed by the name or list
+     that was asked for, holding a reference to each.  Opening a name
+     that is in the pool just takes another reference with XftFontCopy,
+     so callers still close their fonts with XftFontClose.
+
+   - The list of every font on the system, made once per process, for
+     programs like fontglide that want to pick fonts at random.
  */
 
 #define _GNU_SOURCE  /* Why is this here? */
@@ -81,6 +95,11 @@ extern const char *progname;
 static void xft_selftest (Display *dpy, int screen);
 #endif
 
+#if defined(HAVE_XFT) && !defined(HAVE_JWXYZ)
+# define USE_FONT_POOL
+# define FONT_POOL_SIZE 16
+#endif
+
 
 /* Parse font names of the form "Helvetica Neue Bold Italic 12".
  */
@@ -253,6 +272,107 @@ xlfd_substituted_p (XftFont *f, const char *xlfd)
 #endif /* USE_XFT */
 
 
+#ifdef USE_FONT_POOL
+
+typedef struct font_pool_entry font_pool_entry;
+struct font_pool_entry {
+  Display *dpy;
+  int screen;
+  char *name;
+  XftFont *font;		/* We hold one reference to this. */
+  font_pool_entry *next;	/* Most recently used first. */
+};
+
+static font_pool_entry *font_pool = 0;
+
+
+/* Returns a new reference to the pooled font of that name, or 0.
+ */
+static XftFont *
+font_pool_find (Display *dpy, int screen, const char *name)
+{
+  font_pool_entry *e, *prev = 0;
+  for (e = font_pool; e; prev = e, e = e->next)
+    if (e->dpy == dpy && e->screen == screen && !strcmp (e->name, name))
+      {
+        if (prev)		/* Move to front */
+          {
+            prev->next = e->next;
+            e->next = font_pool;
+            font_pool = e;
+          }
+#  ifdef DEBUG
+        fprintf (stderr, "%s: XFT: pooled \"%s\"\n", progname, name);
+#  endif
+        return XftFontCopy (dpy, e->font);
+      }
+  return 0;
+}
+
+
+/* Remembers the font under that name, closing the least recently used
+   one if the pool is full.
+ */
+static void
+font_pool_add (Display *dpy, int screen, const char *name, XftFont *font)
+{
+  font_pool_entry *e = (font_pool_entry *) calloc (1, sizeof(*e));
+  int i;
+  if (!e) return;
+  e->dpy    = dpy;
+  e->screen = screen;
+  e->name   = strdup (name);
+  e->font   = XftFontCopy (dpy, font);
+  e->next   = font_pool;
+  font_pool = e;
+
+  for (i = 0; e->next; i++, e = e->next)
+    if (i == FONT_POOL_SIZE - 1)
+      {
+        font_pool_entry *e2 = e->next;
+        e->next = e2->next;
+        XftFontClose (e2->dpy, e2->font);
+        free (e2->name);
+        free (e2);
+        break;
+      }
+}
+
+
+XftFont *
+open_xft_font_cached (Display *dpy, int screen, const char *name)
+{
+  XftFont *f = font_pool_find (dpy, screen, name);
+  if (f) return f;
+  f = XftFontOpenName (dpy, screen, name);
+  if (f) font_pool_add (dpy, screen, name, f);
+  return f;
+}
+
+
+XftFontSet *
+xft_font_catalogue (Display *dpy, int screen)
+{
+  /* This is never freed: XftFontSetDestroy is FcFontSetDestroy, which
+     would mean linking with fontconfig directly. */
+  static XftFontSet *fs = 0;
+  if (!fs)
+    fs = XftListFonts (dpy, screen,
+                       /* Pattern-triples to match, followed by a NULL */
+                       NULL,
+                       /* Properties to return, followed by a second NULL */
+                       XFT_FAMILY,
+                       XFT_STYLE,
+                       XFT_SLANT,
+                       XFT_WEIGHT,
+                       XFT_SIZE,
+                       NULL);
+  return fs;
+}
+
+#endif /* USE_FONT_POOL */
+
+
 static void *
 load_font_retry_1 (Display *dpy, int screen, const char *font_list, Bool xft_p)
 {
@@ -283,6 +403,14 @@ load_font_retry_1 (Display *dpy, int screen, const char *font_list, Bool xft_p)
 
   if (! font_list) font_list = "<null>";
 
+# ifdef USE_FONT_POOL
+  if (xft_p)
+    {
+      f = font_pool_find (dpy, screen, font_list);
+      if (f) return f;
+    }
+# endif
+
   /* Treat the string as a comma-separated list of font names.
      Names are XLFDs or the XScreenSaver syntax described above.
      Try to load each of them in order.
@@ -392,6 +520,11 @@ load_font_retry_1 (Display *dpy, int screen, const char *font_list, Bool xft_p)
 #  endif /* USE_XFT && HAVE_XFT */
 # endif /* DEBUG */
 
+# ifdef USE_FONT_POOL
+  if (xft_p)
+    font_pool_add (dpy, screen, font_list, (XftFont *) f);
+# endif
+
    if (fallback) UNLOADFONT (fallback);
    if (font_name) free (font_name);
   return f;
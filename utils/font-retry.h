@@ -23,6 +23,18 @@ extern XFontStruct *load_font_retry (Display *, const char *font_list);
 # ifdef __XSCREENSAVER_XFT_H__  /* if xft.h has been included */
 extern XftFont *load_xft_font_retry (Display *, int screen,
                                      const char *font_list);
+
+#  if defined(HAVE_XFT) && !defined(HAVE_JWXYZ)
+/* Like XftFontOpenName, except that recently opened names are reused
+   without asking fontconfig to match them again.  Close the font with
+   XftFontClose as usual. */
+extern XftFont *open_xft_font_cached (Display *, int screen,
+                                      const char *name);
+
+/* Every font on the system, with family, style, slant, weight and size.
+   This is only listed once per process; do not free it. */
+extern XftFontSet *xft_font_catalogue (Display *, int screen);
+#  endif /* HAVE_XFT && !HAVE_JWXYZ */
 # endif
 
 #endif /* __FONT_RETRY_H__ */
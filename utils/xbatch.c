@@ -0,0 +1,329 @@
+/* xbatch.c --- draw many small primitives in few X requests.
+ * Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ */
+
+#include "utils.h"
+#include "xbatch.h"
+
+enum { POINTS, SEGMENTS, RECTANGLES, FILL_RECTANGLES, FILL_ARCS };
+
+static const size_t element_size[] = {
+  sizeof(XPoint), sizeof(XSegment), sizeof(XRectangle), sizeof(XRectangle),
+  sizeof(XArc)
+};
+
+typedef struct {
+  GC gc;
+  unsigned long pixel;
+  int kind;
+  void *data;		/* XPoint, XSegment, XRectangle or XArc */
+  int count, size;
+} bucket;
+
+/* Buckets are kept, empty, after a flush, since the next frame will most
+   likely use the same ones; unless there have come to be this many. */
+#define MAX_IDLE_BUCKETS 256
+
+struct xbatch {
+  Display *dpy;
+  Drawable drawable;
+  bucket *buckets;
+  int nbuckets, buckets_size;
+  int *index;		/* open hash of bucket number + 1, or 0 */
+  int index_size;	/* a power of 2, at least twice nbuckets */
+  int last;		/* the bucket that was added to most recently */
+  xbatch *next;
+};
+
+static xbatch *all_batches = 0;
+
+
+xbatch *
+xbatch_init (Display *dpy, Drawable d)
+{
+  xbatch *b = (xbatch *) calloc (1, sizeof(*b));
+  xbatch **tail;
+  if (!b) abort();
+  b->dpy = dpy;
+  b->drawable = d;
+  b->last = -1;
+  for (tail = &all_batches; *tail; tail = &(*tail)->next)
+    ;
+  *tail = b;
+  return b;
+}
+
+
+static void
+clear_buckets (xbatch *b)
+{
+  int i;
+  for (i = 0; i < b->nbuckets; i++)
+    free (b->buckets[i].data);
+  b->nbuckets = 0;
+  b->last = -1;
+  if (b->index)
+    memset (b->index, 0, b->index_size * sizeof(*b->index));
+}
+
+
+void
+xbatch_free (xbatch *b)
+{
+  xbatch **p;
+  for (p = &all_batches; *p; p = &(*p)->next)
+    if (*p == b)
+      {
+        *p = b->next;
+        break;
+      }
+  clear_buckets (b);
+  free (b->buckets);
+  free (b->index);
+  free (b);
+}
+
+
+static unsigned int
+bucket_hash (GC gc, unsigned long pixel, int kind)
+{
+  unsigned long h = (unsigned long) gc;
+  h = (h ^ (h >> 7)) * 31 + pixel;
+  h = h * 8 + kind;
+  return (unsigned int) (h * 2654435761UL) ^ (unsigned int) (h >> 16);
+}
+
+
+static void
+index_bucket (xbatch *b, int n)
+{
+  bucket *k = &b->buckets[n];
+  unsigned int mask = b->index_size - 1;
+  unsigned int i = bucket_hash (k->gc, k->pixel, k->kind) & mask;
+  while (b->index[i])
+    i = (i + 1) & mask;
+  b->index[i] = n + 1;
+}
+
+
+/* Returns the bucket for this GC, color and kind, making it if need be. */
+static bucket *
+find_bucket (xbatch *b, GC gc, unsigned long pixel, int kind)
+{
+  unsigned int mask, i;
+  bucket *k;
+  int n, j;
+
+  /* Usually it's the same as last time. */
+  if (b->last >= 0)
+    {
+      k = &b->buckets[b->last];
+      if (k->gc == gc && k->pixel == pixel && k->kind == kind)
+        return k;
+    }
+
+  if (b->index_size)
+    {
+      mask = b->index_size - 1;
+      for (i = bucket_hash (gc, pixel, kind) & mask;
+           b->index[i];
+           i = (i + 1) & mask)
+        {
+          n = b->index[i] - 1;
+          k = &b->buckets[n];
+          if (k->gc == gc && k->pixel == pixel && k->kind == kind)
+            {
+              b->last = n;
+              return k;
+            }
+        }
+    }
+
+  if (b->nbuckets >= b->buckets_size)
+    {
+      b->buckets_size = (b->buckets_size ? b->buckets_size * 2 : 16);
+      b->buckets = (bucket *)
+        realloc (b->buckets, b->buckets_size * sizeof(*b->buckets));
+      if (!b->buckets) abort();
+    }
+
+  n = b->nbuckets++;
+  k = &b->buckets[n];
+  memset (k, 0, sizeof(*k));
+  k->gc = gc;
+  k->pixel = pixel;
+  k->kind = kind;
+
+  if (b->nbuckets * 2 > b->index_size)
+    {
+      b->index_size = (b->index_size ? b->index_size * 2 : 64);
+      free (b->index);
+      b->index = (int *) calloc (b->index_size, sizeof(*b->index));
+      if (!b->index) abort();
+      for (j = 0; j < b->nbuckets; j++)
+        index_bucket (b, j);
+    }
+  else
+    index_bucket (b, n);
+
+  b->last = n;
+  return k;
+}
+
+
+/* Returns room for one more element in the bucket. */
+static void *
+add (xbatch *b, GC gc, unsigned long pixel, int kind)
+{
+  bucket *k = find_bucket (b, gc, pixel, kind);
+  if (k->count >= k->size)
+    {
+      k->size = (k->size ? k->size * 2 : 64);
+      k->data = realloc (k->data, k->size * element_size[kind]);
+      if (!k->data) abort();
+    }
+  return (char *) k->data + element_size[kind] * k->count++;
+}
+
+
+/* jwxyz draws in this process, so there is nothing to be saved by waiting,
+   and no main loop to flush at the end of the frame. */
+#ifdef HAVE_JWXYZ
+# define DONE(b) xbatch_flush (b)
+#else
+# define DONE(b)
+#endif
+
+
+void
+xbatch_point (xbatch *b, GC gc, unsigned long pixel, int x, int y)
+{
+  XPoint *p = (XPoint *) add (b, gc, pixel, POINTS);
+  p->x = x;
+  p->y = y;
+  DONE (b);
+}
+
+
+void
+xbatch_line (xbatch *b, GC gc, unsigned long pixel,
+             int x1, int y1, int x2, int y2)
+{
+  XSegment *s = (XSegment *) add (b, gc, pixel, SEGMENTS);
+  s->x1 = x1;
+  s->y1 = y1;
+  s->x2 = x2;
+  s->y2 = y2;
+  DONE (b);
+}
+
+
+void
+xbatch_rectangle (xbatch *b, GC gc, unsigned long pixel,
+                  int x, int y, unsigned int w, unsigned int h)
+{
+  XRectangle *r = (XRectangle *) add (b, gc, pixel, RECTANGLES);
+  r->x = x;
+  r->y = y;
+  r->width = w;
+  r->height = h;
+  DONE (b);
+}
+
+
+void
+xbatch_fill_rectangle (xbatch *b, GC gc, unsigned long pixel,
+                       int x, int y, unsigned int w, unsigned int h)
+{
+  XRectangle *r = (XRectangle *) add (b, gc, pixel, FILL_RECTANGLES);
+  r->x = x;
+  r->y = y;
+  r->width = w;
+  r->height = h;
+  DONE (b);
+}
+
+
+void
+xbatch_fill_arc (xbatch *b, GC gc, unsigned long pixel,
+                 int x, int y, unsigned int w, unsigned int h,
+                 int angle1, int angle2)
+{
+  XArc *a = (XArc *) add (b, gc, pixel, FILL_ARCS);
+  a->x = x;
+  a->y = y;
+  a->width = w;
+  a->height = h;
+  a->angle1 = angle1;
+  a->angle2 = angle2;
+  DONE (b);
+}
+
+
+void
+xbatch_flush (xbatch *b)
+{
+  Display *dpy = b->dpy;
+  Drawable d = b->drawable;
+  int i;
+
+  /* Xlib splits these into as many requests as the server's maximum
+     request size needs. */
+  for (i = 0; i < b->nbuckets; i++)
+    {
+      bucket *k = &b->buckets[i];
+      if (! k->count) continue;
+      XSetForeground (dpy, k->gc, k->pixel);
+      switch (k->kind) {
+      case POINTS:
+        XDrawPoints (dpy, d, k->gc, (XPoint *) k->data, k->count,
+                     CoordModeOrigin);
+        break;
+      case SEGMENTS:
+        XDrawSegments (dpy, d, k->gc, (XSegment *) k->data, k->count);
+        break;
+      case RECTANGLES:
+# ifdef HAVE_JWXYZ	/* which has no XDrawRectangles */
+        {
+          XRectangle *r = (XRectangle *) k->data;
+          int j;
+          for (j = 0; j < k->count; j++)
+            XDrawRectangle (dpy, d, k->gc, r[j].x, r[j].y,
+                            r[j].width, r[j].height);
+        }
+# else
+        XDrawRectangles (dpy, d, k->gc, (XRectangle *) k->data, k->count);
+# endif
+        break;
+      case FILL_RECTANGLES:
+        XFillRectangles (dpy, d, k->gc, (XRectangle *) k->data, k->count);
+        break;
+      case FILL_ARCS:
+        XFillArcs (dpy, d, k->gc, (XArc *) k->data, k->count);
+        break;
+      default:
+        abort();
+      }
+      k->count = 0;
+    }
+
+  if (b->nbuckets > MAX_IDLE_BUCKETS)
+    clear_buckets (b);
+}
+
+
+void
+xbatch_flush_all (void)
+{
+  xbatch *b;
+  for (b = all_batches; b; b = b->next)
+    xbatch_flush (b);
+}
@@ -0,0 +1,61 @@
+/* xbatch.c --- draw many small primitives in few X requests.
+ * Copyright © 2026 Jamie Zawinski <jwz@jwz.org>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  No representations are made about the suitability of this
+ * software for any purpose.  It is provided "as is" without express or
+ * implied warranty.
+ *
+ * Xlib already merges consecutive XDrawLine or XFillRectangle calls into
+ * one request, but only until the GC changes: a hack that does
+ * XSetForeground before each primitive sends two requests per primitive,
+ * and over a remote connection the number of requests is what limits the
+ * frame rate.
+ *
+ * Instead, hand the primitives and their colors to an xbatch.  It sorts
+ * them into one bucket per GC, color and kind of primitive, and at the end
+ * of the frame sends each bucket as a single XDrawSegments, XFillRectangles
+ * and so on, after an XSetForeground of its color.
+ *
+ * So the order in which primitives are drawn is lost.  That is only right
+ * if none of them overlap, or if the ones that do overlap are the same
+ * color.  If some must be drawn before others, call xbatch_flush in
+ * between, or put them in two batches: batches are flushed in the order in
+ * which they were created.  Also call xbatch_flush before drawing anything
+ * else that must come after them, e.g. XCopyArea.
+ *
+ * The screenhack main loop flushes every batch after each frame, so a hack
+ * that doesn't care about order needs no other changes.  It leaves each
+ * GC's foreground set to whatever color was drawn with it last.
+ */
+
+#ifndef __XSCREENSAVER_XBATCH_H__
+#define __XSCREENSAVER_XBATCH_H__
+
+typedef struct xbatch xbatch;
+
+extern xbatch *xbatch_init (Display *, Drawable);
+extern void xbatch_free (xbatch *);
+
+extern void xbatch_point (xbatch *, GC, unsigned long pixel, int x, int y);
+extern void xbatch_line (xbatch *, GC, unsigned long pixel,
+                         int x1, int y1, int x2, int y2);
+extern void xbatch_rectangle (xbatch *, GC, unsigned long pixel,
+                              int x, int y, unsigned int w, unsigned int h);
+extern void xbatch_fill_rectangle (xbatch *, GC, unsigned long pixel,
+                                   int x, int y,
+                                   unsigned int w, unsigned int h);
+extern void xbatch_fill_arc (xbatch *, GC, unsigned long pixel,
+                             int x, int y, unsigned int w, unsigned int h,
+                             int angle1, int angle2);
+
+/* Sends everything drawn into this batch so far. */
+extern void xbatch_flush (xbatch *);
+
+/* Flushes every batch, in the order they were created. */
+extern void xbatch_flush_all (void);
+
+#endif /* __XSCREENSAVER_XBATCH_H__ */
@@ -58,6 +58,7 @@
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>  /* for getpid() */
 #endif
+#include <string.h>   /* for memcpy() */
 #include <sys/time.h> /* for gettimeofday() */
 
 #include "yarandom.h"
@@ -70,19 +71,21 @@
    skipped. The high order digit was taken mod 4.
  */
 #define VectorSize 55
-static unsigned int a[VectorSize] = {
- 035340171546, 010401501101, 022364657325, 024130436022, 002167303062, /*  5 */
- 037570375137, 037210607110, 016272055420, 023011770546, 017143426366, /* 10 */
- 014753657433, 021657231332, 023553406142, 004236526362, 010365611275, /* 14 */
- 007117336710, 011051276551, 002362132524, 001011540233, 012162531646, /* 20 */
- 007056762337, 006631245521, 014164542224, 032633236305, 023342700176, /* 25 */
- 002433062234, 015257225043, 026762051606, 000742573230, 005366042132, /* 30 */
- 012126416411, 000520471171, 000725646277, 020116577576, 025765742604, /* 35 */
- 007633473735, 015674255275, 017555634041, 006503154145, 021576344247, /* 40 */
- 014577627653, 002707523333, 034146376720, 030060227734, 013765414060, /* 45 */
- 036072251540, 007255221037, 024364674123, 006200353166, 010126373326, /* 50 */
- 015664104320, 016401041535, 016215305520, 033115351014, 017411670323  /* 55 */
-};
+#define INITIAL_VECTOR { \
+ 035340171546, 010401501101, 022364657325, 024130436022, 002167303062, /*  5 */ \
+ 037570375137, 037210607110, 016272055420, 023011770546, 017143426366, /* 10 */ \
+ 014753657433, 021657231332, 023553406142, 004236526362, 010365611275, /* 14 */ \
+ 007117336710, 011051276551, 002362132524, 001011540233, 012162531646, /* 20 */ \
+ 007056762337, 006631245521, 014164542224, 032633236305, 023342700176, /* 25 */ \
+ 002433062234, 015257225043, 026762051606, 000742573230, 005366042132, /* 30 */ \
+ 012126416411, 000520471171, 000725646277, 020116577576, 025765742604, /* 35 */ \
+ 007633473735, 015674255275, 017555634041, 006503154145, 021576344247, /* 40 */ \
+ 014577627653, 002707523333, 034146376720, 030060227734, 013765414060, /* 45 */ \
+ 036072251540, 007255221037, 024364674123, 006200353166, 010126373326, /* 50 */ \
+ 015664104320, 016401041535, 016215305520, 033115351014, 017411670323  /* 55 */ \
+}
+static const unsigned int a_init[VectorSize] = INITIAL_VECTOR;
+static unsigned int a[VectorSize] = INITIAL_VECTOR;
 
 static int i1, i2;
 
@@ -123,6 +126,10 @@ ya_rand_init(unsigned int seed)
       seed += (1003 * (unsigned int) getpid());
       seed = ROT (seed, 13);
     }
+  else
+    /* A given seed always yields the same sequence, even if the generator
+       has already been seeded or used, for -replay-seed. */
+    memcpy (a, a_init, sizeof(a));
 
   a[0] += seed;
   for (i = 1; i < VectorSize; i++)
@@ -137,3 +144,112 @@ ya_rand_init(unsigned int seed)
   i1 = a[0] % VectorSize;
   i2 = (i1 + 24) % VectorSize;
 }
+
+
+/* xoshiro128++ by David Blackman and Sebastiano Vigna, 2019.
+   https://prng.di.unimi.it/xoshiro128plusplus.c
+   Four words of state, a period of 2^128-1, and a jump function, which
+   the lagged generator above doesn't have.
+ */
+
+#define ROTL(X,N) (((X) << (N)) | ((X) >> (32 - (N))))
+
+#define XOSHIRO_STEP(S, RET) do {		\
+    unsigned int _t = (S)[1] << 9;		\
+    (RET) = ROTL ((S)[0] + (S)[3], 7) + (S)[0];	\
+    (S)[2] ^= (S)[0];				\
+    (S)[3] ^= (S)[1];				\
+    (S)[1] ^= (S)[2];				\
+    (S)[0] ^= (S)[3];				\
+    (S)[2] ^= _t;				\
+    (S)[3] = ROTL ((S)[3], 11);			\
+  } while (0)
+
+
+unsigned int
+ya_rng_random (ya_rng *r)
+{
+  unsigned int ret;
+  XOSHIRO_STEP (r->s, ret);
+  return ret;
+}
+
+
+void
+ya_rng_init (ya_rng *r, unsigned int seed)
+{
+  int i;
+  if (seed == 0)
+    seed = ya_random();
+
+  /* Spread the seed over the state with splitmix32, since xoshiro
+     must not start out all zero, and does poorly with mostly-zero. */
+  for (i = 0; i < 4; i++)
+    {
+      unsigned int z = (seed += 0x9E3779B9);
+      z = (z ^ (z >> 16)) * 0x85EBCA6B;
+      z = (z ^ (z >> 13)) * 0xC2B2AE35;
+      r->s[i] = z ^ (z >> 16);
+    }
+}
+
+
+void
+ya_rng_split (ya_rng *parent, ya_rng *child)
+{
+  static const unsigned int jump[] = {
+    0x8764000B, 0xF542D2D3, 0x6FA035C3, 0x77F2DB5B };
+  unsigned int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  unsigned int i, b;
+
+  *child = *parent;
+
+  for (i = 0; i < sizeof(jump) / sizeof(*jump); i++)
+    for (b = 0; b < 32; b++)
+      {
+        if (jump[i] & (1U << b))
+          {
+            s0 ^= parent->s[0];
+            s1 ^= parent->s[1];
+            s2 ^= parent->s[2];
+            s3 ^= parent->s[3];
+          }
+        ya_rng_random (parent);
+      }
+
+  parent->s[0] = s0;
+  parent->s[1] = s1;
+  parent->s[2] = s2;
+  parent->s[3] = s3;
+}
+
+
+void
+ya_rng_fill (ya_rng *r, unsigned int *buf, unsigned long n)
+{
+  /* Keep the state in locals so that it can live in registers. */
+  unsigned int s[4];
+  unsigned long i;
+  s[0] = r->s[0]; s[1] = r->s[1]; s[2] = r->s[2]; s[3] = r->s[3];
+  for (i = 0; i < n; i++)
+    XOSHIRO_STEP (s, buf[i]);
+  r->s[0] = s[0]; r->s[1] = s[1]; r->s[2] = s[2]; r->s[3] = s[3];
+}
+
+
+void
+ya_rng_fill_float (ya_rng *r, float *buf, unsigned long n, float scale)
+{
+  unsigned int s[4];
+  unsigned long i;
+  /* The top 24 bits are exactly representable in a float. */
+  float k = scale / 16777216.0f;
+  s[0] = r->s[0]; s[1] = r->s[1]; s[2] = r->s[2]; s[3] = r->s[3];
+  for (i = 0; i < n; i++)
+    {
+      unsigned int v;
+      XOSHIRO_STEP (s, v);
+      buf[i] = (float) (v >> 8) * k;
+    }
+  r->s[0] = s[0]; r->s[1] = s[1]; r->s[2] = s[2]; r->s[3] = s[3];
+}
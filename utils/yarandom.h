@@ -130,4 +130,32 @@ static double _frand_tmp_;
 #define MAXRAND         (2147483648.0) /* unsigned 1<<31 as a float */
 #define SRAND(n)        /* already seeded by screenhack.c */
 
+
+/* random() is one global stream, and is not thread-safe.  A ya_rng is a
+   separate stream (xoshiro128++) that a thread, or anything that wants
+   its own repeatable sequence, can own.
+ */
+typedef struct { unsigned int s[4]; } ya_rng;
+
+/* If seed is 0, the stream is seeded from random(), so it is as
+   repeatable as the global stream is. */
+extern void ya_rng_init (ya_rng *, unsigned int seed);
+
+/* Makes 'child' a copy of 'parent', then moves 'parent' 2^64 numbers
+   ahead, so that the two streams will never overlap.  Call this once per
+   worker thread on one parent stream. */
+extern void ya_rng_split (ya_rng *parent, ya_rng *child);
+
+extern unsigned int ya_rng_random (ya_rng *);
+
+/* Fill buf with n numbers from the stream, uniform over [0, RAND_MAX]
+   or [0, scale) respectively.  Cheaper than calling ya_rng_random
+   n times. */
+extern void ya_rng_fill (ya_rng *, unsigned int *buf, unsigned long n);
+extern void ya_rng_fill_float (ya_rng *, float *buf, unsigned long n,
+                               float scale);
+
+#define ya_rng_frand(R,F) \
+  ((double) ya_rng_random (R) * (double) (F) / ((double) RAND_MAX + 1))
+
 #endif /* __YARANDOM_H__ */